@@ -46,6 +46,9 @@ ddrmem_c::ddrmem_c()
 {
 	log_label = "DDRMEM";
 	pmi_address_overlay = 0 ;
+	pthread_mutex_init(&dma_pool_mutex, NULL);
+	// pool starts behind emulated memory, 8 byte aligned
+	dma_pool_start = (sizeof(ddrmem_t) + 7) & ~7;
 }
 
 // check allocated memory and print info
@@ -64,6 +67,53 @@ void ddrmem_c::info()
 	INFO("  Virtual (ARM Linux-side) address: %p", base_virtual);
 	INFO("  Physical (PRU-side) address:%x", base_physical);
 	INFO("  %d bytes of " QUNIBONE_NAME" memory allocated", sizeof(qunibus_memory_t));
+	if (len > dma_pool_start)
+		INFO("  %u bytes for zero-copy DMA buffers", len - dma_pool_start);
+}
+
+// Allocate a device buffer in the unused shared DDR behind the emulated memory.
+// PRU DMA reads/writes it directly, no copy through the mailbox.
+// result: NULL if pool exhausted, caller should use a heap buffer then.
+uint16_t *ddrmem_c::dma_buffer_alloc(uint32_t wordcount) 
+{
+	uint32_t size = (2 * wordcount + 7) & ~7;
+	uint32_t offset = dma_pool_start;
+	uint16_t *result = NULL;
+	pthread_mutex_lock(&dma_pool_mutex);
+	// first fit: search gap between allocated buffers
+	for (auto it = dma_pool_used.begin(); it != dma_pool_used.end(); ++it) {
+		if (it->first - offset >= size)
+			break;
+		offset = it->first + it->second;
+	}
+	if (offset + size <= len) {
+		dma_pool_used[offset] = size;
+		result = (uint16_t *) ((uint8_t *) base_virtual + offset);
+	}
+	pthread_mutex_unlock(&dma_pool_mutex);
+	return result;
+}
+
+void ddrmem_c::dma_buffer_free(uint16_t *buffer) 
+{
+	uint32_t offset = (uint8_t *) buffer - (uint8_t *) base_virtual;
+	pthread_mutex_lock(&dma_pool_mutex);
+	auto it = dma_pool_used.find(offset);
+	assert(it != dma_pool_used.end());
+	dma_pool_used.erase(it);
+	pthread_mutex_unlock(&dma_pool_mutex);
+}
+
+// PRU-side address of a buffer range, if inside DMA buffer pool
+// result: 0 if not in shared DDR
+uint32_t ddrmem_c::dma_buffer_physical(const uint16_t *buffer, uint32_t wordcount) 
+{
+	const uint8_t *start = (const uint8_t *) base_virtual + dma_pool_start;
+	const uint8_t *end = (const uint8_t *) base_virtual + len;
+	const uint8_t *b = (const uint8_t *) buffer;
+	if (b < start || b + 2 * wordcount > end)
+		return 0;
+	return base_physical + (b - (const uint8_t *) base_virtual);
 }
 
 // read/write ddr memory locally
@@ -191,7 +241,7 @@ void ddrmem_c::fill_pattern(void)
 void ddrmem_c::fill_pattern_pru(void) 
 {
 	// ddrmem_base_physical and _len already set
-	assert((uint32_t )mailbox->ddrmem_base_physical == base_physical);
+	assert((uint32_t) (uintptr_t) mailbox->ddrmem_base_physical == base_physical);
 	mailbox_execute(ARM2PRU_DDR_FILL_PATTERN);
 }
 
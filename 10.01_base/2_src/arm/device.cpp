@@ -45,6 +45,7 @@
 #include "utils.hpp"
 #include "logger.hpp"
 #include "timeout.hpp"
+#include "pru.hpp"
 #include "device.hpp"
 
 // declare device list of class separate
@@ -210,6 +211,11 @@ void device_c::worker_init_realtime_priority(enum worker_priority_e priority)
 	// /proc/sys/kernel/sched_rt_period_us containing 1000000 and /proc/sys/kernel/sched_rt_runtime_us containing 950000
 	// See https://www.kernel.org/doc/Documentation/scheduler/sched-rt-group.txt
 
+	// Simulated PRU is just another thread: RT workers spinning on
+	// PRU events would starve it.
+	if (pru->is_simulated())
+		priority = none_rt;
+
 	switch (priority) {
 	case rt_max:
 		// 1. assert path exists
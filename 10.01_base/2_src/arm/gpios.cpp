@@ -87,9 +87,13 @@ void gpios_c::bank_map_registers(unsigned bank_idx, unsigned unmapped_start_addr
     bank->registerrange_addr_unmapped = unmapped_start_addr; // info only
     INFO("GPIO%d registers at %X - %X (size = %X)", bank_idx, unmapped_start_addr,
          unmapped_start_addr + GPIO_SIZE - 1, GPIO_SIZE);
-    bank->registerrange_start_addr = (uint8_t *) mmap(0, GPIO_SIZE, PROT_READ | PROT_WRITE,
-                                     MAP_SHARED, memory_filedescriptor, unmapped_start_addr);
-    if (bank->registerrange_start_addr == MAP_FAILED)
+    if (pru->is_simulated())
+        // no AM335x: pins are cells in dummy register ranges
+        bank->registerrange_start_addr = (uint8_t *) calloc(1, GPIO_SIZE);
+    else
+        bank->registerrange_start_addr = (uint8_t *) mmap(0, GPIO_SIZE, PROT_READ | PROT_WRITE,
+                                         MAP_SHARED, memory_filedescriptor, unmapped_start_addr);
+    if (bank->registerrange_start_addr == MAP_FAILED || bank->registerrange_start_addr == NULL)
         FATAL("Unable to map GPIO%d", bank_idx);
 
     bank->oe_addr = (uint32_t *) (bank->registerrange_start_addr + GPIO_OE_ADDROFFSET);
@@ -184,8 +188,9 @@ void gpios_c::init()
     // program pins registers
     // echo no  > /sys/class/gpio/export_pin
 
-    for (n = 0; (gpio = pins[n]); n++)
-        export_pin(gpio);
+    if (!pru->is_simulated())
+        for (n = 0; (gpio = pins[n]); n++)
+            export_pin(gpio);
 
     // set pin directions
     // a) echo in|out > /sys/class/gpio/gpio<no>/direction
@@ -224,6 +229,8 @@ void gpios_c::init()
 
 	// On both UniBone PCB before 2022 and QBone timer5 is connected only to a test pin.
 	// On UniBone 2022 timer5 can be jumpered onto UNIBUS LTC.
+    if (pru->is_simulated())
+        return ; // no timer5
 #if defined(UNIBUS)
     // produce 50Hz wave at LTC output.
     set_frequency(50) ;
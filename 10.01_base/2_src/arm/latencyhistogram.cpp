@@ -0,0 +1,99 @@
+/* latencyhistogram.cpp: HDR-style histogram for bus latencies
+
+ Copyright (c) 2026, QUniBone contributors
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "latencyhistogram.hpp"
+
+latency_histogram_c::latency_histogram_c()
+{
+	clear();
+}
+
+void latency_histogram_c::clear(void)
+{
+	memset(buckets, 0, sizeof(buckets));
+	count = 0;
+	sum_ns = 0;
+	min_ns = 0;
+	max_ns = 0;
+}
+
+// values < SUB_COUNT: one bucket per value.
+// else bucket by msb position, and the SUB_BITS bits below msb
+unsigned latency_histogram_c::bucket_index(uint64_t value_ns)
+{
+	if (value_ns < LATENCY_HISTOGRAM_SUB_COUNT)
+		return (unsigned) value_ns;
+	if (value_ns > 0xffffffffULL)
+		return LATENCY_HISTOGRAM_BUCKET_COUNT - 1;
+	unsigned msb = 31 - __builtin_clz((uint32_t) value_ns);
+	unsigned shift = msb - LATENCY_HISTOGRAM_SUB_BITS;
+	unsigned sub = (value_ns >> shift) & (LATENCY_HISTOGRAM_SUB_COUNT - 1);
+	return (shift + 1) * LATENCY_HISTOGRAM_SUB_COUNT + sub;
+}
+
+uint64_t latency_histogram_c::bucket_low_ns(unsigned idx)
+{
+	if (idx < LATENCY_HISTOGRAM_SUB_COUNT)
+		return idx;
+	unsigned shift = idx / LATENCY_HISTOGRAM_SUB_COUNT - 1;
+	unsigned sub = idx % LATENCY_HISTOGRAM_SUB_COUNT;
+	return (uint64_t) (LATENCY_HISTOGRAM_SUB_COUNT + sub) << shift;
+}
+
+// last value in bucket
+uint64_t latency_histogram_c::bucket_high_ns(unsigned idx)
+{
+	if (idx + 1 >= LATENCY_HISTOGRAM_BUCKET_COUNT)
+		return 0xffffffffULL;
+	return bucket_low_ns(idx + 1) - 1;
+}
+
+void latency_histogram_c::record(uint64_t value_ns)
+{
+	buckets[bucket_index(value_ns)]++;
+	if (count == 0 || value_ns < min_ns)
+		min_ns = value_ns;
+	if (value_ns > max_ns)
+		max_ns = value_ns;
+	sum_ns += value_ns;
+	count++;
+}
+
+uint64_t latency_histogram_c::percentile_ns(double percent)
+{
+	if (count == 0)
+		return 0;
+	uint64_t limit = (uint64_t) ((double) count * percent / 100.0 + 0.5);
+	if (limit < 1)
+		limit = 1;
+	uint64_t sum = 0;
+	for (unsigned idx = 0; idx < LATENCY_HISTOGRAM_BUCKET_COUNT; idx++) {
+		sum += buckets[idx];
+		if (sum >= limit) {
+			uint64_t result = bucket_high_ns(idx);
+			return result > max_ns ? max_ns : result;
+		}
+	}
+	return max_ns;
+}
@@ -0,0 +1,68 @@
+/* latencyhistogram.hpp: HDR-style histogram for bus latencies
+
+ Copyright (c) 2026, QUniBone contributors
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LATENCYHISTOGRAM_HPP_
+#define _LATENCYHISTOGRAM_HPP_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Histogram with log-linear buckets, like "HdrHistogram":
+ * each power of 2 is divided into 2^LATENCY_HISTOGRAM_SUB_BITS buckets,
+ * so relative resolution is constant (6%) over the whole range 1ns .. 4s.
+ * Fixed size, no allocation on record(), so usable in the event worker.
+ * Single writer. Readers in other threads may see a sample half recorded.
+ */
+#define LATENCY_HISTOGRAM_SUB_BITS	4
+#define LATENCY_HISTOGRAM_SUB_COUNT	(1 << LATENCY_HISTOGRAM_SUB_BITS)
+// values >= 2^32 ns are clipped into last bucket
+#define LATENCY_HISTOGRAM_BUCKET_COUNT	((32 - LATENCY_HISTOGRAM_SUB_BITS + 1) * LATENCY_HISTOGRAM_SUB_COUNT)
+
+class latency_histogram_c {
+private:
+	uint32_t buckets[LATENCY_HISTOGRAM_BUCKET_COUNT];
+
+	static unsigned bucket_index(uint64_t value_ns);
+public:
+	uint64_t count;
+	uint64_t sum_ns;
+	uint64_t min_ns;
+	uint64_t max_ns;
+
+	latency_histogram_c();
+	void clear(void);
+	void record(uint64_t value_ns);
+
+	static uint64_t bucket_low_ns(unsigned idx);
+	static uint64_t bucket_high_ns(unsigned idx);
+	uint32_t bucket_count(unsigned idx) {
+		return buckets[idx];
+	}
+
+	// smallest value >= "percent" of all samples, upper bucket limit
+	uint64_t percentile_ns(double percent);
+	uint64_t mean_ns(void) {
+		return count ? sum_ns / count : 0;
+	}
+};
+
+#endif
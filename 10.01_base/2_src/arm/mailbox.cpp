@@ -28,7 +28,6 @@
 
 #include <stdio.h>
 #include <string.h>
-#include "prussdrv.h"
 
 #include "pru.hpp"
 #include "logger.hpp"
@@ -45,8 +44,8 @@ int mailbox_connect(void)
 {
 	void *pru_shared_dataram;
 	// get pointer to RAM
-	if (prussdrv_map_prumem(PRU_MAILBOX_RAM_ID, &pru_shared_dataram)) {
-		printf("ERROR: prussdrv_map_prumem() failed\n");
+	if (pru->map_prumem(PRU_MAILBOX_RAM_ID, &pru_shared_dataram)) {
+		printf("ERROR: map_prumem() failed\n");
 		return -1;
 
 	}
@@ -59,7 +58,7 @@ int mailbox_connect(void)
 	memset((void*) mailbox, 0, sizeof(mailbox_t));
 
 	// tell PRU location of shared DDR RAM
-	mailbox->ddrmem_base_physical = (ddrmem_t *) ddrmem->base_physical;
+	mailbox->ddrmem_base_physical = (ddrmem_t *) (uintptr_t) ddrmem->base_physical;
 
 	return 0;
 }
@@ -44,7 +44,6 @@ priority_request_c::priority_request_c(qunibusdevice_c *_device)
 
 priority_request_c::~priority_request_c() 
 {
-	// not used, but need some virtual func for dynamic_cast()
 }
 
 void priority_request_c::set_priority_slot(uint8_t _priority_slot) 
@@ -66,9 +65,16 @@ void priority_request_c::set_priority_slot(uint8_t _priority_slot)
 dma_request_c::dma_request_c(qunibusdevice_c *_device) :
 		priority_request_c(_device) 
 {
+	kind = PRIORITY_REQUEST_KIND_DMA;
 	level_index = PRIORITY_LEVEL_INDEX_NPR;
 	success = false;
 	is_cpu_access = false ;// over written for emulated CPU
+	segment_count = 0 ;
+	buffer_physical = 0 ;
+	chunk_buffer = 0 ;
+	next_chunk_words = 0 ;
+	completion_queue = NULL ;
+	queue_next = NULL ;
 	// register request for device
 	if (_device) {
 		_device->dma_requests.push_back(this);
@@ -85,10 +91,75 @@ dma_request_c::~dma_request_c()
 	}
 }
 
+dma_completion_queue_c::dma_completion_queue_c() 
+{
+	mutex = PTHREAD_MUTEX_INITIALIZER;
+	cond = PTHREAD_COND_INITIALIZER;
+}
+
+dma_completion_queue_c::~dma_completion_queue_c() 
+{
+	clear() ;
+}
+
+// request complete: called by qunibusadapter under NPR level lock
+void dma_completion_queue_c::push(dma_request_c *dmareq) 
+{
+	pthread_mutex_lock(&mutex);
+	completed.push_back(dmareq);
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&mutex);
+}
+
+// wait until a submitted request is complete, and remove it from queue
+dma_request_c *dma_completion_queue_c::wait(void) 
+{
+	dma_request_c *dmareq;
+	pthread_mutex_lock(&mutex);
+	while (completed.empty()) {
+		int res = pthread_cond_wait(&cond, &mutex);
+		assert(!res);
+	}
+	dmareq = completed.front();
+	completed.pop_front();
+	pthread_mutex_unlock(&mutex);
+	return dmareq;
+}
+
+// non-blocking: next completed request, or NULL
+dma_request_c *dma_completion_queue_c::try_pop(void) 
+{
+	dma_request_c *dmareq = NULL;
+	pthread_mutex_lock(&mutex);
+	if (!completed.empty()) {
+		dmareq = completed.front();
+		completed.pop_front();
+	}
+	pthread_mutex_unlock(&mutex);
+	return dmareq;
+}
+
+bool dma_completion_queue_c::empty(void) 
+{
+	bool result;
+	pthread_mutex_lock(&mutex);
+	result = completed.empty();
+	pthread_mutex_unlock(&mutex);
+	return result;
+}
+
+void dma_completion_queue_c::clear(void) 
+{
+	pthread_mutex_lock(&mutex);
+	completed.clear();
+	pthread_mutex_unlock(&mutex);
+}
+
 // create invalid requests, is setup by qunibusadapter
 intr_request_c::intr_request_c(qunibusdevice_c *_device) :
 		priority_request_c(_device) 
 {
+	kind = PRIORITY_REQUEST_KIND_INTR;
 	// convert QBUS/UNIBUS level 4,5,6,7 to internal priority, see REQUEST_INDEX_*
 	level_index = 0xff; // uninitialized, asserts() if used
 	vector = 0xffff; // uninitialized, asserts() if used
@@ -46,8 +46,10 @@
 
 #include <stdint.h>
 #include <pthread.h>
+#include <deque>
 
 #include "logsource.hpp"
+#include "mailbox.h"	// PRU_MAX_DMA_SEGMENTCOUNT
 
 // linear indexes for different QBUS/UNIBUS arbitration levels
 #define PRIORITY_LEVEL_INDEX_BR4	0 
@@ -60,6 +62,12 @@
 #define PRIORITY_SLOT_COUNT	32	// backplane slot numbers 0..31 may be used
 
 class qunibusdevice_c;
+class dma_completion_queue_c;
+
+// type of a priority_request_c, tested on the scheduler hot path instead of dynamic_cast
+enum priority_request_kind_enum {
+	PRIORITY_REQUEST_KIND_DMA, PRIORITY_REQUEST_KIND_INTR
+};
 
 // (almost) abstract base class for dma and intr requests
 class priority_request_c: public logsource_c {
@@ -67,6 +75,8 @@ class priority_request_c: public logsource_c {
 	friend class dma_request_c;
 	friend class qunibusadapter_c;
 private:
+	uint8_t kind; // PRIORITY_REQUEST_KIND_*, fixed by subclass constructor
+
 	qunibusdevice_c *device; // this device owns the request
 	// maybe NULL, in request is not used for device meualtion
 	// (test console EXAM, DEPOSIT for example).
@@ -85,7 +95,14 @@ public:
 	pthread_cond_t complete_cond; // PRU signal notifies request on completeness
 
 	priority_request_c(qunibusdevice_c *device);
-	virtual ~priority_request_c(); // not used, but need dynamic_cast
+	virtual ~priority_request_c();
+
+	bool is_dma(void) {
+		return kind == PRIORITY_REQUEST_KIND_DMA;
+	}
+	bool is_intr(void) {
+		return kind == PRIORITY_REQUEST_KIND_INTR;
+	}
 
 	void set_priority_slot(uint8_t slot);
 	uint8_t get_priority_slot(void) {
@@ -93,6 +110,12 @@ public:
 	}
 };
 
+// one address range of a scatter-gather DMA, see qunibusadapter_c::DMA_submit_segments()
+typedef struct {
+	uint32_t addr;
+	uint32_t wordcount;
+} dma_segment_t;
+
 class dma_request_c: public priority_request_c {
 	friend class qunibusadapter_c;
 public:
@@ -105,13 +128,31 @@ public:
 	uint32_t qunibus_end_addr;
 	uint16_t* buffer;
 	uint32_t wordcount;
+	// zero-copy: PRU-side address of buffer, if allocated with
+	// ddrmem_c::dma_buffer_alloc(). 0 = copied through mailbox
+	uint32_t buffer_physical;
 
 	bool is_cpu_access; // true if DMA is CPU memory access
 
+	// scatter-gather: address ranges transferred in one bus tenure.
+	// buffer[] holds data of all segments in sequence, wordcount is the sum.
+	// 0 = single range qunibus_start_addr/wordcount
+	unsigned segment_count;
+	dma_segment_t segments[PRU_MAX_DMA_SEGMENTCOUNT];
+
+	// optional: finished request is appended here, see qunibusadapter_c::DMA_submit()
+	dma_completion_queue_c *completion_queue;
+	// link in dma_request_queue_c, while waiting behind the active request of the slot
+	dma_request_c *queue_next;
+
 	// DMA transaction are divided in to smaller DAT transfer "chunks" 
-	uint32_t chunk_max_words; // max is PRU capacity PRU_MAX_DMA_WORDCOUNT (512)
+	uint32_t chunk_max_words; // max is PRU capacity PRU_MAX_DMA_WORDCOUNT (512), or _DDR_ for zero-copy
 	uint32_t chunk_qunibus_start_addr; // current chunk
 	uint32_t chunk_words; // size of current chunks
+	// ping-pong: current chunk is in mailbox words[] half chunk_buffer.
+	// next_chunk_words != 0: following chunk queued in other half
+	uint8_t chunk_buffer;
+	uint32_t next_chunk_words;
 
 	volatile bool success; // DMA can fail with bus timeout
 
@@ -127,6 +168,69 @@ public:
 
 };
 
+/* FIFO of dma_request_c, linked through dma_request_c.queue_next.
+ No allocation: push/pop on the scheduler path under the NPR level lock.
+ A request can be in only one dma_request_queue_c.
+ */
+class dma_request_queue_c {
+private:
+	dma_request_c *head;
+	dma_request_c *tail;
+public:
+	dma_request_queue_c() {
+		head = tail = NULL;
+	}
+	bool empty(void) {
+		return head == NULL;
+	}
+	void push_back(dma_request_c *dmareq) {
+		dmareq->queue_next = NULL;
+		if (tail)
+			tail->queue_next = dmareq;
+		else
+			head = dmareq;
+		tail = dmareq;
+	}
+	// NULL if empty
+	dma_request_c *pop_front(void) {
+		dma_request_c *dmareq = head;
+		if (dmareq) {
+			head = dmareq->queue_next;
+			if (head == NULL)
+				tail = NULL;
+			dmareq->queue_next = NULL;
+		}
+		return dmareq;
+	}
+	void clear(void) {
+		while (pop_front())
+			;
+	}
+};
+
+/* Completion queue for asynchronous DMA.
+ A device submits several dma_request_c with qunibusadapter_c::DMA_submit(),
+ all linked to the same completion queue.
+ The qunibusadapter worker appends each request when complete (or canceled by INIT),
+ the device thread fetches them in completion order.
+ So device logic can prepare the next buffer while the PRU transfers the previous.
+ */
+class dma_completion_queue_c {
+private:
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	std::deque<dma_request_c *> completed;
+public:
+	dma_completion_queue_c();
+	~dma_completion_queue_c();
+
+	void push(dma_request_c *dmareq); // called by qunibusadapter
+	dma_request_c *wait(void); // blocking
+	dma_request_c *try_pop(void); // NULL if none complete
+	bool empty(void);
+	void clear(void);
+};
+
 struct qunibusdevice_register_struct;
 // forward
 
@@ -26,6 +26,7 @@
  Management interface to PRU0 & 1:
  - setup interrupt
  - download code from arrays in pru0/1_config.c
+ - or run the pru_sim_c "virtual PRU" instead of PRU hardware
 
  Partly copyright (c) 2014 dhenke@mythopoeic.org
 
@@ -49,13 +50,16 @@
 
 #include "utils.hpp"
 #include "logger.hpp"
+#if !defined(PRU_SIMULATOR_ONLY)
 #include "prussdrv.h"
 #include "pruss_intc_mapping.h"
+#endif
 #include "mailbox.h"
 #include "ddrmem.h"
 #include "iopageregister.h"
 
 #include "pru.hpp"
+#include "pru_sim.hpp"
 
 /*** PRU code arrays generated by clpru / hexpru  ***
  Program code is generated by "lcpru" and "hexpru --array" as C-array source code.
@@ -73,6 +77,7 @@
  ...
  0x00};
  */
+#if !defined(PRU_SIMULATOR_ONLY)
 //  under c++ linker error with const attribute ?!
 #define const
 #include "pru0_code_all_array.c"
@@ -83,6 +88,7 @@
 #include "pru1_code_qbus_array.c"
 #endif
 #undef const
+#endif
 
 // Singleton
 pru_c *pru;
@@ -90,6 +96,11 @@ pru_c *pru;
 pru_c::pru_c() 
 {
 	prucode_id = PRUCODE_NONE;
+#if defined(PRU_SIMULATOR_ONLY)
+	backend = BACKEND_SIMULATOR;
+#else
+	backend = BACKEND_HARDWARE;
+#endif
 	log_label = "PRU";
 }
 
@@ -103,6 +114,7 @@ pru_c::pru_c()
  Returns 0 on success, non-0 on error.
  ***/
 
+#if !defined(PRU_SIMULATOR_ONLY)
 // entry for one program code variant for both PRUs
 struct prucode_entry {
 	unsigned id;
@@ -136,15 +148,40 @@ struct prucode_entry prucode[] = {
 	   // end marker
 	{ pru_c::PRUCODE_EOD, NULL, 0, 0, NULL, 0, 0 } };
 
+#endif
+
 int pru_c::start(enum prucode_enum _prucode_id) 
 {
 	timeout_c timeout;
-	int rtn;
-	tpruss_intc_initdata intc = PRUSS_INTC_INITDATA;
 
 	// use stop() before restart()
 	assert(this->prucode_id == PRUCODE_NONE);
 
+	if (is_simulated()) {
+		// shared DDR is plain process memory, allocated by the simulator
+		if (pru_sim == NULL)
+			pru_sim = new pru_sim_c();
+		pru_sim->connect_ddrmem();
+		ddrmem->info();
+		mailbox_connect();
+		iopageregisters_connect();
+		pru_sim->start(_prucode_id);
+		INFO("Started simulated PRU with code id = %d", _prucode_id);
+		prucode_id = _prucode_id;
+		// same command loop check as for PRU hardware
+		mailbox->arm2pru_req = ARM2PRU_NOP;
+		timeout.wait_ms(1);
+		if (mailbox->arm2pru_req != ARM2PRU_NONE)
+			FATAL("Simulated PRU is not executing its command loop");
+		return 0;
+	}
+#if defined(PRU_SIMULATOR_ONLY)
+	FATAL("Host build without prussdrv, only simulated PRU available");
+	return -1; // not reached
+#else
+	int rtn;
+	tpruss_intc_initdata intc = PRUSS_INTC_INITDATA;
+
 	/* initialize PRU */
 	if ((rtn = prussdrv_init()) != 0) {
 		ERROR("prussdrv_init() failed");
@@ -230,6 +267,7 @@ int pru_c::start(enum prucode_enum _prucode_id)
 			"- Correct Device Tree Overlay loaded?\n"
 			"- Check also /sys/class/uio/uio*.");
 	return rtn; // not reached
+#endif
 }
 
 /***  pru_c::stop() -- halt PRU and release driver
@@ -243,6 +281,13 @@ int pru_c::stop(void)
 	int rtn = 0;
 	prucode_id = PRUCODE_NONE;
 
+	if (is_simulated()) {
+		if (pru_sim)
+			pru_sim->stop();
+		return 0;
+	}
+#if !defined(PRU_SIMULATOR_ONLY)
+
 	/* clear the event (if asserted) */
 	if (prussdrv_pru_clear_event(PRU_EVTOUT_0, PRU0_ARM_INTERRUPT)) {
 		ERROR("prussdrv_pru_clear_event() failed");
@@ -266,6 +311,42 @@ int pru_c::stop(void)
 		rtn = -1;
 	}
 
+#endif
 	return rtn;
 }
 
+// get pointer to one of the PRU RAMs, shared with ARM
+// pru_ram_id: PRU_MAILBOX_RAM_ID, PRU_DEVICEREGISTER_RAM_ID
+int pru_c::map_prumem(unsigned pru_ram_id, void **address) 
+{
+	if (is_simulated())
+		return pru_sim->map_prumem(pru_ram_id, address);
+#if defined(PRU_SIMULATOR_ONLY)
+	return -1;
+#else
+	return prussdrv_map_prumem(pru_ram_id, address);
+#endif
+}
+
+// wait for PRU2ARM_INTERRUPT
+// result: 0 = timeout, -1 = error, else event count received
+int pru_c::wait_event_timeout(unsigned timeout_us) 
+{
+	if (is_simulated())
+		return pru_sim->wait_event_timeout(timeout_us);
+#if defined(PRU_SIMULATOR_ONLY)
+	return -1;
+#else
+	return prussdrv_pru_wait_event_timeout(PRU_EVTOUT_0, timeout_us);
+#endif
+}
+
+// clear interrupt after wait_event_timeout()
+void pru_c::clear_event(void) 
+{
+	if (is_simulated())
+		return; // simulator counts events, nothing to clear
+#if !defined(PRU_SIMULATOR_ONLY)
+	prussdrv_pru_clear_event(PRU_EVTOUT_0, PRU0_ARM_INTERRUPT);
+#endif
+}
@@ -39,7 +39,14 @@
 #define _PRU_HPP_
 
 #include <stdint.h>
+#if defined(PRU_SIMULATOR_ONLY)
+// no prussdrv library for host builds, only ids of the PRU RAMs are needed
+#define PRUSS0_PRU0_DATARAM	0
+#define PRUSS0_PRU1_DATARAM	1
+#define PRUSS0_SHARED_DATARAM	4
+#else
 #include "prussdrv.h"
+#endif
 
 #include "logsource.hpp"
 
@@ -78,12 +85,28 @@ public:
 		PRUCODE_EMULATION = 2 // regular QBUS/UNIBUS operation
 	// with or without physical CPU for arbitration
 	};
+
+	// Who executes the PRU code?
+	enum backend_enum {
+		BACKEND_HARDWARE = 0, // PRU0/PRU1 of the AM335x, via prussdrv
+		BACKEND_SIMULATOR = 1 // pru_sim_c thread on any Linux host, no QBUS/UNIBUS
+	};
 public:
 	enum prucode_enum prucode_id; // currently running code
+	enum backend_enum backend; // select before start()
 
 	pru_c();
 	int start(enum prucode_enum prucode_id);
 	int stop(void);
+
+	bool is_simulated(void) {
+		return backend == BACKEND_SIMULATOR;
+	}
+
+	// Access to shared RAM and PRU->ARM interrupt, independent of backend
+	int map_prumem(unsigned pru_ram_id, void **address);
+	int wait_event_timeout(unsigned timeout_us);
+	void clear_event(void);
 };
 
 extern pru_c *pru; // singleton
@@ -0,0 +1,646 @@
+/* pru_sim.cpp: "virtual PRU", executes the PRU1 mailbox protocol on the ARM/host
+
+ Copyright (c) 2026, QUniBone contributors
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ Replacement for PRU0/PRU1 and the physical QBUS/UNIBUS, so
+ device logic, MSCP, CPU emulation and the menus run on any Linux host.
+
+ The worker thread follows the PRU1 main loop (pru1_main_unibus.c, pru1_main_qbus.c):
+ - accept ARM2PRU_* opcodes and ACK them by clearing arm2pru_req
+ - detect changes of INIT and power signals, raise init/power events
+ - arbitrate DMA and INTR requests. There's no physical CPU:
+   if the ARM CPU is not emulated, every INTR is accepted at once.
+ - DMA is done against "emulated_addr_*()" only: DDR memory and iopage registers.
+   All other addresses time out.
+
+ Not simulated: bus timing, the BG/NPG daisy chain, physical bus members,
+ the buslatch multiplexer (latches are plain registers).
+ PRU2ARM_INTERRUPT is an event counter, on which wait_event_timeout() blocks.
+ */
+#define _PRU_SIM_CPP_
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <assert.h>
+
+#include "logger.hpp"
+#include "timeout.hpp"
+#include "qunibus.h"
+#include "pru_sim.hpp"
+
+#if defined(UNIBUS)
+// INIT, ACLO, DCLO are bits 3,4,5 in latch[7]
+#define SIM_INITIALIZATIONSIGNAL_LATCH	7
+#define SIM_POWERSIGNALS	(INITIALIZATIONSIGNAL_ACLO | INITIALIZATIONSIGNAL_DCLO)
+#define SIM_POWERSIGNALS_OK	0 // ACLO, DCLO negated
+// IOpage is the top 8KB of address space
+#define SIM_ADDR_IS_IOPAGE(addr)	((addr) >= iopageregisters_ram->iopage_start_addr)
+#define SIM_MEMORY_ADDR(addr)	(addr)
+#elif defined(QBUS)
+// INIT, HALT, POK, DCOK are bits 0,1,3,4 in latch[5]
+#define SIM_INITIALIZATIONSIGNAL_LATCH	5
+#define SIM_POWERSIGNALS	(INITIALIZATIONSIGNAL_POK | INITIALIZATIONSIGNAL_DCOK)
+#define SIM_POWERSIGNALS_OK	SIM_POWERSIGNALS // POK, DCOK asserted
+// BS7 is encoded as address bit 22
+#define SIM_ADDR_IS_IOPAGE(addr)	((addr) & QUNIBUS_IOPAGE_ADDR_BITMASK)
+#define SIM_MEMORY_ADDR(addr)	((addr) & ~QUNIBUS_IOPAGE_ADDR_BITMASK)
+#endif
+
+// Loops without work, before the worker starts to sleep between polls.
+// CPU accesses come at high rate, ARM spins on them.
+#define SIM_IDLE_SPIN_LOOPS	10000
+#define SIM_IDLE_SLEEP_US	20
+
+pru_sim_c *pru_sim; // singleton
+
+pru_sim_c::pru_sim_c()
+{
+	log_label = "PRUSIM";
+
+	worker_running = false;
+	worker_terminate = false;
+	prucode_id = pru_c::PRUCODE_NONE;
+
+	// PRU RAMs and DDR are cleared like after power-up
+	mailbox_ram = (volatile mailbox_t *) calloc(1, sizeof(mailbox_t));
+	iopageregisters_ram = (volatile pru_iopage_registers_t *) calloc(1,
+			sizeof(pru_iopage_registers_t));
+	ddrmem_ram = (volatile ddrmem_t *) calloc(1, sizeof(ddrmem_t) + PRU_SIM_DDR_DMA_POOL_SIZE);
+	if (mailbox_ram == NULL || iopageregisters_ram == NULL || ddrmem_ram == NULL)
+		FATAL("Can not allocate memory for simulated PRU");
+
+	memset(latches, 0, sizeof(latches));
+	device_request_mask = 0;
+	emulate_cpu = false;
+	dma_pending = false;
+	address_overlay = 0;
+	init_asserted = false;
+
+	pthread_mutex_init(&event_mutex, NULL);
+	pthread_cond_init(&event_cond, NULL);
+	event_count = 0;
+	event_count_received = 0;
+}
+
+pru_sim_c::~pru_sim_c()
+{
+	stop();
+	pthread_cond_destroy(&event_cond);
+	pthread_mutex_destroy(&event_mutex);
+	free((void *) ddrmem_ram);
+	free((void *) iopageregisters_ram);
+	free((void *) mailbox_ram);
+}
+
+// Simulated replacement of the uio_pruss DDR pool
+void pru_sim_c::connect_ddrmem(void)
+{
+	ddrmem->base_virtual = ddrmem_ram;
+	ddrmem->len = sizeof(ddrmem_t) + PRU_SIM_DDR_DMA_POOL_SIZE;
+	// PRU-side address not used, simulator accesses base_virtual.
+	// zero-copy DMA buffer addresses are offsets to ddrmem_ram then.
+	ddrmem->base_physical = 0;
+}
+
+// like prussdrv_map_prumem()
+// result: 0 = OK, else unknown RAM
+int pru_sim_c::map_prumem(unsigned pru_ram_id, void **address)
+{
+	switch (pru_ram_id) {
+	case PRU_MAILBOX_RAM_ID:
+		*address = (void *) mailbox_ram;
+		return 0;
+	case PRU_DEVICEREGISTER_RAM_ID:
+		*address = (void *) iopageregisters_ram;
+		return 0;
+	default:
+		*address = NULL;
+		return -1;
+	}
+}
+
+static void *pru_sim_worker_pthread_wrapper(void *context)
+{
+	pru_sim_c *sim = (pru_sim_c *) context;
+	sim->worker();
+	return NULL;
+}
+
+// "load and start PRU code"
+void pru_sim_c::start(enum pru_c::prucode_enum _prucode_id)
+{
+	assert(!worker_running);
+
+	prucode_id = _prucode_id;
+
+	// PRU1 startup: buslatches_reset(), iopageregisters_init(), sm_arb_reset()
+	memset(latches, 0, sizeof(latches));
+	latches[SIM_INITIALIZATIONSIGNAL_LATCH] = SIM_POWERSIGNALS_OK;
+	memset((void *) iopageregisters_ram, 0, sizeof(pru_iopage_registers_t));
+	device_request_mask = 0;
+	emulate_cpu = false;
+	dma_pending = false;
+	address_overlay = 0;
+	init_asserted = false;
+
+	worker_terminate = false;
+	int status = pthread_create(&pthread, NULL, &pru_sim_worker_pthread_wrapper, (void *) this);
+	if (status != 0)
+		FATAL("Failed to create pthread with status = %d", status);
+	worker_running = true;
+}
+
+void pru_sim_c::stop(void)
+{
+	if (!worker_running)
+		return;
+	worker_terminate = true;
+	int status = pthread_join(pthread, NULL);
+	if (status != 0)
+		FATAL("Failed to join worker_pthread with status = %d", status);
+	worker_running = false;
+	prucode_id = pru_c::PRUCODE_NONE;
+}
+
+// PRU2ARM_INTERRUPT
+void pru_sim_c::raise_interrupt(void)
+{
+	pthread_mutex_lock(&event_mutex);
+	event_count++;
+	pthread_cond_signal(&event_cond);
+	pthread_mutex_unlock(&event_mutex);
+}
+
+// like prussdrv_pru_wait_event_timeout()
+// result: 0 = timeout, else count of interrupts since last call
+int pru_sim_c::wait_event_timeout(unsigned timeout_us)
+{
+	struct timespec abstime;
+	int result;
+
+	clock_gettime(CLOCK_REALTIME, &abstime);
+	abstime.tv_nsec += (long) (timeout_us % 1000000) * 1000;
+	abstime.tv_sec += timeout_us / 1000000 + abstime.tv_nsec / 1000000000;
+	abstime.tv_nsec %= 1000000000;
+
+	pthread_mutex_lock(&event_mutex);
+	while (event_count == event_count_received)
+		if (pthread_cond_timedwait(&event_cond, &event_mutex, &abstime) == ETIMEDOUT)
+			break;
+	result = (int) (event_count - event_count_received);
+	event_count_received = event_count;
+	pthread_mutex_unlock(&event_mutex);
+	return result;
+}
+
+/*** Access to emulated memory and iopage registers, see pru1_iopageregisters.c ***/
+
+// code to send an register access event, like DO_EVENT_DEVICEREGISTER
+#define SIM_EVENT_DEVICEREGISTER(_reg,_unibus_control,_addr,_data)	do { \
+		mailbox_ram->events.deviceregister.unibus_control = _unibus_control ; \
+		mailbox_ram->events.deviceregister.register_handle = _reg->event_register_handle ; \
+		mailbox_ram->events.deviceregister.addr = _addr ; \
+		mailbox_ram->events.deviceregister.data = _data ; \
+		mailbox_ram->events.deviceregister.timestamp = (uint32_t) (timeout_c::abstime_ns() / PRU_CYCLE_NS) ; \
+		__sync_synchronize() ; \
+		EVENT_SIGNAL(*mailbox_ram,deviceregister) ; \
+		raise_interrupt() ; \
+	} while(0)
+
+// result 1 = successful, 0 = no memory or register at addr
+uint8_t pru_sim_c::emulated_addr_read(uint32_t addr, uint16_t *val)
+{
+	if (addr < iopageregisters_ram->memory_limit_addr
+			&& addr >= iopageregisters_ram->memory_start_addr) {
+		*val = ddrmem_ram->memory.words[addr / 2];
+		return 1;
+	} else if (SIM_ADDR_IS_IOPAGE(addr)) {
+		uint8_t reghandle = IOPAGE_REGISTER_ENTRY(*iopageregisters_ram, addr);
+		if (reghandle == 0) {
+			return 0; // register not implemented
+		} else if (reghandle == IOPAGE_REGISTER_HANDLE_ROM) {
+			*val = ddrmem_ram->memory.words[SIM_MEMORY_ADDR(addr) / 2];
+			return 1;
+		} else {
+			volatile pru_iopage_register_t *reg = &(iopageregisters_ram->registers[reghandle]);
+			*val = reg->value;
+			if (reg->event_flags & IOPAGEREGISTER_EVENT_FLAG_DATI)
+				SIM_EVENT_DEVICEREGISTER(reg, QUNIBUS_CYCLE_DATI, addr, *val);
+			return 1;
+		}
+	} else
+		return 0;
+}
+
+uint8_t pru_sim_c::emulated_addr_write_w(uint32_t addr, uint16_t w)
+{
+	if (addr < iopageregisters_ram->memory_limit_addr
+			&& addr >= iopageregisters_ram->memory_start_addr) {
+		ddrmem_ram->memory.words[addr / 2] = w;
+		return 1;
+	} else if (SIM_ADDR_IS_IOPAGE(addr)) {
+		uint8_t reghandle = IOPAGE_REGISTER_ENTRY(*iopageregisters_ram, addr);
+		if (reghandle == 0 || reghandle == IOPAGE_REGISTER_HANDLE_ROM) {
+			return 0; // register not implemented, ROM does not respond to DATO
+		} else {
+			volatile pru_iopage_register_t *reg = &(iopageregisters_ram->registers[reghandle]);
+			uint16_t reg_val = (reg->value & ~reg->writable_bits) | (w & reg->writable_bits);
+			reg->value = reg_val;
+			if (reg->event_flags & IOPAGEREGISTER_EVENT_FLAG_DATO)
+				SIM_EVENT_DEVICEREGISTER(reg, QUNIBUS_CYCLE_DATO, addr, reg_val);
+			return 1;
+		}
+	} else
+		return 0;
+}
+
+uint8_t pru_sim_c::emulated_addr_write_b(uint32_t addr, uint8_t b)
+{
+	if (addr < iopageregisters_ram->memory_limit_addr
+			&& addr >= iopageregisters_ram->memory_start_addr) {
+		ddrmem_ram->memory.bytes[addr] = b;
+		return 1;
+	} else if (SIM_ADDR_IS_IOPAGE(addr)) {
+		uint8_t reghandle = IOPAGE_REGISTER_ENTRY(*iopageregisters_ram, addr);
+		if (reghandle == 0 || reghandle == IOPAGE_REGISTER_HANDLE_ROM) {
+			return 0; // register not implemented, ROM does not respond to DATOB
+		} else {
+			volatile pru_iopage_register_t *reg = &(iopageregisters_ram->registers[reghandle]);
+			uint16_t reg_val;
+			if (addr & 1) // odd address = write upper byte
+				reg_val = (reg->value & 0x00ff) // don't touch lower byte
+				| (reg->value & ~reg->writable_bits & 0xff00) // protected upper byte bits
+						| (((uint16_t) b << 8) & reg->writable_bits); // changed upper byte bits
+			else
+				// even address: write lower byte
+				reg_val = (reg->value & 0xff00) // don't touch upper byte
+				| (reg->value & ~reg->writable_bits & 0x00ff) // protected lower byte bits
+						| (b & reg->writable_bits); // changed lower byte bits
+			reg->value = reg_val;
+			if (reg->event_flags & IOPAGEREGISTER_EVENT_FLAG_DATO)
+				SIM_EVENT_DEVICEREGISTER(reg, QUNIBUS_CYCLE_DATOB, addr, reg_val);
+			return 1;
+		}
+	} else
+		return 0;
+}
+
+// INIT: put reset values into every register
+void pru_sim_c::iopageregisters_reset_values(void)
+{
+	for (unsigned i = 0; i < MAX_IOPAGE_REGISTER_COUNT; i++)
+		iopageregisters_ram->registers[i].value = iopageregisters_ram->registers[i].reset_value;
+}
+
+// "Hold SSYN" until ARM has processed a register access event.
+// Called in the worker thread, which must still execute
+// ARM2PRU opcodes issued by the event handler (INTR, DMA).
+void pru_sim_c::wait_deviceregister_ack(void)
+{
+	while (!EVENT_IS_ACKED(*mailbox_ram, deviceregister) && !worker_terminate) {
+		if (mailbox_ram->arm2pru_req != ARM2PRU_NONE)
+			do_arm2pru_request();
+		else
+			sched_yield();
+	}
+	// like DO_EVENT_DEVICEREGISTER_HOLD_END()
+	if (DEVICEREGISTER_HOLD_PENDING(*mailbox_ram)) {
+		mailbox_ram->events.deviceregister.hold_cycles = (uint32_t) (timeout_c::abstime_ns()
+				/ PRU_CYCLE_NS) - mailbox_ram->events.deviceregister.timestamp;
+		mailbox_ram->events.deviceregister.hold_seq = mailbox_ram->events.deviceregister.signaled;
+	}
+}
+
+/*** PRU1 program ***/
+
+// Signal change of INIT or power signals to ARM.
+// Unlike PRU, next edge is signaled only after ARM ACKed the previous,
+// the simulator may change signals faster than ARM polls.
+void pru_sim_c::do_initializationsignals(void)
+{
+	uint8_t bussignals_cur = latches[SIM_INITIALIZATIONSIGNAL_LATCH] & INITIALIZATIONSIGNAL_ANY;
+
+	if (bussignals_cur & INITIALIZATIONSIGNAL_INIT)
+		device_request_mask = 0; // INIT clears all PRIORITY request signals
+
+	// Power event
+	uint8_t powersignals_prev = mailbox_ram->events.power_signals_cur; // as ARM knows
+	if (((powersignals_prev ^ bussignals_cur) & SIM_POWERSIGNALS)
+			&& EVENT_IS_ACKED(*mailbox_ram, power)) {
+		mailbox_ram->events.power_signals_prev = powersignals_prev;
+		mailbox_ram->events.power_signals_cur = bussignals_cur & SIM_POWERSIGNALS;
+		EVENT_SIGNAL(*mailbox_ram, power);
+		raise_interrupt();
+	}
+
+	if (!EVENT_IS_ACKED(*mailbox_ram, init))
+		return;
+#if defined(UNIBUS)
+	// INIT event on both edges
+	uint8_t initsignal_prev = mailbox_ram->events.init_signal_cur; // as ARM knows
+	if ((initsignal_prev ^ bussignals_cur) & INITIALIZATIONSIGNAL_INIT) {
+		if (!initsignal_prev)
+			iopageregisters_reset_values(); // INIT raised
+		mailbox_ram->events.init_signal_cur = bussignals_cur & INITIALIZATIONSIGNAL_INIT;
+		EVENT_SIGNAL(*mailbox_ram, init);
+		raise_interrupt();
+	}
+#elif defined(QBUS)
+	// INIT is a pulse, only raising edge signaled
+	if (!init_asserted && (bussignals_cur & INITIALIZATIONSIGNAL_INIT)) {
+		init_asserted = true;
+		mailbox_ram->events.init_signal_cur = 1;
+		iopageregisters_reset_values();
+		EVENT_SIGNAL(*mailbox_ram, init);
+		raise_interrupt();
+	} else if (init_asserted && !(bussignals_cur & INITIALIZATIONSIGNAL_INIT))
+		init_asserted = false;
+#endif
+}
+
+// Execute a DMA with mailbox_dma_t, then signal completion
+void pru_sim_c::do_dma(void)
+{
+	volatile mailbox_dma_t *dma = &mailbox_ram->dma;
+	uint8_t final_dma_state = DMA_STATE_READY;
+	uint8_t buscycle = dma->buscycle;
+	uint32_t addr = dma->startaddr;
+#if defined(UNIBUS)
+	addr |= address_overlay; // M9312 boot vector
+#endif
+
+	// zero-copy: data buffer in shared DDR, base_physical = 0
+	// ping-pong: chunk data in half [cur_buffer] of words[]
+	volatile uint16_t *words = dma->words + dma->cur_buffer * PRU_DMA_PINGPONG_WORDCOUNT;
+	if (dma->ddr_words)
+		words = (volatile uint16_t *) ((volatile uint8_t *) ddrmem_ram + dma->ddr_words);
+	// segmentcount == 0: single range, segment = whole transfer
+	unsigned seg_words_left = dma->segmentcount ? dma->segments[0].wordcount : dma->wordcount;
+
+	dma->cur_addr = addr;
+	dma->cur_segment = 0;
+	dma->cur_status = DMA_STATE_RUNNING;
+	for (unsigned wordidx = 0; wordidx < dma->wordcount; wordidx++) {
+		uint8_t internal;
+		if (seg_words_left == 0) {
+			// scatter-gather: next segment in same bus tenure
+			unsigned seg = ++dma->cur_segment;
+			addr = dma->segments[seg].startaddr;
+#if defined(UNIBUS)
+			addr |= address_overlay;
+#endif
+			seg_words_left = dma->segments[seg].wordcount;
+		}
+		dma->cur_addr = addr; // signal progress, if timeout: offending address
+		if (QUNIBUS_CYCLE_IS_DATI(buscycle)) {
+			uint16_t data = 0;
+			internal = emulated_addr_read(addr, &data);
+			words[wordidx] = data;
+		} else if (buscycle == QUNIBUS_CYCLE_DATOB) {
+			// A00=1: upper byte, A00=0: lower byte
+			uint16_t data = words[wordidx];
+			internal = emulated_addr_write_b(addr, (addr & 1) ? (data >> 8) : (data & 0xff));
+		} else
+			internal = emulated_addr_write_w(addr, words[wordidx]);
+		// DMA into own device register: ARM logic completes before next cycle
+		wait_deviceregister_ack();
+		if (!internal) {
+			// no physical slave: bus timeout
+			final_dma_state = DMA_STATE_TIMEOUTSTOP;
+			break;
+		} else if (wordidx + 1 < dma->wordcount
+				&& (latches[SIM_INITIALIZATIONSIGNAL_LATCH] & INITIALIZATIONSIGNAL_INIT)) {
+			final_dma_state = DMA_STATE_INITSTOP;
+			break;
+		}
+		addr += 2;
+		seg_words_left--;
+	}
+	dma->cur_status = final_dma_state; // signal to ARM
+	// result of this chunk, stable while a ping-pong successor runs
+	dma->done_addr[dma->cur_buffer] = dma->cur_addr;
+	dma->done_status[dma->cur_buffer] = final_dma_state;
+
+	if (final_dma_state == DMA_STATE_READY && dma->next_valid) {
+		// ping-pong: ARM queued next chunk in other half of words[].
+		// Arbitrate again, ARM processes this chunk in parallel.
+		dma->startaddr = dma->next_startaddr;
+		dma->wordcount = dma->next_wordcount;
+		dma->cur_buffer ^= 1;
+		dma->next_valid = 0;
+		dma_pending = true;
+	}
+
+	// for cpu access: ARM CPU thread ends looping now
+	__sync_synchronize();
+	EVENT_SIGNAL(*mailbox_ram, dma);
+	// for device DMA: qunibusadapter worker() waits for signal
+	if (!dma->cpu_access)
+		raise_interrupt();
+}
+
+// Grant DMA and INTR requests.
+// Is called only if bus not blocked by a deviceregister event.
+// result: true if a request was executed
+bool pru_sim_c::do_arbitration(void)
+{
+	// NPR before BR7..BR4
+	if (dma_pending) {
+		dma_pending = false;
+		do_dma();
+		return true;
+	}
+
+	uint8_t intr_request_mask = device_request_mask & PRIORITY_ARBITRATION_INTR_MASK;
+	if (emulate_cpu) {
+		// emulated CPU decides about GRANT, see sm_arb_worker_cpu():
+		// one arbitration cycle per ARM2PRU_ARB_GRANT_INTR_REQUESTS,
+		// the CPU thread waits until ifs_intr_arbitration_pending is cleared.
+		if (!mailbox_ram->arbitrator.ifs_intr_arbitration_pending)
+			return false;
+		if (!EVENT_IS_ACKED(*mailbox_ram, intr_slave))
+			return false; // CPU still busy with previous vector
+		mailbox_ram->arbitrator.ifs_intr_arbitration_pending = false;
+	}
+	if (!intr_request_mask)
+		return false;
+	// index of highest requested level, 0 = BR4 ... 3 = BR7
+	unsigned level_index = 3;
+	while (!(intr_request_mask & (1 << level_index)))
+		level_index--;
+
+	// previous INTR of this level must have been processed by ARM
+	if (!EVENT_IS_ACKED(*mailbox_ram, intr_master[level_index]))
+		return false;
+	if (emulate_cpu) {
+		uint8_t ifs_priority_level = mailbox_ram->arbitrator.ifs_priority_level;
+		if (ifs_priority_level == CPU_PRIORITY_LEVEL_FETCHING
+				|| level_index + 4 <= ifs_priority_level)
+			return false;
+	}
+
+	device_request_mask &= ~(1 << level_index);
+	uint16_t vector = mailbox_ram->intr.vector[level_index];
+	if (emulate_cpu) {
+		// CPU receives vector, see sm_intr_slave
+		mailbox_ram->arbitrator.ifs_priority_level = CPU_PRIORITY_LEVEL_FETCHING;
+		mailbox_ram->events.intr_slave.vector = vector;
+		EVENT_SIGNAL(*mailbox_ram, intr_slave);
+	}
+	// INTR transaction complete, see sm_intr_master
+	EVENT_SIGNAL(*mailbox_ram, intr_master[level_index]);
+	raise_interrupt();
+	return true;
+}
+
+// Execute one ARM2PRU_* opcode.
+// Union data in mailbox valid now, ACK by clearing arm2pru_req.
+void pru_sim_c::do_arm2pru_request(void)
+{
+	uint32_t arm2pru_req_cached = mailbox_ram->arm2pru_req;
+	__sync_synchronize();
+
+	switch (arm2pru_req_cached) {
+	case ARM2PRU_NONE:
+		return;
+	case ARM2PRU_NOP: // needed to probe PRU run state
+	case ARM2PRU_HALT: // simulator keeps running
+	case ARM2PRU_ARB_MODE_NONE: // no arbitration in simulation
+	case ARM2PRU_ARB_MODE_CLIENT:
+	case ARM2PRU_CPU_BUS_ACCESS: // no physical CPU
+		break;
+	case ARM2PRU_MAILBOXTEST1:
+		mailbox_ram->mailbox_test.val = mailbox_ram->mailbox_test.addr;
+		break;
+	case ARM2PRU_BUSLATCH_INIT: // set all mux registers to "neutral"
+		memset(latches, 0, sizeof(latches));
+		latches[SIM_INITIALIZATIONSIGNAL_LATCH] = SIM_POWERSIGNALS_OK;
+		break;
+	case ARM2PRU_BUSLATCH_SET: { // set a mux register and read back
+		uint8_t reg_sel = mailbox_ram->buslatch.addr & 7;
+		uint8_t bitmask = mailbox_ram->buslatch.bitmask;
+		latches[reg_sel] = (latches[reg_sel] & ~bitmask) | (mailbox_ram->buslatch.val & bitmask);
+		mailbox_ram->buslatch.val = latches[reg_sel];
+		break;
+	}
+	case ARM2PRU_BUSLATCH_GET:
+		mailbox_ram->buslatch.val = latches[mailbox_ram->buslatch.addr & 7];
+		break;
+	case ARM2PRU_BUSLATCH_EXERCISER: // 8 byte writes, then 8 byte reads
+		for (unsigned i = 0; i < 8; i++)
+			latches[mailbox_ram->buslatch_exerciser.addr[i] & 7] =
+					mailbox_ram->buslatch_exerciser.writeval[i];
+		for (unsigned i = 0; i < 8; i++)
+			mailbox_ram->buslatch_exerciser.readval[i] =
+					latches[mailbox_ram->buslatch_exerciser.addr[i] & 7];
+		break;
+	case ARM2PRU_BUSLATCH_TEST: // loop back of addr and data lines
+		latches[2] = mailbox_ram->buslatch_test.addr_0_7;
+		latches[3] = mailbox_ram->buslatch_test.addr_8_15;
+		latches[5] = mailbox_ram->buslatch_test.data_0_7;
+		latches[6] = mailbox_ram->buslatch_test.data_8_15;
+		break;
+	case ARM2PRU_INITALIZATIONSIGNAL_SET: {
+		// signal id is bit mask in initialization signal latch
+		uint8_t mask = mailbox_ram->initializationsignal.id & INITIALIZATIONSIGNAL_ANY;
+		if (mailbox_ram->initializationsignal.val)
+			latches[SIM_INITIALIZATIONSIGNAL_LATCH] |= mask;
+		else
+			latches[SIM_INITIALIZATIONSIGNAL_LATCH] &= ~mask;
+		break;
+	}
+	case ARM2PRU_ADDRESS_OVERLAY:
+		address_overlay = mailbox_ram->address_overlay;
+		break;
+	case ARM2PRU_DMA:
+		// executed by do_arbitration(), when bus is free
+		dma_pending = true;
+		break;
+	case ARM2PRU_INTR:
+		device_request_mask |= mailbox_ram->intr.priority_arbitration_bit;
+		// Atomically change state in a device's associated interrupt register.
+		if (mailbox_ram->intr.iopage_register_handle)
+			iopageregisters_ram->registers[mailbox_ram->intr.iopage_register_handle].value =
+					mailbox_ram->intr.iopage_register_value;
+		break;
+	case ARM2PRU_INTR_CANCEL:
+		device_request_mask &= ~mailbox_ram->intr.priority_arbitration_bit;
+		break;
+	case ARM2PRU_DMA_CANCEL:
+		// like PRU: drop ping-pong successor and device DMA not yet started
+		mailbox_ram->dma.next_valid = 0;
+		if (!mailbox_ram->dma.cpu_access)
+			dma_pending = false;
+		break;
+	case ARM2PRU_CPU_ENABLE:
+		emulate_cpu = !!mailbox_ram->param;
+		break;
+	case ARM2PRU_ARB_GRANT_INTR_REQUESTS:
+		if (emulate_cpu)
+			mailbox_ram->arbitrator.ifs_intr_arbitration_pending = true;
+		break;
+	case ARM2PRU_DDR_FILL_PATTERN: {
+		volatile uint16_t *wordaddr = ddrmem_ram->memory.words;
+		for (unsigned n = 0; n < QUNIBUS_MAX_WORDCOUNT; n++)
+			*wordaddr++ = n;
+		break;
+	}
+	case ARM2PRU_DDR_SLAVE_MEMORY:
+		// DDR memory is served by emulated_addr_read/write*() anyhow
+		break;
+	default:
+		WARNING("Simulated PRU: unknown ARM2PRU opcode %u", (unsigned) arm2pru_req_cached);
+		break;
+	}
+	__sync_synchronize();
+	mailbox_ram->arm2pru_req = ARM2PRU_NONE; // ACK: done
+}
+
+// PRU1 main loop
+void pru_sim_c::worker(void)
+{
+	unsigned idle_loops = 0;
+
+	while (!worker_terminate) {
+		bool busy = false;
+
+		do_initializationsignals();
+
+		// Delay INTR or DMA while bus halted by register access event
+		if (prucode_id == pru_c::PRUCODE_EMULATION
+				&& EVENT_IS_ACKED(*mailbox_ram, deviceregister))
+			busy |= do_arbitration();
+
+		if (mailbox_ram->arm2pru_req != ARM2PRU_NONE) {
+			do_arm2pru_request();
+			busy = true;
+		}
+
+		if (busy)
+			idle_loops = 0;
+		else if (++idle_loops > SIM_IDLE_SPIN_LOOPS)
+			timeout_c::wait_us(SIM_IDLE_SLEEP_US);
+		else
+			sched_yield();
+	}
+}
@@ -0,0 +1,102 @@
+/* pru_sim.hpp: "virtual PRU", executes the PRU1 mailbox protocol on the ARM/host
+
+ Copyright (c) 2026, QUniBone contributors
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PRU_SIM_HPP_
+#define _PRU_SIM_HPP_
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "logsource.hpp"
+#include "mailbox.h"
+#include "iopageregister.h"
+#include "ddrmem.h"
+#include "pru.hpp"
+
+/* The simulator replaces PRU0/PRU1 and the QBUS/UNIBUS.
+ * It owns the "PRU RAMs" (mailbox, iopage register tables) and the
+ * "shared DDR", which are just process memory here.
+ * A worker thread polls mailbox->arm2pru_req like the PRU1 main loop,
+ * executes DMA against emulated memory and iopage registers,
+ * and raises events with the signal/ack protocol of mailbox.h.
+ * There is no other bus master.
+ */
+// shared DDR behind ddrmem_t for zero-copy DMA buffers, see ddrmem_c::dma_buffer_alloc()
+#define PRU_SIM_DDR_DMA_POOL_SIZE	(1024*1024)
+
+class pru_sim_c: public logsource_c {
+private:
+	pthread_t pthread;
+	volatile bool worker_terminate;
+	bool worker_running;
+	enum pru_c::prucode_enum prucode_id;
+
+	// simulated PRU RAMs and DDR memory
+	volatile mailbox_t *mailbox_ram;
+	volatile pru_iopage_registers_t *iopageregisters_ram;
+	volatile ddrmem_t *ddrmem_ram;
+
+	// state of PRU1 program
+	uint8_t latches[8]; // bus latch register file, also INIT/power signals
+	uint8_t device_request_mask; // BR4..7, NPR of emulated devices, PRIORITY_ARBITRATION_BIT_*
+	bool emulate_cpu;
+	bool dma_pending; // ARM2PRU_DMA accepted, not yet executed
+	uint32_t address_overlay; // UNIBUS: ORed to DMA addresses
+	bool init_asserted; // QBUS: INIT pulse signaled
+
+	// PRU2ARM_INTERRUPT: counted, wait_event_timeout() sleeps on cond
+	pthread_mutex_t event_mutex;
+	pthread_cond_t event_cond;
+	unsigned event_count; // raised by PRU
+	unsigned event_count_received; // seen by ARM
+
+	void raise_interrupt(void);
+	void do_arm2pru_request(void);
+	void do_initializationsignals(void);
+	bool do_arbitration(void);
+	void do_dma(void);
+
+	uint8_t emulated_addr_read(uint32_t addr, uint16_t *val);
+	uint8_t emulated_addr_write_w(uint32_t addr, uint16_t w);
+	uint8_t emulated_addr_write_b(uint32_t addr, uint8_t b);
+	void iopageregisters_reset_values(void);
+	void wait_deviceregister_ack(void);
+
+public:
+	pru_sim_c();
+	~pru_sim_c();
+
+	void connect_ddrmem(void);
+	int map_prumem(unsigned pru_ram_id, void **address);
+
+	void start(enum pru_c::prucode_enum prucode_id);
+	void stop(void);
+	void worker(void);
+
+	int wait_event_timeout(unsigned timeout_us);
+};
+
+#ifndef _PRU_SIM_CPP_
+extern pru_sim_c *pru_sim; // singleton, created by pru_c on demand
+#endif
+
+#endif
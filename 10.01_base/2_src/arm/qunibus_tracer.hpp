@@ -118,6 +118,11 @@ public:
         level = 0 ;
     }
 
+    // any conditions defined, probe() needed?
+    bool active(void) {
+        return size() > 0 ;
+    }
+
     // check wether all conditions met.
     bool has_triggered(void) {
         return (size() > 0 && level >= size()) ;
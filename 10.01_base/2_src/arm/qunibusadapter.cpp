@@ -53,6 +53,8 @@
 #include <pthread.h>
 #include <assert.h>
 #include <queue>
+#include <sched.h>
+#include <sys/sysinfo.h> // get_nprocs()
 
 // TEST
 //#include <unistd.h> // sleep()
@@ -62,12 +64,12 @@
 #include "logger.hpp"
 #include "mailbox.h"
 #include "gpios.hpp"
-#include "prussdrv.h"
-#include "pruss_intc_mapping.h"
+#include "pru.hpp"
 #include "iopageregister.h"
 #include "priorityrequest.hpp"
 #include "qunibusadapter.hpp"
 #include "unibuscpu.hpp"
+#include "timeout.hpp"
 
 qunibusadapter_c *qunibusadapter; // another Singleton
 // is registered in device_c.list<devices> ... order of static constructor calls ???
@@ -99,17 +101,34 @@ qunibusadapter_c::qunibusadapter_c() :     device_c()
     line_DCLO = false;
     line_ACLO = false;
 
-    requests_mutex = PTHREAD_MUTEX_INITIALIZER;
+    intr_mailbox_mutex = PTHREAD_MUTEX_INITIALIZER;
 
     requests_init();
 
     registered_cpu = NULL;
 
 	memset(register_by_handle, 0, sizeof(register_by_handle)) ;
+	latency_last_register_handle = 0;
+	latency_last_seq = 0;
+
+	busy_poll_us.value = 0;
+	busy_poll_cpu.value = 0;
+	busy_poll_hits.value = 0;
+	busy_poll_sleeps.value = 0;
+	busy_poll_reconfigure = false;
 }
 
 bool qunibusadapter_c::on_param_changed(parameter_c *param) 
 {
+    if (param == &busy_poll_cpu) {
+        if (busy_poll_cpu.new_value > (unsigned) get_nprocs()) {
+            ERROR("busy_poll_cpu: only %d cores", get_nprocs());
+            return false;
+        }
+        busy_poll_reconfigure = true;
+    } else if (param == &busy_poll_us) {
+        busy_poll_reconfigure = true;
+    }
     // no own parameter or "enable" logic
     return device_c::on_param_changed(param); // more actions (for enable)
 }
@@ -123,10 +142,14 @@ void qunibusadapter_c::on_power_changed(signal_edge_enum aclo_edge, signal_edge_
 
 void qunibusadapter_c::on_init_changed(void) 
 {
+    requests_lock_all();
     requests_init();
     // clear all pending BR and NPR lines on PRU
+    pthread_mutex_lock(&intr_mailbox_mutex);
     mailbox->intr.priority_arbitration_bit = PRIORITY_ARBITRATION_BIT_MASK;
     mailbox_execute(ARM2PRU_INTR_CANCEL);
+    pthread_mutex_unlock(&intr_mailbox_mutex);
+    requests_unlock_all();
 }
 
 
@@ -215,6 +238,7 @@ bool qunibusadapter_c::register_device(qunibusdevice_c& device)
         device_reg->register_handle = register_handle;
 		assert(register_by_handle[register_handle] == NULL) ;
 		register_by_handle[register_handle] = device_reg ; // PRU->ARM lookup table
+		register_latency[register_handle].clear() ;
         pru_iopage_reg->value = device_reg->reset_value; // init
         pru_iopage_reg->reset_value = device_reg->reset_value;
         pru_iopage_reg->writable_bits = device_reg->writable_bits;
@@ -347,6 +371,62 @@ bool qunibusadapter_c::is_rom(uint32_t address)
 /*** Access requests in [level,slot] table ***/
 
 // initialize slot tables in empty state
+priority_request_level_c::priority_request_level_c() 
+{
+    mutex = PTHREAD_MUTEX_INITIALIZER;
+    lock_count = 0;
+    lock_contended_count = 0;
+}
+
+// lock schedule table of one level.
+// Contention is detected by a failing trylock, counted for requests_lock_statistics()
+void qunibusadapter_c::requests_lock(unsigned level_index) 
+{
+    priority_request_level_c *prl = &request_levels[level_index];
+    if (pthread_mutex_trylock(&prl->mutex)) {
+        pthread_mutex_lock(&prl->mutex);
+        prl->lock_contended_count++;
+    }
+    prl->lock_count++;
+}
+
+void qunibusadapter_c::requests_unlock(unsigned level_index) 
+{
+    pthread_mutex_unlock(&request_levels[level_index].mutex);
+}
+
+// for INIT, power fail: all levels, ascending order
+void qunibusadapter_c::requests_lock_all(void) 
+{
+    for (unsigned level_index = 0; level_index < PRIORITY_LEVEL_COUNT; level_index++)
+        requests_lock(level_index);
+}
+
+void qunibusadapter_c::requests_unlock_all(void) 
+{
+    for (int level_index = PRIORITY_LEVEL_COUNT - 1; level_index >= 0; level_index--)
+        requests_unlock(level_index);
+}
+
+void qunibusadapter_c::requests_lock_statistics(bool clear) 
+{
+    static const char *level_names[PRIORITY_LEVEL_COUNT] = { "BR4", "BR5", "BR6", "BR7", "NPR" };
+    for (unsigned level_index = 0; level_index < PRIORITY_LEVEL_COUNT; level_index++) {
+        priority_request_level_c *prl = &request_levels[level_index];
+        // counters are changed under lock, but this access is not counted
+        pthread_mutex_lock(&prl->mutex);
+        if (clear) {
+            prl->lock_count = 0;
+            prl->lock_contended_count = 0;
+        } else
+            printf("%s: %llu locks, %llu contended (%0.2f%%)\n", level_names[level_index],
+                   (unsigned long long) prl->lock_count,
+                   (unsigned long long) prl->lock_contended_count,
+                   prl->lock_count ? 100.0 * prl->lock_contended_count / prl->lock_count : 0.0);
+        pthread_mutex_unlock(&prl->mutex);
+    }
+}
+
 void qunibusadapter_c::requests_init(void) 
 {
     for (unsigned level_index = 0; level_index < PRIORITY_LEVEL_COUNT; level_index++) {
@@ -356,21 +436,39 @@ void qunibusadapter_c::requests_init(void)
         prl->slot_request_mask = 0;
         prl->active = NULL;
     }
+    for (unsigned slot = 0; slot < PRIORITY_SLOT_COUNT; slot++)
+        dma_submit_queue[slot].clear();
+}
+
+// mark request as complete and wake up DMA() or INTR() or DMA_submit() client
+void qunibusadapter_c::request_signal_complete(priority_request_c *request) 
+{
+    // Must run under requests_lock() of request level
+    pthread_mutex_lock(&request->complete_mutex);
+    request->complete = true;
+    pthread_cond_signal(&request->complete_cond);
+    pthread_mutex_unlock(&request->complete_mutex);
+
+    if (request->is_dma()) {
+        dma_request_c *dmareq = static_cast<dma_request_c *>(request);
+        if (dmareq->completion_queue)
+            dmareq->completion_queue->push(dmareq);
+    }
 }
 
 // put a request into the level/slot table
 // do not yet activate!
 void qunibusadapter_c::request_schedule(priority_request_c& request) 
 {
-    // Must run under  pthread_mutex_lock(&requests_mutex);
+    // Must run under requests_lock(request.level_index)
     priority_request_level_c *prl = &request_levels[request.level_index];
     // DEBUG_FAST("request_schedule") ;
 
     // a device may reraise on of its own interrupts, but not an DMA on same slot
-    if (dynamic_cast<dma_request_c *>(&request)) {
+    if (request.is_dma()) {
         if (prl->slot_request[request.priority_slot] != NULL)
             FATAL("Concurrent DMA requested for slot %d.", (unsigned )request.priority_slot);
-    } else if (dynamic_cast<intr_request_c *>(&request)) {
+    } else {
         if (prl->slot_request[request.priority_slot] != NULL) {
             qunibusdevice_c *slotdevice = prl->slot_request[request.priority_slot]->device;
             if (slotdevice != request.device)
@@ -390,13 +488,13 @@ void qunibusadapter_c::request_schedule(priority_request_c& request)
 }
 
 // Cancel all pending device_DMA and IRQ requests of every level.
-// requests which are active on the PRU (->active) are left running,
+// Requests which are active on the PRU (->active) are left running if already granted,
 // and the PRU terminates DMA sequences on INIT.
 void qunibusadapter_c::requests_cancel_scheduled(void) 
 {
     priority_request_c *req;
 
-    // Must run under pthread_mutex_lock(&requests_mutex);
+    // Must run under requests_lock_all()
     for (unsigned level_index = 0; level_index < PRIORITY_LEVEL_COUNT; level_index++) {
         priority_request_level_c *prl = &request_levels[level_index];
         prl->slot_request_mask = 0; // clear alls slot from request
@@ -404,24 +502,32 @@ void qunibusadapter_c::requests_cancel_scheduled(void)
 
         for (unsigned slot = 0; slot < PRIORITY_SLOT_COUNT; slot++)
             if ((req = prl->slot_request[slot])) {
-                dma_request_c *dmareq;
                 req->executing_on_PRU = false;
-                if ((dmareq = dynamic_cast<dma_request_c *>(req)))
-                    dmareq->success = false; // device gets an DMA error, but will not understand
+                if (req->is_dma())
+                    static_cast<dma_request_c *>(req)->success = false; // device gets an DMA error, but will not understand
                 prl->slot_request[slot] = NULL;
                 // signal to blocking DMA() or INTR()
-                pthread_mutex_lock(&req->complete_mutex);
-                req->complete = true;
-                pthread_cond_signal(&req->complete_cond);
-                pthread_mutex_unlock(&req->complete_mutex);
+                request_signal_complete(req);
             }
     }
+    // No ping-pong continuation of a canceled request, and no start of a
+    // DMA not yet granted. Done by PRU between its statemachine steps,
+    // so a next chunk can not be taken meanwhile.
+    mailbox_execute(ARM2PRU_DMA_CANCEL);
+    // requests queued by DMA_submit() behind the slot requests
+    for (unsigned slot = 0; slot < PRIORITY_SLOT_COUNT; slot++) {
+        dma_request_c *dmareq;
+        while ((dmareq = dma_submit_queue[slot].pop_front())) {
+            dmareq->success = false;
+            request_signal_complete(dmareq);
+        }
+    }
 }
 
 /*
  // is a request of given level active on the PRU?
  bool qunibusadapter_c::request_is_active(unsigned level_index) {
- // Must run under  pthread_mutex_lock(&requests_mutex);
+ // Must run under requests_lock(level_index)
  priority_request_level_c *prl = &request_levels[level_index];
  return (prl->active != NULL);
  }
@@ -436,7 +542,7 @@ priority_request_c *qunibusadapter_c::request_activate_lowest_slot(unsigned leve
      Is implemented on ARM as just 2 opcodes: rbit (bit reverse), clz (count number of leading zeros)
      VERY FAST (without sorting list)
      */
-    // Must run under  pthread_mutex_lock(&);
+    // Must run under requests_lock(level_index)
     priority_request_level_c *prl = &request_levels[level_index];
     priority_request_c *rq;
 
@@ -461,6 +567,8 @@ priority_request_c *qunibusadapter_c::request_activate_lowest_slot(unsigned leve
 }
 
 // is any request of higher or same level executed? Is the next request executed delayed?
+// Higher levels are read without their lock: result is a snapshot,
+// only used to decide when an interrupt register is updated.
 bool qunibusadapter_c::request_is_blocking_active(uint8_t level_index) 
 {
     while (level_index < PRIORITY_LEVEL_COUNT) {
@@ -474,18 +582,58 @@ bool qunibusadapter_c::request_is_blocking_active(uint8_t level_index)
     return false;
 }
 
+// helper: DMA address as expected by PRU
+static uint32_t pru_dma_addr(uint32_t addr) 
+{
+#if defined(QBUS)
+    // QBUS PRU generates BS7 from IOpage bit 22. UniBone PRU doesn't handle it.
+    if (addr >= qunibus->iopage_start_addr)
+        return addr | QUNIBUS_IOPAGE_ADDR_BITMASK ;
+#endif
+    return addr ;
+}
+
+// helper: ping-pong, setup next chunk of an active device DMA in the free half
+// of the mailbox buffer. PRU continues with it after the current chunk,
+// without waiting for ARM. Not done if a higher prioritized slot waits for NPR.
+void qunibusadapter_c::request_queue_next_chunk(dma_request_c *dmareq) 
+{
+    priority_request_level_c *prl = &request_levels[PRIORITY_LEVEL_INDEX_NPR];
+    // Must run under requests_lock(PRIORITY_LEVEL_INDEX_NPR)
+    dmareq->next_chunk_words = 0;
+    uint32_t next_start_addr = dmareq->chunk_qunibus_start_addr + 2 * dmareq->chunk_words;
+    unsigned wordcount_remaining = dmareq->wordcount - dmareq->wordcount_completed_chunks()
+                                   - dmareq->chunk_words;
+    if (wordcount_remaining == 0)
+        return; // current chunk is the last
+    if (prl->slot_request_mask & ((1u << dmareq->priority_slot) - 1))
+        return; // re-arbitrate between slots
+    unsigned next_words = std::min((unsigned) PRU_DMA_PINGPONG_WORDCOUNT, wordcount_remaining);
+    volatile uint16_t *next_words_buffer = mailbox->dma.words
+                                           + (dmareq->chunk_buffer ^ 1) * PRU_DMA_PINGPONG_WORDCOUNT;
+    if (QUNIBUS_CYCLE_IS_DATO(dmareq->qunibus_control))
+        memcpy((void*) next_words_buffer,
+               dmareq->buffer + (next_start_addr - dmareq->qunibus_start_addr) / 2, 2 * next_words);
+    mailbox->dma.next_startaddr = pru_dma_addr(next_start_addr);
+    mailbox->dma.next_wordcount = next_words;
+    dmareq->next_chunk_words = next_words;
+    __sync_synchronize(); // data and next_* valid before PRU sees next_valid
+    mailbox->dma.next_valid = 1;
+}
+
 // helper: push the active request to the PRU for execution
 // VB: the next request to schedule already calculated and saved in priority_request_level_c.active
 void qunibusadapter_c::request_execute_active_on_PRU(unsigned level_index) 
 {
     priority_request_level_c *prl = &request_levels[level_index];
     assert(prl->active);
-    // Must run under  pthread_mutex_lock(&requests_mutex);
+    // Must run under requests_lock(level_index)
     // DEBUG_FAST("request_execute_active_on_PRU(level_idx=%u)", level_index);
     if (level_index == PRIORITY_LEVEL_INDEX_NPR) {
 
-        dma_request_c *dmareq = dynamic_cast<dma_request_c *>(prl->active);
-        assert(dmareq);
+        // NPR level holds only DMA requests
+        assert(prl->active->is_dma());
+        dma_request_c *dmareq = static_cast<dma_request_c *>(prl->active);
 
         // We do the device_DMA transfer in chunks so we can handle arbitrary buffer sizes.
         // (the PRU mailbox has limited space available.)
@@ -494,25 +642,41 @@ void qunibusadapter_c::request_execute_active_on_PRU(unsigned level_index)
         unsigned wordcount_remaining = dmareq->wordcount - dmareq->wordcount_completed_chunks();
         //dmareq->chunk_max_words = 2; // TEST
         dmareq->chunk_words = std::min(dmareq->chunk_max_words, wordcount_remaining);
+        // ping-pong: big device transfers through the mailbox use both buffer halves,
+        // so the PRU streams chunks while ARM copies.
+        bool pingpong = !dmareq->buffer_physical && !dmareq->is_cpu_access
+                        && !dmareq->segment_count && wordcount_remaining > PRU_MAX_DMA_WORDCOUNT;
+        if (pingpong)
+            dmareq->chunk_words = std::min((unsigned) PRU_DMA_PINGPONG_WORDCOUNT, wordcount_remaining);
+        dmareq->chunk_buffer = 0;
+        dmareq->next_chunk_words = 0;
+        mailbox->dma.cur_buffer = 0;
+        mailbox->dma.next_valid = 0;
 
         assert(dmareq->chunk_words); // if complete, the dmareq should not be active anymore
-        if (dmareq->chunk_qunibus_start_addr >= qunibus->iopage_start_addr) {
-#if defined(UNIBUS)
-            // UniBone PRU doesn't handle IOpage addresses marked with IOpage bit 22
-            mailbox->dma.startaddr = dmareq->chunk_qunibus_start_addr ;
-#elif defined(QBUS)
-            mailbox->dma.startaddr = dmareq->chunk_qunibus_start_addr | QUNIBUS_IOPAGE_ADDR_BITMASK ;
-#endif
-        } else
-            mailbox->dma.startaddr = dmareq->chunk_qunibus_start_addr ;
+        mailbox->dma.startaddr = pru_dma_addr(dmareq->chunk_qunibus_start_addr);
+        // scatter-gather: all segments in one chunk, see DMA_submit_segments()
+        mailbox->dma.segmentcount = dmareq->segment_count;
+        for (unsigned i = 0; i < dmareq->segment_count; i++) {
+            mailbox->dma.segments[i].startaddr = pru_dma_addr(dmareq->segments[i].addr);
+            mailbox->dma.segments[i].wordcount = dmareq->segments[i].wordcount;
+        }
         mailbox->dma.buscycle = dmareq->qunibus_control;
         mailbox->dma.wordcount = dmareq->chunk_words;
         mailbox->dma.cpu_access = dmareq->is_cpu_access;
 
-        // Copy outgoing data into mailbox device_DMA buffer
-        if (QUNIBUS_CYCLE_IS_DATO(dmareq->qunibus_control)) {
-            memcpy((void*) mailbox->dma.words, dmareq->chunk_buffer_start(),
-                   2 * dmareq->chunk_words);
+        if (dmareq->buffer_physical) {
+            // zero-copy: PRU accesses device buffer in DDR directly
+            mailbox->dma.ddr_words = dmareq->buffer_physical + 2 * dmareq->wordcount_completed_chunks();
+        } else {
+            mailbox->dma.ddr_words = 0;
+            // Copy outgoing data into mailbox device_DMA buffer
+            if (QUNIBUS_CYCLE_IS_DATO(dmareq->qunibus_control)) {
+                memcpy((void*) mailbox->dma.words, dmareq->chunk_buffer_start(),
+                       2 * dmareq->chunk_words);
+            }
+            if (pingpong)
+                request_queue_next_chunk(dmareq);
         }
 
         //
@@ -523,7 +687,7 @@ void qunibusadapter_c::request_execute_active_on_PRU(unsigned level_index)
             "request_execute_active_on_PRU() DMA: dev %s, ->active = dma_request %p, start = %s, control=%u, wordcount=%u, data=%06o ...",
             dmareq->device ? dmareq->device->name.value.c_str() : "none", dmareq,
             qunibus->addr2text(mailbox->dma.startaddr), (unsigned) mailbox->dma.buscycle,
-            (unsigned) mailbox->dma.wordcount, (unsigned) mailbox->dma.words[0]);
+            (unsigned) mailbox->dma.wordcount, (unsigned) dmareq->chunk_buffer_start()[0]);
         mailbox->dma.cur_status = 0; // device DMA, not by CPU
         mailbox_execute(ARM2PRU_DMA);
         // scheduling is fast, on complete there's a signal.
@@ -541,10 +705,12 @@ void qunibusadapter_c::request_execute_active_on_PRU(unsigned level_index)
 
     } else {
         // Not DMA? must be INTR
-        intr_request_c *intrreq = dynamic_cast<intr_request_c *>(prl->active);
-        assert(intrreq);
+        assert(prl->active->is_intr());
+        intr_request_c *intrreq = static_cast<intr_request_c *>(prl->active);
 
         // Handle interrupt request to PRU. Setup mailbox:
+        // mailbox->intr is shared by all BR levels
+        pthread_mutex_lock(&intr_mailbox_mutex);
         mailbox->intr.level_index = intrreq->level_index;
         mailbox->intr.vector[intrreq->level_index] = intrreq->vector;
         if (intrreq->interrupt_register)
@@ -563,6 +729,7 @@ void qunibusadapter_c::request_execute_active_on_PRU(unsigned level_index)
         // PRU have got arbitration for an INTR of different level in the mean time:
         // assert(mailbox->events.event_intr == 0) would trigger
         mailbox_execute(ARM2PRU_INTR);
+        pthread_mutex_unlock(&intr_mailbox_mutex);
         intrreq->executing_on_PRU = true; // waiting for GRANT
         
         // PRU now changes state
@@ -580,7 +747,7 @@ void qunibusadapter_c::request_execute_active_on_PRU(unsigned level_index)
 // also called on INTR_CANCEL
 void qunibusadapter_c::request_active_complete(unsigned level_index, bool signal_complete) 
 {
-    // Must run under  pthread_mutex_lock(&requests_mutex);
+    // Must run under requests_lock(level_index)
 
     priority_request_level_c *prl = &request_levels[level_index];
     if (!prl->active) // PRU completed after INIT cleared the tables
@@ -603,14 +770,65 @@ void qunibusadapter_c::request_active_complete(unsigned level_index, bool signal
     priority_request_c *tmprq = prl->active;
     prl->active = NULL;
 
-    if (signal_complete) {
+    // slot free: next request submitted by same device competes in arbitration
+    if (level_index == PRIORITY_LEVEL_INDEX_NPR) {
+        dma_request_c *nextreq = dma_submit_queue[slot].pop_front();
+        if (nextreq)
+            request_schedule(*nextreq);
+    }
+
+    if (signal_complete)
         // signal to DMA() or INTR()
-        pthread_mutex_lock(&tmprq->complete_mutex);
-        tmprq->complete = true;
-        pthread_cond_signal(&tmprq->complete_cond);
-        pthread_mutex_unlock(&tmprq->complete_mutex);
+        request_signal_complete(tmprq);
+
+}
+
+// Microbenchmark of the scheduler tables: each loop raises one INTR on every BR level
+// and two DMAs for the same slot (2nd one via dma_submit_queue), then activates and completes
+// all of them like the worker does, but without PRU.
+// Uses private requests in the highest slot, so only run if no other requests are pending.
+void qunibusadapter_c::request_scheduler_benchmark(unsigned loops) 
+{
+    const uint8_t slot = PRIORITY_SLOT_COUNT - 1;
+    intr_request_c intrreq4(NULL), intrreq5(NULL), intrreq6(NULL), intrreq7(NULL);
+    intr_request_c *intrreqs[4] = { &intrreq4, &intrreq5, &intrreq6, &intrreq7 };
+    dma_request_c dmareq1(NULL), dmareq2(NULL);
+    dma_request_c *dmareqs[2] = { &dmareq1, &dmareq2 };
+    unsigned requests_per_loop = 4 + 2;
+    uint64_t start_ns, end_ns;
+
+    // set_priority_slot() would check slot against installed devices
+    for (unsigned i = 0; i < 4; i++) {
+        intrreqs[i]->level_index = i;
+        intrreqs[i]->priority_slot = slot;
+        intrreqs[i]->vector = 0;
     }
+    for (unsigned i = 0; i < 2; i++)
+        dmareqs[i]->priority_slot = slot;
 
+    requests_lock_all();
+    if (request_is_blocking_active(PRIORITY_LEVEL_INDEX_BR4)) {
+        requests_unlock_all();
+        ERROR("request_scheduler_benchmark(): requests pending, try again");
+        return;
+    }
+    start_ns = timeout_c::abstime_ns();
+    for (unsigned n = 0; n < loops; n++) {
+        for (unsigned i = 0; i < 4; i++)
+            request_schedule(*intrreqs[i]);
+        request_schedule(*dmareqs[0]);
+        dma_submit_queue[slot].push_back(dmareqs[1]);
+        // highest level first, as the PRU arbitrator grants
+        for (int level_index = PRIORITY_LEVEL_INDEX_NPR; level_index >= 0; level_index--)
+            while (request_activate_lowest_slot(level_index))
+                request_active_complete(level_index, true);
+    }
+    end_ns = timeout_c::abstime_ns();
+    requests_unlock_all();
+
+    printf("Scheduled, arbitrated and completed %u requests in %0.3f ms: %0.1f ns per request.\n",
+           loops * requests_per_loop, (end_ns - start_ns) / 1000000.0,
+           (double) (end_ns - start_ns) / (loops * requests_per_loop));
 }
 
 // Request a DMA cycle from Arbitrator.
@@ -624,47 +842,172 @@ void qunibusadapter_c::request_active_complete(unsigned level_index, bool signal
 void qunibusadapter_c::DMA(dma_request_c& dma_request, bool blocking, uint8_t qunibus_cycle,
                            uint32_t unibus_addr, uint16_t *buffer, uint32_t wordcount) 
 {
-    assert(dma_request.priority_slot < PRIORITY_SLOT_COUNT);
-    assert(dma_request.level_index == PRIORITY_LEVEL_INDEX_NPR);
+    // ignore calls if INIT condition
+    if (line_INIT) {
+        dma_request.complete = true;
+        return;
+    }
+    DMA_submit(dma_request, qunibus_cycle, unibus_addr, buffer, wordcount);
+
+    // DEBUG_FAST("device DMA start: %s @ %06o, len=%d", qunibus->control2text(qunibus_cycle), unibus_addr, wordcount);
 
+    if (dma_request.is_cpu_access) {
+        priority_request_level_c *prl = &request_levels[PRIORITY_LEVEL_INDEX_NPR];
+        // NO wait for PRU signal, instead busy waiting. CPU thread blocked.
+        // Reason: SPEED. CPU does high frequency single word accesses.
+        bool completed = false;
+// ARM_DEBUG_PIN1(1); // CPU20 performace
+        do {
+            // CPU thread is now spinning
+            // wait until CPU access scheduled and processed on PRU
+            // in parallel, other device threads call DMA()
+            requests_lock(PRIORITY_LEVEL_INDEX_NPR);
+            dma_request_c *activereq = static_cast<dma_request_c *>(prl->active);
+//if (activereq == &dma_request)
+//	printf("a\n") ;
+//if (DMA_STATE_IS_COMPLETE(mailbox->dma.cur_status))
+//	printf("b\n") ;
+            if ((activereq == &dma_request) && !EVENT_IS_ACKED(*mailbox, dma)) {
+                assert(activereq->is_cpu_access);
+                // transfer DATI data to buffer, set success flag, schedule next request
+                worker_device_dma_chunk_complete_event(); // do not signal, uses complete_mutex
+                EVENT_ACK(*mailbox, dma);
+                completed = true;
+            } else if (activereq == NULL)
+                // request aborted by worker_power_event()
+                completed = true;
+            requests_unlock(PRIORITY_LEVEL_INDEX_NPR);
+        } while (!completed);
+//ARM_DEBUG_PIN1(0); // CPU20 performace
+
+    } else if (blocking)
+        DMA_wait(dma_request);
+}
+
+// Queue a DMA request and return immediately.
+// A device may submit several requests for the same priority slot:
+// the first is scheduled for arbitration, the others wait in dma_submit_queue[slot]
+// and are scheduled in order as soon as the previous completes.
+// Completion is signaled by dma_request.complete/complete_cond (see DMA_wait())
+// and, if set, by appending to dma_request.completion_queue.
+// Each submitted request needs its own dma_request_c and buffer,
+// which must not be touched before completion.
+void qunibusadapter_c::DMA_submit(dma_request_c& dma_request, uint8_t qunibus_cycle,
+                                  uint32_t unibus_addr, uint16_t *buffer, uint32_t wordcount) 
+{
     // setup device request
     assert(wordcount > 0);
     assert((unibus_addr + 2*wordcount) <= qunibus->addr_space_byte_count);
     // lowest priority reserved for CPU
     assert(!dma_request.is_cpu_access || dma_request.priority_slot == 31);
 
+    dma_request.qunibus_control = qunibus_cycle;
+    dma_request.qunibus_start_addr = unibus_addr;
+    dma_request.buffer = buffer;
+    dma_request.wordcount = wordcount;
+    dma_request.segment_count = 0;
+    DMA_submit_request(dma_request);
+}
+
+// Scatter-gather DMA: transfer several address ranges with one arbitration,
+// all with the same bus cycle, in list order.
+// buffer[] holds the data of all segments in sequence.
+// Total wordcount limited to PRU mailbox capacity (or zero-copy limit),
+// as the request is not chunked.
+// On bus timeout, dma_request.qunibus_end_addr is the offending address.
+void qunibusadapter_c::DMA_submit_segments(dma_request_c& dma_request, uint8_t qunibus_cycle,
+        unsigned segment_count, const dma_segment_t *segments, uint16_t *buffer) 
+{
+    uint32_t wordcount = 0;
+    assert(segment_count > 0 && segment_count <= PRU_MAX_DMA_SEGMENTCOUNT);
+    assert(!dma_request.is_cpu_access);
+    for (unsigned i = 0; i < segment_count; i++) {
+        assert(segments[i].wordcount > 0);
+        assert((segments[i].addr + 2*segments[i].wordcount) <= qunibus->addr_space_byte_count);
+        dma_request.segments[i] = segments[i];
+        wordcount += segments[i].wordcount;
+    }
+    assert(wordcount <= (ddrmem->dma_buffer_physical(buffer, wordcount) ?
+                         PRU_MAX_DMA_DDR_WORDCOUNT : PRU_MAX_DMA_WORDCOUNT));
+
+    dma_request.qunibus_control = qunibus_cycle;
+    dma_request.qunibus_start_addr = segments[0].addr;
+    dma_request.buffer = buffer;
+    dma_request.wordcount = wordcount;
+    dma_request.segment_count = segment_count;
+    DMA_submit_request(dma_request);
+}
+
+// Like DMA(), but with a scatter-gather list. Not for CPU accesses.
+void qunibusadapter_c::DMA_segments(dma_request_c& dma_request, bool blocking,
+                                    uint8_t qunibus_cycle, unsigned segment_count, const dma_segment_t *segments,
+                                    uint16_t *buffer) 
+{
+    // ignore calls if INIT condition
+    if (line_INIT) {
+        dma_request.complete = true;
+        return;
+    }
+    DMA_submit_segments(dma_request, qunibus_cycle, segment_count, segments, buffer);
+    if (blocking)
+        DMA_wait(dma_request);
+}
+
+// common part of DMA_submit() and DMA_submit_segments():
+// buffer, wordcount, cycle and addresses already set
+void qunibusadapter_c::DMA_submit_request(dma_request_c& dma_request) 
+{
+    assert(dma_request.priority_slot < PRIORITY_SLOT_COUNT);
+    assert(dma_request.level_index == PRIORITY_LEVEL_INDEX_NPR);
+
 #if defined(UNIBUS)
     if (!dma_request.is_cpu_access && qunibus->is_address_overlay_active())
-        ERROR("UNIBUS ADDR lines overlayed (for M9312 boot) @ %s. Only CPU 24/26 access intended!", qunibus->addr2text(unibus_addr)) ;
+        ERROR("UNIBUS ADDR lines overlayed (for M9312 boot) @ %s. Only CPU 24/26 access intended!", qunibus->addr2text(dma_request.qunibus_start_addr)) ;
 #endif
 
     // ignore calls if INIT condition
     if (line_INIT) {
-        dma_request.complete = true;
+        dma_request.success = false;
+        requests_lock(PRIORITY_LEVEL_INDEX_NPR);
+        request_signal_complete(&dma_request);
+        requests_unlock(PRIORITY_LEVEL_INDEX_NPR);
         return;
     }
-    pthread_mutex_lock(&requests_mutex); // lock schedule table operations
+    requests_lock(PRIORITY_LEVEL_INDEX_NPR); // lock schedule table operations
 
     // In contrast to re-raised INTR, overlapping DMA requests from same board
-    // must not be ignored (different DATA situation) and are an device implementation error.
-    // If a device indeed has multiple DMA channels, it must use different pseudo-slots.
+    // are not merged (different DATA situation), but queued behind the slot.
+    // If a device indeed has multiple parallel DMA channels, it must use different pseudo-slots.
     priority_request_level_c *prl = &request_levels[PRIORITY_LEVEL_INDEX_NPR];
-    assert(prl->slot_request[dma_request.priority_slot] == NULL); // not scheduled or prev completed
+    assert(prl->slot_request[dma_request.priority_slot] != &dma_request); // prev completed
 
     // 	dma_request.level-index, priority_slot in constructor
     dma_request.complete = false;
     dma_request.success = false;
     dma_request.executing_on_PRU = false;
-    dma_request.qunibus_control = qunibus_cycle;
-    dma_request.qunibus_start_addr = unibus_addr;
-    dma_request.chunk_qunibus_start_addr = unibus_addr;
+    dma_request.chunk_qunibus_start_addr = dma_request.qunibus_start_addr;
     dma_request.qunibus_end_addr = 0; // last transfered addr, or error position
-    dma_request.buffer = buffer;
-    dma_request.wordcount = wordcount;
-    dma_request.chunk_max_words = PRU_MAX_DMA_WORDCOUNT; // PRU limit, maybe less
-    _DEBUG("DMA() req: dev %s, %s @ %s, wordcount %d",
+    // buffer in shared DDR: no copy, no mailbox size limit
+    if (dma_request.is_cpu_access)
+        dma_request.buffer_physical = 0;
+    else
+        dma_request.buffer_physical = ddrmem->dma_buffer_physical(dma_request.buffer, dma_request.wordcount);
+    if (dma_request.buffer_physical)
+        dma_request.chunk_max_words = PRU_MAX_DMA_DDR_WORDCOUNT;
+    else
+        dma_request.chunk_max_words = PRU_MAX_DMA_WORDCOUNT; // PRU limit, maybe less
+    _DEBUG("DMA() req: dev %s, %s @ %s, wordcount %d, segments %u",
            dma_request.device ? dma_request.device->name.value.c_str() : "none",
-           qunibus_c::control2text(qunibus_cycle), qunibus->addr2text(unibus_addr), wordcount);
+           qunibus_c::control2text(dma_request.qunibus_control),
+           qunibus->addr2text(dma_request.qunibus_start_addr), dma_request.wordcount,
+           dma_request.segment_count);
+
+    if (prl->slot_request[dma_request.priority_slot] != NULL) {
+        // slot busy with previous request of this device: queue
+        dma_submit_queue[dma_request.priority_slot].push_back(&dma_request);
+        requests_unlock(PRIORITY_LEVEL_INDEX_NPR);
+        return;
+    }
 
     // put into schedule tables
 
@@ -676,49 +1019,19 @@ void qunibusadapter_c::DMA(dma_request_c& dma_request, bool blocking, uint8_t qu
         request_activate_lowest_slot(dma_request.level_index);
         request_execute_active_on_PRU(dma_request.level_index);
     }
-    pthread_mutex_unlock(&requests_mutex);
-
-    // DEBUG_FAST("device DMA start: %s @ %06o, len=%d", qunibus->control2text(qunibus_cycle), unibus_addr, wordcount);
-
-    if (dma_request.is_cpu_access) {
-        // NO wait for PRU signal, instead busy waiting. CPU thread blocked.
-        // Reason: SPEED. CPU does high frequency single word accesses.
-        bool completed = false;
-// ARM_DEBUG_PIN1(1); // CPU20 performace
-        do {
-            // CPU thread is now spinning
-            // wait until CPU access scheduled and processed on PRU
-            // in parallel, other device threads call DMA()
-            pthread_mutex_lock(&requests_mutex);
-            dma_request_c *activereq = dynamic_cast<dma_request_c *>(prl->active);
-//if (activereq == &dma_request)
-//	printf("a\n") ;
-//if (DMA_STATE_IS_COMPLETE(mailbox->dma.cur_status))
-//	printf("b\n") ;
-            if ((activereq == &dma_request) && !EVENT_IS_ACKED(*mailbox, dma)) {
-                assert(activereq->is_cpu_access);
-                // transfer DATI data to buffer, set success flag, schedule next request
-                worker_device_dma_chunk_complete_event(); // do not signal, uses complete_mutex
-                EVENT_ACK(*mailbox, dma);
-                completed = true;
-            } else if (activereq == NULL)
-                // request aborted by worker_power_event()
-                completed = true;
-            pthread_mutex_unlock(&requests_mutex); //&dma_request.complete_mutex);
-        } while (!completed);
-//ARM_DEBUG_PIN1(0); // CPU20 performace
+    requests_unlock(PRIORITY_LEVEL_INDEX_NPR);
+}
 
-    } else if (blocking) {
-        pthread_mutex_lock(&dma_request.complete_mutex);
-        // DMA() is blocking: Wait for request to finish.
-        //	pthread_mutex_lock(&dma_request.mutex);
-        while (!dma_request.complete) {
-            int res = pthread_cond_wait(&dma_request.complete_cond,
-                                        &dma_request.complete_mutex);
-            assert(!res);
-        }
-        pthread_mutex_unlock(&dma_request.complete_mutex);
+// Wait for a request started with DMA_submit() or non-blocking DMA() to complete
+void qunibusadapter_c::DMA_wait(dma_request_c& dma_request) 
+{
+    pthread_mutex_lock(&dma_request.complete_mutex);
+    while (!dma_request.complete) {
+        int res = pthread_cond_wait(&dma_request.complete_cond,
+                                    &dma_request.complete_mutex);
+        assert(!res);
     }
+    pthread_mutex_unlock(&dma_request.complete_mutex);
 }
 
 // do DATO/DATI as master CPU.
@@ -760,7 +1073,7 @@ void qunibusadapter_c::INTR(intr_request_c& intr_request,
     }
 
     priority_request_level_c *prl = &request_levels[intr_request.level_index];
-    pthread_mutex_lock(&requests_mutex); // lock schedule table operations
+    requests_lock(intr_request.level_index); // lock schedule table operations
 //if (intr_request.device->log_level == LL_DEBUG)
     DEBUG_FAST("INTR() req: dev %s, slot/level/vector= %d/%d/%03o",
           intr_request.device->name.value.c_str(), (unsigned ) intr_request.priority_slot,
@@ -769,9 +1082,9 @@ void qunibusadapter_c::INTR(intr_request_c& intr_request,
     // or waiting in the schedule table?
     // If yes: do not re-raise, will be completed at some time later.
     if (prl->slot_request[intr_request.priority_slot] != NULL) {
+        assert(prl->slot_request[intr_request.priority_slot]->is_intr());
         intr_request_c *scheduled_intr_req =
-            dynamic_cast<intr_request_c *>(prl->slot_request[intr_request.priority_slot]);
-        assert(scheduled_intr_req);
+            static_cast<intr_request_c *>(prl->slot_request[intr_request.priority_slot]);
         // A device may re-raised a pending INTR again
         // (quite normal situation when other ISRs block, CPU overload)
         // A re-raise will be ignored.
@@ -785,7 +1098,7 @@ void qunibusadapter_c::INTR(intr_request_c& intr_request,
         // it must use different pseudo-slots.
 
         // scheduled and request_active_complete() not called
-        pthread_mutex_unlock(&requests_mutex);
+        requests_unlock(intr_request.level_index);
         if (interrupt_register) {
             DEBUG_FAST("INTR() delayed with IR");
             // if device re-raises a blocked INTR, CSR must complete immediately
@@ -831,7 +1144,7 @@ void qunibusadapter_c::INTR(intr_request_c& intr_request,
         // else activation triggered by PRU signal in worker()
     }
 
-    pthread_mutex_unlock(&requests_mutex);  // work on schedule table finished
+    requests_unlock(intr_request.level_index);  // work on schedule table finished
 
     /*
      // If INTR() is blocking: Wait for request to finish.
@@ -856,13 +1169,15 @@ void qunibusadapter_c::cancel_INTR(intr_request_c& intr_request)
     if (prl->slot_request[intr_request.priority_slot] == NULL)
         return; // not scheduled or active
 
-    pthread_mutex_lock(&requests_mutex); // lock schedule table operations
+    requests_lock(level_index); // lock schedule table operations
     if (&intr_request == prl->active) {
         // already on PRU
         assert(level_index <= PRIORITY_LEVEL_INDEX_BR7);
+        pthread_mutex_lock(&intr_mailbox_mutex);
         mailbox->intr.priority_arbitration_bit =
             priority_level_idx_to_arbitration_bit[level_index];
         mailbox_execute(ARM2PRU_INTR_CANCEL);
+        pthread_mutex_unlock(&intr_mailbox_mutex);
         request_active_complete(level_index, true);
 
         // restart next request
@@ -881,7 +1196,7 @@ void qunibusadapter_c::cancel_INTR(intr_request_c& intr_request)
     pthread_cond_signal(&intr_request.complete_cond);
     pthread_mutex_unlock(&intr_request.complete_mutex);
 
-    pthread_mutex_unlock(&requests_mutex); // lock schedule table operations
+    requests_unlock(level_index); // lock schedule table operations
 
 }
 
@@ -900,11 +1215,11 @@ void qunibusadapter_c::worker_init_event()
         }
 
     // Clear bus request queues,
-    pthread_mutex_lock(&requests_mutex);
+    requests_lock_all();
     requests_cancel_scheduled();
     // reset all scheduled tables, also requests on PRU
     requests_init();
-    pthread_mutex_unlock(&requests_mutex);
+    requests_unlock_all();
 }
 
 void qunibusadapter_c::worker_power_event(signal_edge_enum aclo_edge, signal_edge_enum dclo_edge) 
@@ -927,11 +1242,11 @@ void qunibusadapter_c::worker_power_event(signal_edge_enum aclo_edge, signal_edg
     // in true power fail, terminate pending DMA/CPU transfer
     if (dclo_edge == SIGNAL_EDGE_RAISING) {
         // Clear bus request queues,
-        pthread_mutex_lock(&requests_mutex);
+        requests_lock_all();
         requests_cancel_scheduled();
         // reset all scheduled tables, also requests on PRU
         requests_init();
-        pthread_mutex_unlock(&requests_mutex);
+        requests_unlock_all();
     }
 }
 
@@ -1023,6 +1338,74 @@ void qunibusadapter_c::worker_deviceregister_event()
     }
 }
 
+// PRU reports SSYN/RPLY hold time of last deviceregister event after ACK,
+// by setting hold_seq. Events raised without bus cycle (DMA to own registers)
+// are never reported and are overwritten by the next event.
+void qunibusadapter_c::deviceregister_latency_collect() 
+{
+    if (latency_last_register_handle == 0)
+        return;
+    if (mailbox->events.deviceregister.hold_seq != latency_last_seq)
+        return; // not yet reported
+    __sync_synchronize(); // hold_cycles written before hold_seq
+    register_latency[latency_last_register_handle].record(
+        (uint64_t) mailbox->events.deviceregister.hold_cycles * PRU_CYCLE_NS);
+    latency_last_register_handle = 0;
+}
+
+// any PRU event the worker would process?
+bool qunibusadapter_c::mailbox_events_pending() 
+{
+    if (!EVENT_IS_ACKED(*mailbox, init) || !EVENT_IS_ACKED(*mailbox, power)
+            || !EVENT_IS_ACKED(*mailbox, deviceregister)
+            || !EVENT_IS_ACKED(*mailbox, intr_slave))
+        return true;
+    if (!EVENT_IS_ACKED(*mailbox, dma) && !mailbox->dma.cpu_access)
+        return true;
+    for (unsigned level_index = 0; level_index < 4; level_index++)
+        if (!EVENT_IS_ACKED(*mailbox, intr_master[level_index]))
+            return true;
+    return false;
+}
+
+// Busy polling: SCHED_FIFO, so not time-sliced against other
+// RT device workers while spinning. Optionally pinned to a dedicated core.
+// Simulated PRU is just another thread: keep time-share scheduling.
+void qunibusadapter_c::worker_busy_poll_configure() 
+{
+    struct sched_param params;
+    int policy;
+    cpu_set_t cpuset;
+    int ret;
+
+    busy_poll_reconfigure = false;
+    if (pru->is_simulated())
+        return;
+
+    if (busy_poll_us.value > 0) {
+        policy = SCHED_FIFO;
+        params.sched_priority = worker_sched_priority;
+    } else {
+        policy = worker_sched_policy;
+        params.sched_priority = worker_sched_priority;
+    }
+    ret = pthread_setschedparam(pthread_self(), policy, &params);
+    if (ret)
+        WARNING("busy poll: can not set scheduling policy, error %d", ret);
+
+    CPU_ZERO(&cpuset);
+    if (busy_poll_us.value > 0 && busy_poll_cpu.value > 0)
+        CPU_SET(busy_poll_cpu.value - 1, &cpuset);
+    else
+        for (int i = 0; i < get_nprocs(); i++)
+            CPU_SET(i, &cpuset);
+    ret = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    if (ret)
+        WARNING("busy poll: can not set cpu affinity, error %d", ret);
+    INFO("busy poll: %u us, %s", busy_poll_us.value,
+         (busy_poll_us.value > 0 && busy_poll_cpu.value > 0) ? "pinned" : "not pinned");
+}
+
 // called by PRU signal when DMA transmission complete
 // Called for device DMA() chunk,
 // or cpu_DATA_transfer()
@@ -1030,30 +1413,36 @@ void qunibusadapter_c::worker_device_dma_chunk_complete_event()
 {
     priority_request_level_c *prl = &request_levels[PRIORITY_LEVEL_INDEX_NPR];
     bool more_chunks;
-    // Must run under pthread_mutex_lock(&requests_mutex) ;
-
-    dma_request_c *dmareq = dynamic_cast<dma_request_c *>(prl->active);
-
-    assert(dmareq != NULL);
-    // fix PRU data struct: remove IOPAGE bit from mailbox struct, was set im mailbox_execute()
-    mailbox->dma.startaddr &= ~QUNIBUS_IOPAGE_ADDR_BITMASK ;
-    mailbox->dma.cur_addr &= ~QUNIBUS_IOPAGE_ADDR_BITMASK ;
-    dmareq->qunibus_end_addr = mailbox->dma.cur_addr; // track end of transmission, eror position
-    unsigned wordcount_transferred = dmareq->wordcount_completed_chunks()
-                                     + mailbox->dma.wordcount;
+    // Must run under requests_lock(PRIORITY_LEVEL_INDEX_NPR)
+
+    dma_request_c *dmareq = static_cast<dma_request_c *>(prl->active); // NPR: only DMA
+
+    if (dmareq == NULL)
+        return; // ping-pong chunk of a request canceled by INIT
+    // result of chunk in buffer half "chunk_buffer". PRU may already run the next chunk,
+    // so mailbox startaddr, wordcount, cur_* are not valid here.
+    // remove IOPAGE bit, was set in request_execute_active_on_PRU()
+    uint8_t chunk_status = mailbox->dma.done_status[dmareq->chunk_buffer];
+    uint32_t chunk_end_addr = mailbox->dma.done_addr[dmareq->chunk_buffer]
+                              & ~QUNIBUS_IOPAGE_ADDR_BITMASK;
+    dmareq->qunibus_end_addr = chunk_end_addr; // track end of transmission, eror position
+    unsigned wordcount_transferred = dmareq->wordcount_completed_chunks() + dmareq->chunk_words;
     assert(wordcount_transferred <= dmareq->wordcount);
     assert(!dmareq->is_cpu_access || dmareq->wordcount == 1); // CPU accesses only single words
-    if (QUNIBUS_CYCLE_IS_DATI(mailbox->dma.buscycle)) {
+    if (QUNIBUS_CYCLE_IS_DATI(dmareq->qunibus_control) && !dmareq->buffer_physical) {
         // guard against buffer overrun
         // PRU read chunk data from QBUS/UNIBUS into mailbox
         // copy result cur_DMA_wordcount from mailbox->DMA buffer to cur_DMA_buffer
-        memcpy(dmareq->chunk_buffer_start(), (void *) mailbox->dma.words,
-               2 * mailbox->dma.wordcount);
+        memcpy(dmareq->chunk_buffer_start(),
+               (void *) (mailbox->dma.words + dmareq->chunk_buffer * PRU_DMA_PINGPONG_WORDCOUNT),
+               2 * dmareq->chunk_words);
     }
-    if (mailbox->dma.cur_status != DMA_STATE_READY) {
+    if (chunk_status != DMA_STATE_READY) {
         // failure: abort remaining chunks
         dmareq->success = false;
         more_chunks = false;
+        dmareq->next_chunk_words = 0;
+        mailbox->dma.next_valid = 0;
     } else if (wordcount_transferred == dmareq->wordcount) {
         // last chunk completed
         dmareq->success = true;
@@ -1061,22 +1450,34 @@ void qunibusadapter_c::worker_device_dma_chunk_complete_event()
     } else {
         // more data to transfer: next chunk.
         assert(!dmareq->is_cpu_access); // CPU accesses only single words
-        dmareq->chunk_qunibus_start_addr = mailbox->dma.cur_addr + 2;
-        // dmarequest remains prl->active and ->busy
-
         _DEBUG(
             "DMA chunk complete: dev %s, %s @ %s..%s, wordcount %d, data=%06o, %06o, ... %s",
             prl->active->device ? prl->active->device->name.value.c_str() : "none",
-            qunibus->control2text(mailbox->dma.buscycle), qunibus->addr2text(mailbox->dma.startaddr),
-            qunibus->addr2text(mailbox->dma.cur_addr), mailbox->dma.wordcount, mailbox->dma.words[0],
-            mailbox->dma.words[1], dmareq->success ? "OK" : "TIMEOUT");
+            qunibus->control2text(dmareq->qunibus_control),
+            qunibus->addr2text(dmareq->chunk_qunibus_start_addr), qunibus->addr2text(chunk_end_addr),
+            dmareq->chunk_words, dmareq->chunk_buffer_start()[0], dmareq->chunk_buffer_start()[1],
+            dmareq->success ? "OK" : "TIMEOUT");
 
-        // re-activate this request, or choose another with higher slot priority,
-        // inserted in parallel (interrupt this DMA)
-        prl->active = NULL;
-        request_activate_lowest_slot(PRIORITY_LEVEL_INDEX_NPR);
+        dmareq->chunk_qunibus_start_addr = chunk_end_addr + 2;
+        // dmarequest remains prl->active and ->busy
+
+        if (dmareq->next_chunk_words && !mailbox->dma.next_valid) {
+            // ping-pong: PRU has taken the queued chunk and runs it now.
+            // Setup the following one in the half just processed.
+            dmareq->chunk_words = dmareq->next_chunk_words;
+            dmareq->chunk_buffer ^= 1;
+            request_queue_next_chunk(dmareq);
+        } else {
+            // PRU stopped.
+            // re-activate this request, or choose another with higher slot priority,
+            // inserted in parallel (interrupt this DMA)
+            mailbox->dma.next_valid = 0;
+            dmareq->next_chunk_words = 0;
+            prl->active = NULL;
+            request_activate_lowest_slot(PRIORITY_LEVEL_INDEX_NPR);
 
-        request_execute_active_on_PRU(PRIORITY_LEVEL_INDEX_NPR);
+            request_execute_active_on_PRU(PRIORITY_LEVEL_INDEX_NPR);
+        }
         more_chunks = true;
 
     }
@@ -1103,7 +1504,7 @@ void qunibusadapter_c::worker_device_dma_chunk_complete_event()
 // priority_level_index:  0..3 = BR4..BR7
 void qunibusadapter_c::worker_intr_complete_event(uint8_t level_index) 
 {
-    // Must run under pthread_mutex_lock(&requests_mutex) ;
+    // Must run under requests_lock(level_index)
     priority_request_level_c *prl = &request_levels[level_index];
 
     // if 1st opcode of an ISR is a "clear of INTR" condition,
@@ -1131,6 +1532,8 @@ void qunibusadapter_c::worker(unsigned instance)
     UNUSED(instance); // only one
     int res;
     bool any_event;
+    bool events_processed;
+    bool poll_hit = false;
 
     // set thread priority to MAX.
     // - fastest response to select() call in prussdrv_pru_wait_event_timeout()
@@ -1160,13 +1563,22 @@ void qunibusadapter_c::worker(unsigned instance)
          the event has taken place, as an unsigned int. There is no out-of-
          band value to indicate error (and it can wrap around to 0 if you
          run the program just a whole lot of times). */
-        res = prussdrv_pru_wait_event_timeout(PRU_EVTOUT_0, 100000/*us*/);
+        if (busy_poll_reconfigure)
+            worker_busy_poll_configure();
+        if (poll_hit)
+            res = 1; // busy poll found events, process without wait
+        else {
+            res = pru->wait_event_timeout(100000/*us*/);
 //res = prussdrv_pru_wait_event(PRU_EVTOUT_0);
-        // PRU may have raised more than one event before signal is accepted.
-        // single combination of only INIT+DATI/O possible
-        prussdrv_pru_clear_event(PRU_EVTOUT_0, PRU0_ARM_INTERRUPT);
+            // PRU may have raised more than one event before signal is accepted.
+            // single combination of only INIT+DATI/O possible
+            pru->clear_event();
+        }
+        if (mailbox)
+            deviceregister_latency_collect();
         // uses select() internally: 0 = timeout, -1 = error, else event count received
         any_event = true;
+        events_processed = false;
         // at startup sequence, mailbox may be not yet valid
         while (mailbox && res > 0 && any_event) { // res is const
             any_event = false;
@@ -1261,10 +1673,13 @@ void qunibusadapter_c::worker(unsigned instance)
             if (!EVENT_IS_ACKED(*mailbox, deviceregister) && EVENT_IS_ACKED(*mailbox, init)) {
                 any_event = true;
 
+                deviceregister_latency_collect(); // previous event, if SSYN released meanwhile
                 // DATI/DATO
                 // DEBUG_FAST("EVENT_DEVICEREGISTER:  control=%d, addr=%06o", (int)mailbox->events.unibus_control, mailbox->events.addr);
                 worker_deviceregister_event();
                 // ARM2PRU opcodes raised by device logic are processed in midst of bus cycle
+                latency_last_register_handle = mailbox->events.deviceregister.register_handle;
+                latency_last_seq = mailbox->events.deviceregister.signaled;
                 EVENT_ACK(*mailbox, deviceregister); // PRU continues bus cycle with SSYN now
             }
 
@@ -1272,10 +1687,10 @@ void qunibusadapter_c::worker(unsigned instance)
                 // not called for CPU DATI/DATO
 
                 any_event = true;
-                pthread_mutex_lock(&requests_mutex);
+                requests_lock(PRIORITY_LEVEL_INDEX_NPR);
                 worker_device_dma_chunk_complete_event();
 
-                pthread_mutex_unlock(&requests_mutex);
+                requests_unlock(PRIORITY_LEVEL_INDEX_NPR);
                 // PRU may have set again event_dma again, if this is called before EVENT signal??
                 // call this only on signal, not on timeout!
 
@@ -1289,9 +1704,9 @@ void qunibusadapter_c::worker(unsigned instance)
                     // Device INTR was transmitted. INTRs are granted unpredictable by Arbitrator
                     any_event = true;
                     // INTR of which level? the .active rquest of the"
-                    pthread_mutex_lock(&requests_mutex);
+                    requests_lock(level_index);
                     worker_intr_complete_event(level_index);
-                    pthread_mutex_unlock(&requests_mutex);
+                    requests_unlock(level_index);
                     EVENT_ACK(*mailbox, intr_master[level_index]); // PRU may re-raise and change mailbox now
                 }
             }
@@ -1315,8 +1730,28 @@ void qunibusadapter_c::worker(unsigned instance)
 				EVENT_ACK(*mailbox, init);
 			}
 #endif			
+            if (any_event)
+                events_processed = true;
         }
         // Signal to PRU: continue QBUS/UNIBUS cycles now with SSYN negated
+
+        if (events_processed) {
+            if (poll_hit)
+                busy_poll_hits.value++;
+            else
+                busy_poll_sleeps.value++;
+        }
+        // Register accesses come in bursts: poll for the next event
+        // some time before sleeping. The PRU interrupt of events caught here
+        // is still pending and later gives one empty wakeup.
+        poll_hit = false;
+        if (events_processed && busy_poll_us.value > 0) {
+            uint64_t poll_end_ns = timeout_c::abstime_ns() + 1000LL * busy_poll_us.value;
+            while (!(poll_hit = mailbox_events_pending()) && !workers_terminate
+                    && timeout_c::abstime_ns() < poll_end_ns)
+                if (pru->is_simulated())
+                    sched_yield(); // PRU simulator may run on same core
+        }
     }
 }
 
@@ -1385,6 +1820,65 @@ void qunibusadapter_c::print_pru_iopage_register_map()
         }
 }
 
+void qunibusadapter_c::latency_clear() 
+{
+    for (unsigned i = 0; i < MAX_IOPAGE_REGISTER_COUNT; i++)
+        register_latency[i].clear();
+}
+
+// SSYN/RPLY hold time per device register, only registers with events
+void qunibusadapter_c::latency_print() 
+{
+    unsigned register_handle;
+    bool any = false;
+
+    printf("Register event latency (SSYN/RPLY hold time, us):\n");
+    printf("%-16s %-8s %-8s %10s %9s %9s %9s %9s %9s\n", "device", "register", "addr", "count",
+           "min", "p50", "p99", "p99.9", "max");
+    for (register_handle = 1; register_handle < MAX_IOPAGE_REGISTER_COUNT; register_handle++) {
+        qunibusdevice_register_t *device_reg = register_by_handle[register_handle];
+        latency_histogram_c *h = &register_latency[register_handle];
+        if (device_reg == NULL || h->count == 0)
+            continue;
+        any = true;
+        printf("%-16s %-8s %-8s %10llu %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+               device_reg->device->name.value.c_str(), device_reg->name,
+               qunibus->addr2text(device_reg->addr), (unsigned long long) h->count,
+               h->min_ns / 1000.0, h->percentile_ns(50) / 1000.0,
+               h->percentile_ns(99) / 1000.0, h->percentile_ns(99.9) / 1000.0,
+               h->max_ns / 1000.0);
+    }
+    if (!any)
+        printf("No register events recorded.\n");
+}
+
+// one line per non-empty bucket, for external plotting
+bool qunibusadapter_c::latency_save_csv(const char *filename) 
+{
+    unsigned register_handle, idx;
+    FILE *f = fopen(filename, "w");
+    if (f == NULL) {
+        ERROR("latency_save_csv(): can not open %s", filename);
+        return false;
+    }
+    fprintf(f, "device,register,addr,bucket_low_ns,bucket_high_ns,count\n");
+    for (register_handle = 1; register_handle < MAX_IOPAGE_REGISTER_COUNT; register_handle++) {
+        qunibusdevice_register_t *device_reg = register_by_handle[register_handle];
+        latency_histogram_c *h = &register_latency[register_handle];
+        if (device_reg == NULL || h->count == 0)
+            continue;
+        for (idx = 0; idx < LATENCY_HISTOGRAM_BUCKET_COUNT; idx++)
+            if (h->bucket_count(idx))
+                fprintf(f, "%s,%s,%o,%llu,%llu,%u\n", device_reg->device->name.value.c_str(),
+                        device_reg->name, (unsigned) device_reg->addr,
+                        (unsigned long long) latency_histogram_c::bucket_low_ns(idx),
+                        (unsigned long long) latency_histogram_c::bucket_high_ns(idx),
+                        (unsigned) h->bucket_count(idx));
+    }
+    fclose(f);
+    return true;
+}
+
 // diag: access to internal state of DMA and interupt request handling
 mailbox_t mailbox_snapshot;
 
@@ -29,10 +29,13 @@
 #ifndef _QUNIBUSADAPTER_HPP_
 #define _QUNIBUSADAPTER_HPP_
 
+#include <inttypes.h> // PRI* formats
+
 #include "iopageregister.h"
 #include "priorityrequest.hpp"
 #include "qunibusadapter.hpp"
 #include "qunibusdevice.hpp"
+#include "latencyhistogram.hpp"
 
 // for each priority arbitration level, theres a table with backplane slots.
 //  Each device sits in a slot, the slot determinss the request priority within one level (BR4567,NP).
@@ -43,10 +46,17 @@ public:
 	priority_request_c* slot_request[PRIORITY_SLOT_COUNT + 1];
 	// Optimization to find the high priorized slot in use very fast.
 	// bit array: bit set -> slot<bitnr> has open request.
-	uint32_t slot_request_mask;
+	// volatile: read without lock by request_is_blocking_active() of lower levels
+	volatile uint32_t slot_request_mask;
+
+	priority_request_c* volatile active; // request currently handled by PRU, not in table anymore
 
-	priority_request_c* active; // request currently handled by PRU, not in table anymore
+	// protects the tables of this level, see qunibusadapter_c::requests_lock()
+	pthread_mutex_t mutex;
+	uint64_t lock_count; // statistics, changed under mutex
+	uint64_t lock_contended_count; // mutex was held by other thread
 
+	priority_request_level_c();
 	void clear();
 };
 
@@ -63,14 +73,36 @@ private:
 	// access of master CPU to memory not handled via priority arbitration
 //	dma_request_c 	*cpu_data_transfer_request ; // needs no link to CPU
 
-	pthread_mutex_t requests_mutex;
+	// Each level has its own table lock, so INTR and DMA of different levels do not serialize.
+	// Multiple levels are always locked in ascending level_index order.
+	// BR4..7 share the mailbox->intr parameters, setup and ARM2PRU_INTR under intr_mailbox_mutex.
+	pthread_mutex_t intr_mailbox_mutex;
+
+	// DMA_submit(): further requests of a slot, waiting until the slot's
+	// current request in request_levels[NPR] is complete. FIFO order.
+	dma_request_queue_c dma_submit_queue[PRIORITY_SLOT_COUNT];
 
 	unibuscpu_c	*registered_cpu ; // only one unibuscpu_c may be registered
 
 	// Helper map: find register via 8bit handle
 	qunibusdevice_register_t *register_by_handle[MAX_IOPAGE_REGISTER_COUNT];
+
+	// SSYN/RPLY hold time of register events, per register handle.
+	// Reported by PRU after ACK, so collected on the next worker loop.
+	latency_histogram_c register_latency[MAX_IOPAGE_REGISTER_COUNT];
+	uint8_t latency_last_register_handle; // 0 = nothing to collect
+	uint8_t latency_last_seq; // "signaled" of that event
+	void deviceregister_latency_collect(void);
+
+	// busy_poll_*: settings changed, worker must update its scheduling
+	volatile bool busy_poll_reconfigure;
+	void worker_busy_poll_configure(void);
+	bool mailbox_events_pending(void);
 	
 
+	void request_signal_complete(priority_request_c *request);
+	void DMA_submit_request(dma_request_c& dma_request);
+
 	void worker_init_event(void);
 	void worker_power_event(signal_edge_enum aclo_edge, signal_edge_enum dclo_edge);
 	void worker_deviceregister_event(void);
@@ -83,6 +115,18 @@ public:
 
 	bool on_param_changed(parameter_c *param) override;  // must implement
 
+	// Hybrid event wait: after each event, poll the mailbox for a while
+	// before sleeping on the PRU interrupt again. Bursts of register accesses
+	// are then served without interrupt latency and thread wakeup.
+	parameter_unsigned_c busy_poll_us = parameter_unsigned_c(this, "busy_poll", "bp", /*readonly*/
+			false, "us", "%d", "Poll mailbox this long after an event, before waiting for PRU interrupt. 0 = off", 16, 10);
+	parameter_unsigned_c busy_poll_cpu = parameter_unsigned_c(this, "busy_poll_cpu", "bpc", /*readonly*/
+			false, "", "%d", "Pin worker to core n-1 while busy polling. 0 = no pinning", 8, 10);
+	parameter_unsigned64_c busy_poll_hits = parameter_unsigned64_c(this, "busy_poll_hits", "bph", /*readonly*/
+			true, "", "%" PRIu64, "Events caught by busy polling", 63, 10);
+	parameter_unsigned64_c busy_poll_sleeps = parameter_unsigned64_c(this, "busy_poll_sleeps", "bps", /*readonly*/
+			true, "", "%" PRIu64, "Events received after sleeping on PRU interrupt", 63, 10);
+
 	// list of registered devices.
 	// Defines GRANT priority:
 	// Lower index = "nearer to CPU" = higher priority
@@ -98,11 +142,22 @@ public:
 	bool register_device(qunibusdevice_c& device);
 	void unregister_device(qunibusdevice_c& device);
 
+	// register event latency report
+	void latency_clear(void);
+	void latency_print(void);
+	bool latency_save_csv(const char *filename);
+
 	bool register_rom(uint32_t address) ;
 	void unregister_rom(uint32_t address) ;
 	bool is_rom(uint32_t address) ;
 
 	// Helper for request processing
+	void requests_lock(unsigned level_index);
+	void requests_unlock(unsigned level_index);
+	void requests_lock_all(void);
+	void requests_unlock_all(void);
+	void requests_lock_statistics(bool clear);
+
 	void requests_init(void);
 
 	void request_schedule(priority_request_c& request);
@@ -111,10 +166,20 @@ public:
 //	bool request_is_active(		unsigned level_index);
 	bool request_is_blocking_active(uint8_t level_index);
 	void request_active_complete(unsigned level_index, bool signal_complete);
+	void request_queue_next_chunk(dma_request_c *dmareq);
 	void request_execute_active_on_PRU(unsigned level_index);
+	// cost of schedule/arbitrate/complete, without PRU
+	void request_scheduler_benchmark(unsigned loops);
 
 	void DMA(dma_request_c& dma_request, bool blocking, uint8_t qunibus_cycle,
 			uint32_t unibus_addr, uint16_t *buffer, uint32_t wordcount);
+	void DMA_submit(dma_request_c& dma_request, uint8_t qunibus_cycle,
+			uint32_t unibus_addr, uint16_t *buffer, uint32_t wordcount);
+	void DMA_segments(dma_request_c& dma_request, bool blocking, uint8_t qunibus_cycle,
+			unsigned segment_count, const dma_segment_t *segments, uint16_t *buffer);
+	void DMA_submit_segments(dma_request_c& dma_request, uint8_t qunibus_cycle,
+			unsigned segment_count, const dma_segment_t *segments, uint16_t *buffer);
+	void DMA_wait(dma_request_c& dma_request);
 	void INTR(intr_request_c& intr_request, qunibusdevice_register_t *interrupt_register,
 			uint16_t interrupt_register_value);
 	void cancel_INTR(intr_request_c& intr_request);
@@ -351,7 +351,8 @@ void flexi_timeout_controller_c::emu_step_ns(unsigned emu_delta_ns)
 
     // signals must be triggered? Quick test first.
     // step() is called very frequently, timeouts change quite seldom.
-    if (emu_oldest_signal_time_ns && emu_now_ns >= emu_oldest_signal_time_ns) {
+    uint64_t oldest_ns = emu_oldest_signal_time_ns.load(std::memory_order_relaxed);
+    if (oldest_ns && emu_now_ns >= oldest_ns) {
         pthread_mutex_lock(&mutex);
         // Create a map iterator and point to beginning of map
         std::multimap<uint64_t, flexi_timeout_c*>::iterator it = emu_timeout_wait_list.begin();
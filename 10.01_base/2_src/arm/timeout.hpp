@@ -33,6 +33,7 @@
 
 #include <list>
 #include <map>
+#include <atomic>
 
 #include "logsource.hpp"
 
@@ -102,8 +103,8 @@ class flexi_timeout_controller_c {
 	friend class flexi_timeout_c;
 private:
 	// timestamp of first (and oldest) timeout in list, for emu_step_ns() quick test
-	// 0 == none
-	uint64_t emu_oldest_signal_time_ns;
+	// 0 == none. Written under mutex, read without lock by time producer.
+	std::atomic<uint64_t> emu_oldest_signal_time_ns;
 	void update_oldest(void) {
 		std::multimap<uint64_t, flexi_timeout_c*>::iterator it = emu_timeout_wait_list.begin();
 		if (it == emu_timeout_wait_list.end())
@@ -149,6 +150,14 @@ public:
 
 	// advance internal timebase
 	void emu_step_ns(unsigned emu_delta_ns );
+
+	// Quick test for a time producer, which accumulates emulated time locally:
+	// would emu_step_ns(emu_delta_ns) signal a timeout?
+	// If not, calling emu_step_ns() can be delayed.
+	bool emu_step_due(uint64_t emu_delta_ns) {
+		uint64_t oldest_ns = emu_oldest_signal_time_ns.load(std::memory_order_relaxed);
+		return oldest_ns && emu_now_ns + emu_delta_ns >= oldest_ns;
+	}
 };
 
 extern flexi_timeout_controller_c *the_flexi_timeout_controller; // singleton
@@ -257,6 +257,14 @@ void main(void) {
 				// no completion event, could interfer with other INTRs?
 				mailbox.arm2pru_req = ARM2PRU_NONE;  // done
 				break;
+			case ARM2PRU_DMA_CANCEL:
+				// ARM canceled all device DMA requests. A chunk already running completes,
+				// a ping-pong successor queued by ARM or already taken by sm_dma is not started.
+				// Executed between statemachine steps, so not in midst of the chunk end.
+				mailbox.dma.next_valid = 0;
+				sm_arb.device_request_mask &= ~PRIORITY_ARBITRATION_BIT_NP;
+				mailbox.arm2pru_req = ARM2PRU_NONE;  // done
+				break;
 			case ARM2PRU_ARB_GRANT_INTR_REQUESTS:
 				if (emulate_cpu) {
 					mailbox.arbitrator.ifs_intr_arbitration_pending = true;
@@ -206,6 +206,8 @@ enum states_data_slave_enum  sm_data_slave_func(enum states_data_slave_enum  /**
                 return state_data_slave_din_single_complete; //  main(): check for ARM EVENT_ACK
 //                state = state_data_slave_din_single_complete; // wait for ARM to process device register access
             } else {
+                if (DEVICEREGISTER_HOLD_PENDING(mailbox))
+                    DO_EVENT_DEVICEREGISTER_HOLD_END();
                 buslatches_setbits(4, BIT(3)+BIT(6), 0); // RPLY=0, ARM-elongated cycle finished.  REF=0, cleanup
                 // "The Bus slave continues to gate TDATA onto the Bus for 0 ns
                 // minimum and 100 ns maximum after negating TRPLY"
@@ -231,6 +233,8 @@ enum states_data_slave_enum  sm_data_slave_func(enum states_data_slave_enum  /**
                 return state_data_slave_dout_single_complete; //  main(): check for ARM EVENT_ACK
 //                state = state_data_slave_dout_single_complete; // wait for ARM to process device register access
             } else {
+                if (DEVICEREGISTER_HOLD_PENDING(mailbox))
+                    DO_EVENT_DEVICEREGISTER_HOLD_END();
                 buslatches_setbits(4, BIT(3)+BIT(6), 0); // RPLY=0, ARM-elongated cycle finished.  REF=0, cleanup
                 state = state_data_slave_dout_block_complete;
             }
@@ -34,6 +34,17 @@
 
  Start: setup dma mailbox setup with
  startaddr, wordcount, cycle, words[]
+ For scatter-gather additionally segmentcount and segments[]:
+ all segments are transferred without negating SACK,
+ each segment starts with a new address portion.
+ words[] holds data of all segments in sequence.
+ Zero-copy: if ddr_words is set, data is read/written there in shared DDR
+ instead of words[]. DDR access by PRU is slower than PRU RAM.
+ Ping-pong: if ARM set next_valid, the next chunk of the same request is
+ in the other half of words[]. It is started after a new DMR arbitration,
+ so other bus masters get the bus in between. Result of each chunk is
+ reported in done_status/done_addr[buffer half], so ARM may still process
+ the previous chunk when the next is signaled.
  Then sm_dma_init() ;
  sm_dma_state = DMA_STATE_RUNNING ;
  while(sm_dma_state != DMA_STATE_READY)
@@ -88,8 +99,17 @@ statemachine_state_func sm_dma_start() {
     // buslatches_setbits(1, BIT(6), BIT(6));
 
     mailbox.dma.cur_addr = mailbox.dma.startaddr;
-    sm_dma.dataptr = (uint16_t *) mailbox.dma.words; // point to start of data buffer
+    // point to start of data buffer: mailbox, or zero-copy buffer in DDR
+    if (mailbox.dma.ddr_words)
+        sm_dma.dataptr = (uint16_t *) mailbox.dma.ddr_words;
+    else
+        sm_dma.dataptr = (uint16_t *) mailbox.dma.words
+                         + (mailbox.dma.cur_buffer ? PRU_DMA_PINGPONG_WORDCOUNT : 0);
     sm_dma.words_left = mailbox.dma.wordcount;
+    // segmentcount == 0: single range, segment = whole transfer
+    mailbox.dma.cur_segment = 0;
+    sm_dma.seg_words_left =
+        mailbox.dma.segmentcount ? mailbox.dma.segments[0].wordcount : mailbox.dma.wordcount;
     mailbox.dma.cur_status = DMA_STATE_RUNNING;
 
     // next call to sm_dma.state() starts state machine
@@ -163,7 +183,8 @@ static statemachine_state_func sm_dma_state_addr() {
 //		sm_dma.block_end_addr = addr ;
 //	else {
     // block: not more then 8 words, do not cross 16 word (32 byte) boundary
-    uint32_t block_end_addr_1 = addr + 2* (MIN(sm_dma.words_left, 8)-1); // limit block len to 8 words, add 7
+    // scatter-gather: block never crosses end of segment
+    uint32_t block_end_addr_1 = addr + 2* (MIN(sm_dma.seg_words_left, 8)-1); // limit block len to 8 words, add 7
     uint32_t block_end_addr_2 = addr | 0x1e ; // limit by even/odd 32 byte boundary
     // has to work for single odd "DATOB" addresses too. 
     sm_dma.block_end_addr = MIN(block_end_addr_1,block_end_addr_2) ;
@@ -454,9 +475,17 @@ static statemachine_state_func sm_dma_state_99() {
         } else {
             final_dma_state = DMA_STATE_RUNNING; // more words:  continue
             // dataptr and words_left already updated
-            mailbox.dma.cur_addr += 2; // signal progress to ARM, next addr to output
-            if (sm_dma.block_data_state_func)
-                return sm_dma.block_data_state_func; // Next data portion in DATBI or DATBO
+            sm_dma.seg_words_left--;
+            if (sm_dma.seg_words_left) {
+                mailbox.dma.cur_addr += 2; // signal progress to ARM, next addr to output
+                if (sm_dma.block_data_state_func)
+                    return sm_dma.block_data_state_func; // Next data portion in DATBI or DATBO
+            } else {
+                // scatter-gather: next segment, new address portion. SACK still asserted
+                uint8_t seg = ++mailbox.dma.cur_segment;
+                mailbox.dma.cur_addr = mailbox.dma.segments[seg].startaddr;
+                sm_dma.seg_words_left = mailbox.dma.segments[seg].wordcount;
+            }
             buslatches_setbits(4, BIT(0)+BIT(5), 0); // negate SYNC, BS7(block indicator)
             // SACK still asserted
             return (statemachine_state_func) &sm_dma_state_addr; // reloop: output next address
@@ -470,6 +499,20 @@ static statemachine_state_func sm_dma_state_99() {
 
     mailbox.dma.cur_status = final_dma_state; // signal to ARM
 
+    // result of this chunk, stable while a ping-pong successor runs
+    mailbox.dma.done_addr[mailbox.dma.cur_buffer] = mailbox.dma.cur_addr;
+    mailbox.dma.done_status[mailbox.dma.cur_buffer] = final_dma_state;
+
+    if (final_dma_state == DMA_STATE_READY && mailbox.dma.next_valid) {
+        // ping-pong: ARM queued next chunk in other half of words[].
+        // Request bus again, ARM processes this chunk in parallel.
+        mailbox.dma.startaddr = mailbox.dma.next_startaddr;
+        mailbox.dma.wordcount = mailbox.dma.next_wordcount;
+        mailbox.dma.cur_buffer ^= 1;
+        mailbox.dma.next_valid = 0;
+        sm_arb.device_request_mask |= PRIORITY_ARBITRATION_BIT_NP;
+    }
+
     // device or cpu cycle ended
     // no concurrent ARM+PRU access
 
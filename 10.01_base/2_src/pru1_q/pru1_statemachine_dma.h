@@ -33,8 +33,9 @@
 // Transfers a block of worst as data cycles
 typedef struct {
 	uint8_t state_timeout; // timeout occured?
-	uint16_t *dataptr; // points to current word in mailbox.words[] ;
+	uint16_t *dataptr; // points to current word in mailbox.words[] or DDR buffer
 	uint16_t words_left; // # of words left to transfer
+	uint16_t seg_words_left; // # of words left in current scatter-gather segment
 	uint32_t block_end_addr	; // last address of a DATBI/DATBO transfer.
 //	uint16_t block_words_left ; // # of words left to transfer in DATBI/BO block
 	statemachine_state_func block_data_state_func ;
@@ -169,10 +169,13 @@ static statemachine_state_func sm_data_slave_state_10() {
 	// MSYN = latch[4], bit 4
 	if (buslatches_getbyte(4) & BIT(4))
 		return (statemachine_state_func) &sm_data_slave_state_10; // wait, MSYN still active
-	if (! EVENT_IS_ACKED(mailbox,deviceregister))
+	if (! EVENT_IS_ACKED(mailbox,deviceregister)) {
 		// unibusadapter.worker() did not yet run on_after_register_access() 
 		// => wait, long SSYN delay until ARM acknowledges event
 		return (statemachine_state_func) &sm_data_slave_state_10;
+	}
+	if (DEVICEREGISTER_HOLD_PENDING(mailbox))
+		DO_EVENT_DEVICEREGISTER_HOLD_END();
 	// if ARM was triggered by event and changed the device state,
 	// now an Interrupt arbitration may be pending.
 
@@ -188,10 +191,13 @@ static statemachine_state_func sm_data_slave_state_20() {
 	// MSYN = latch[4], bit 4
 	if (buslatches_getbyte(4) & BIT(4))
 		return (statemachine_state_func) &sm_data_slave_state_20; // wait, MSYN still active
-	if (! EVENT_IS_ACKED(mailbox,deviceregister))
+	if (! EVENT_IS_ACKED(mailbox,deviceregister)) {
 		// unibusadapter.worker() did not yet run on_after_register_access() 
 		// => wait, long SSYN delay until ARM acknowledges event
 		return (statemachine_state_func) &sm_data_slave_state_20;
+	}
+	if (DEVICEREGISTER_HOLD_PENDING(mailbox))
+		DO_EVENT_DEVICEREGISTER_HOLD_END();
 	// if ARM was triggered by event and changed the device state,
 	// now an Interrupt arbitration may be pending.
 
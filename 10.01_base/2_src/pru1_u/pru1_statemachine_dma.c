@@ -34,6 +34,16 @@
 
  Start: setup dma mailbox setup with
  startaddr, wordcount, cycle, words[]
+ For scatter-gather additionally segmentcount and segments[]:
+ all segments are transferred without releasing BBSY,
+ words[] holds data of all segments in sequence.
+ Zero-copy: if ddr_words is set, data is read/written there in shared DDR
+ instead of words[]. DDR access by PRU is slower than PRU RAM.
+ Ping-pong: if ARM set next_valid, the next chunk of the same request is
+ in the other half of words[]. It is started after a new NPR arbitration,
+ so other bus masters get the bus in between. Result of each chunk is
+ reported in done_status/done_addr[buffer half], so ARM may still process
+ the previous chunk when the next is signaled.
  Then sm_dma_init() ;
  sm_dma_state = DMA_STATE_RUNNING ;
  while(sm_dma_state != DMA_STATE_READY)
@@ -88,8 +98,17 @@ statemachine_state_func sm_dma_start() {
 	// buslatches_setbits(1, BIT(6), BIT(6));
 
 	mailbox.dma.cur_addr = mailbox.dma.startaddr;
-	sm_dma.dataptr = (uint16_t *) mailbox.dma.words; // point to start of data buffer
+	// point to start of data buffer: mailbox, or zero-copy buffer in DDR
+	if (mailbox.dma.ddr_words)
+		sm_dma.dataptr = (uint16_t *) mailbox.dma.ddr_words;
+	else
+		sm_dma.dataptr = (uint16_t *) mailbox.dma.words
+				+ (mailbox.dma.cur_buffer ? PRU_DMA_PINGPONG_WORDCOUNT : 0);
 	sm_dma.cur_wordsleft = mailbox.dma.wordcount;
+	// segmentcount == 0: single range, segment = whole transfer
+	mailbox.dma.cur_segment = 0;
+	sm_dma.seg_words_left =
+			mailbox.dma.segmentcount ? mailbox.dma.segments[0].wordcount : mailbox.dma.wordcount;
 	mailbox.dma.cur_status = DMA_STATE_RUNNING;
 
 	// do not wait for BBSY here. This is part of Arbitration.
@@ -324,7 +343,15 @@ static statemachine_state_func sm_dma_state_99() {
 
 	if (final_dma_state == DMA_STATE_RUNNING) {
 		// dataptr and words_left already incremented
-		mailbox.dma.cur_addr += 2; // signal progress to ARM
+		sm_dma.seg_words_left--;
+		if (sm_dma.seg_words_left)
+			mailbox.dma.cur_addr += 2; // signal progress to ARM
+		else {
+			// scatter-gather: next segment, BBSY and SACK still held
+			uint8_t seg = ++mailbox.dma.cur_segment;
+			mailbox.dma.cur_addr = mailbox.dma.segments[seg].startaddr;
+			sm_dma.seg_words_left = mailbox.dma.segments[seg].wordcount;
+		}
 		return (statemachine_state_func) &sm_dma_state_1; // reloop
 	} else {
 		// remove addr and control from bus. 
@@ -340,6 +367,20 @@ static statemachine_state_func sm_dma_state_99() {
 		// SACK already de-asserted at wordcount==1
 		mailbox.dma.cur_status = final_dma_state; // signal to ARM
 
+		// result of this chunk, stable while a ping-pong successor runs
+		mailbox.dma.done_addr[mailbox.dma.cur_buffer] = mailbox.dma.cur_addr;
+		mailbox.dma.done_status[mailbox.dma.cur_buffer] = final_dma_state;
+
+		if (final_dma_state == DMA_STATE_READY && mailbox.dma.next_valid) {
+			// ping-pong: ARM queued next chunk in other half of words[].
+			// Request bus again, ARM processes this chunk in parallel.
+			mailbox.dma.startaddr = mailbox.dma.next_startaddr;
+			mailbox.dma.wordcount = mailbox.dma.next_wordcount;
+			mailbox.dma.cur_buffer ^= 1;
+			mailbox.dma.next_valid = 0;
+			sm_arb.device_request_mask |= PRIORITY_ARBITRATION_BIT_NP;
+		}
+
 		// device or cpu cycle ended
 		// no concurrent ARM+PRU access
 
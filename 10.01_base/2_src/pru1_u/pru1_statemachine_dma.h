@@ -33,8 +33,9 @@
 // Transfers a block of worst as data cycles
 typedef struct {
 	uint8_t state_timeout; // timeout occured?
-	uint16_t *dataptr; // points to current word in mailbox.words[] ;
+	uint16_t *dataptr; // points to current word in mailbox.words[] or DDR buffer
 	uint16_t cur_wordsleft; // # of words left to transfer
+	uint16_t seg_words_left; // # of words left in current scatter-gather segment
 } statemachine_dma_t;
 
 extern statemachine_dma_t sm_dma;
@@ -31,9 +31,16 @@ typedef struct {
 #ifdef ARM
 // included by ARM code
 
+#include <pthread.h>
+#include <map>
 #include "logsource.hpp"
 
 class ddrmem_c: public logsource_c {
+private:
+	// zero-copy DMA buffers: shared DDR behind ddrmem_t, up to len
+	pthread_mutex_t dma_pool_mutex;
+	uint32_t dma_pool_start; // byte offset to base_virtual
+	std::map<uint32_t, uint32_t> dma_pool_used; // byte offset -> byte size of allocated buffers
 public:
 	/* these values are generated by prussdrv functions */
 	// base address of shared DDR memory, in ARM Linux memory space
@@ -67,7 +74,11 @@ public:
 		
 	bool iopage_deposit(uint32_t addr, uint16_t w) ;
 	bool iopage_exam(uint32_t addr, uint16_t *w) ;
-	
+
+	// device buffers in shared DDR, PRU DMA accesses them without copy
+	uint16_t *dma_buffer_alloc(uint32_t wordcount) ;
+	void dma_buffer_free(uint16_t *buffer) ;
+	uint32_t dma_buffer_physical(const uint16_t *buffer, uint32_t wordcount) ;
 };
 
 #ifndef _DDRMEM_C_
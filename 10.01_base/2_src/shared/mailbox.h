@@ -52,6 +52,7 @@
 #define ARM2PRU_DDR_SLAVE_MEMORY	18	// use DDR as QBUS/UNIBUS slave memory
 #define ARM2PRU_ARB_GRANT_INTR_REQUESTS	19 // emulated CPU answers device requests
 #define ARM2PRU_CPU_BUS_ACCESS 20 // prohibit any activity of CPU on QBUS
+#define ARM2PRU_DMA_CANCEL	21	// withdraw device DMA not yet granted, drop queued ping-pong chunk
 
 
 
@@ -96,6 +97,12 @@
 
 // data for a requested DMA operation
 #define	PRU_MAX_DMA_WORDCOUNT	(8*512)
+// ping-pong DMA: each half of words[] holds one chunk
+#define	PRU_DMA_PINGPONG_WORDCOUNT	(PRU_MAX_DMA_WORDCOUNT/2)
+// zero-copy DMA: limit only by 16 bit mailbox wordcount
+#define	PRU_MAX_DMA_DDR_WORDCOUNT	0x8000
+// max # of address ranges in one scatter-gather DMA
+#define	PRU_MAX_DMA_SEGMENTCOUNT	16
 
 #include "ddrmem.h"
 
@@ -152,6 +159,13 @@ typedef struct {
 
 } mailbox_arbitrator_t;
 
+// one address range of a scatter-gather DMA
+typedef struct {
+	uint32_t startaddr; // address of 1st word of segment
+	uint16_t wordcount; // # of words in segment, > 0
+	uint16_t _dummy;
+} mailbox_dma_segment_t;
+
 // data for a requested DMA operation
 typedef struct {
 	// take care of 32 bit word borders for struct members
@@ -161,11 +175,35 @@ typedef struct {
 	uint16_t wordcount; // # of remaining words transmit/receive, static
 	// ---dword---
 	uint8_t	cpu_access ; // 0 for device DMA, 1 for emulated CPU
-	uint8_t	dummy[3] ;
+	uint8_t	segmentcount ; // 0: single range startaddr/wordcount. else # of segments[]
+	uint8_t	cur_segment ; // index of segment in transfer, if timeout: offending segment
+	uint8_t	dummy[1] ;
 	// ---dword---
 	uint32_t cur_addr; // current address in transfer, if timeout: offending address.
 	// if complete: last address accessed.
 	uint32_t startaddr; // address of 1st word to transfer
+	// zero-copy: PRU-side address of data buffer in shared DDR,
+	// used instead of words[]. 0 = words[]
+	uint32_t ddr_words;
+	// ping-pong: ARM queues the next chunk of the same request in the other
+	// half of words[] while the current chunk runs. After it, PRU signals the
+	// current chunk and continues with the next after a new arbitration.
+	uint8_t cur_buffer; // data in words[cur_buffer * PRU_DMA_PINGPONG_WORDCOUNT]
+	uint8_t next_valid; // ARM->PRU: next_* setup. PRU clears when taken
+	uint16_t next_wordcount;
+	// ---dword---
+	uint32_t next_startaddr;
+	// result of chunk in buffer half [cur_buffer], valid on dma event.
+	// cur_* may already describe the next chunk.
+	uint8_t done_status[2];
+	uint8_t done_dummy[2];
+	// ---dword---
+	uint32_t done_addr[2];
+	// scatter-gather: address ranges transferred in one bus tenure,
+	// all with same buscycle. startaddr = segments[0].startaddr,
+	// wordcount = sum of all segment wordcounts.
+	// words[] holds the data of all segments in sequence.
+	mailbox_dma_segment_t segments[PRU_MAX_DMA_SEGMENTCOUNT];
 	uint16_t words[PRU_MAX_DMA_WORDCOUNT]; // buffer for rcv/xmt data
 } mailbox_dma_t;
 
@@ -205,6 +243,12 @@ typedef struct {
 #define EVENT_ACK(mailbox,source) ((mailbox).events.source.acked++)
 #define EVENT_IS_ACKED(mailbox,source) ((mailbox).events.source.signaled == (mailbox).events.source.acked)
 
+// latency instrumentation: a hold measurement is pending from EVENT_SIGNAL()
+// in DO_EVENT_DEVICEREGISTER() until DO_EVENT_DEVICEREGISTER_HOLD_END(),
+// so also events ACKed before the slave statemachine polls are sampled.
+#define DEVICEREGISTER_HOLD_PENDING(mailbox) \
+		((mailbox).events.deviceregister.hold_seq != (mailbox).events.deviceregister.signaled)
+
 // Access to device register detected
 typedef struct {
 	uint8_t signaled; //  PRU->ARM
@@ -215,13 +259,20 @@ typedef struct {
 	uint8_t register_handle;
 	// ---dword---
 	uint16_t data; // deviceregister_data value for DATO event
-	uint8_t _dummy1;
+	// latency instrumentation: hold_cycles is valid for the event
+	// with "signaled" == hold_seq, written by PRU after ACK.
+	uint8_t hold_seq;
 	uint8_t _dummy2;
 	// ---dword---
 	// QUNIBUS address accessed
 	uint32_t addr; // accessed address: odd/even important for DATOB
+	// ---dword---
+	uint32_t timestamp; // PRU cycle counter when event was raised
+	uint32_t hold_cycles; // SSYN/RPLY held by slave until ACK, in PRU cycles
 } mailbox_event_deviceregister_t;
 
+#define PRU_CYCLE_NS	5	// PRU cycle counter runs with 200 MHz
+
 // DMA transfer complete
 typedef struct {
 	/* After ARM2PRU_DMA_*, NPR/NPG/SACK protocll was executed and
@@ -355,12 +406,20 @@ extern volatile far mailbox_t mailbox;
 			mailbox.events.deviceregister.register_handle = _reg->event_register_handle ;\
 			mailbox.events.deviceregister.addr = _addr ;									 \
 			mailbox.events.deviceregister.data = _data ;									\
+			mailbox.events.deviceregister.timestamp = PRU1_CTRL.CYCLE ;					\
 			EVENT_SIGNAL(mailbox,deviceregister) ;						\
 			/* data for ARM valid now*/ 									\
 			PRU2ARM_INTERRUPT ; 											\
 			/* leave SSYN asserted until mailbox.event.signal ACKEd to 0 */ \
 		} while(0)
 
+// latency instrumentation: slave statemachine has seen the ACK
+// for the last deviceregister event, SSYN/RPLY is released now.
+#define DO_EVENT_DEVICEREGISTER_HOLD_END()	do { \
+		mailbox.events.deviceregister.hold_cycles = PRU1_CTRL.CYCLE - mailbox.events.deviceregister.timestamp ; \
+		mailbox.events.deviceregister.hold_seq = mailbox.events.deviceregister.signaled ; \
+	} while(0)
+
 
 #endif
 
@@ -49,6 +49,10 @@
  */
 #undef CPU_CONTROLLED_TIME
 
+// max opcodes executed by worker() without looking at switches and parameters.
+// A batch ends earlier on "attention", HALT, WAIT, trigger or breakpoint.
+#define CPU_BATCH_STEPS	1000
+
 int dbg = 0;
 
 
@@ -107,17 +111,47 @@ void unibone_grant_interrupts(void)
 #define UNIBUS_ACCESS_NS	1000
 // "real world" time for bus access. emulated timeout is stepped by this on every cycle.
 
-int unibone_dato(unsigned addr, unsigned data) 
+// Emulated time produced by the CPU, not yet given to the_flexi_timeout_controller.
+// Published only if a timeout may elapse, else at the end of each opcode batch
+// in worker(), so bus cycles do not step the controller every time.
+// Only used by the CPU thread.
+static uint64_t cpu_emu_pending_ns = 0;
+
+static void cpu_emu_publish(void)
+{
+    if (cpu_emu_pending_ns) {
+        the_flexi_timeout_controller->emu_step_ns(cpu_emu_pending_ns);
+        cpu_emu_pending_ns = 0;
+    }
+}
+
+static inline void cpu_emu_step_ns(unsigned emu_delta_ns)
+{
+    cpu_emu_pending_ns += emu_delta_ns;
+    if (the_flexi_timeout_controller->emu_step_due(cpu_emu_pending_ns))
+        cpu_emu_publish();
+}
+
+/* DATO/DATOB/DATI are specialized at compile time for
+   - TRIGGER: probe the trigger system,
+   - PMI: "direct_memory", non-IOPage memory is DDR RAM array,
+   - CYCLETRACE: record cycles in cycle_trace_buffer.
+   One set is selected in cpu_c::select_memory_access() whenever the CPU
+   starts or parameters change, so the per-cycle code does not test flags.
+ */
+template<bool TRIGGER, bool PMI, bool CYCLETRACE>
+static int cpu_dato(unsigned addr, unsigned data)
 {
     bool success ;
 
-    unibone_cpu->trigger.probe(addr, QUNIBUS_CYCLE_DATO) ; // register access for trigger system
+    if (TRIGGER)
+        unibone_cpu->trigger.probe(addr, QUNIBUS_CYCLE_DATO) ; // register access for trigger system
 
     uint16_t wordbuffer = (uint16_t) data;
-    the_flexi_timeout_controller->emu_step_ns(UNIBUS_ACCESS_NS);
-    if (unibone_cpu->direct_memory.value && addr < qunibus->iopage_start_addr) {
+    cpu_emu_step_ns(UNIBUS_ACCESS_NS);
+    if (PMI && addr < qunibus->iopage_start_addr) {
         // Direct access Non-IOPage memory.
-        ddrmem->pmi_deposit(addr, data);
+        ddrmem->base_virtual->memory.words[addr / 2] = wordbuffer;
         success = true;
     } else {
         dbg = 1;
@@ -129,29 +163,28 @@ int unibone_dato(unsigned addr, unsigned data)
     }
 
     // trace bus access
-    if (unibone_cpu->cycle_trace_buffer.active)
+    if (CYCLETRACE)
         unibone_cpu->cycle_trace_buffer.add(qunibus_cycle_trace_entry_c(unibone_cpu->cycle_trace_entry_id++, addr >= qunibus->iopage_start_addr, addr, QUNIBUS_CYCLE_DATO, data, !success)) ;
 
     return success;
 }
 
-int unibone_datob(unsigned addr, unsigned data) 
+template<bool TRIGGER, bool PMI, bool CYCLETRACE>
+static int cpu_datob(unsigned addr, unsigned data)
 {
     bool success ;
-    unibone_cpu->trigger.probe(addr, QUNIBUS_CYCLE_DATO) ; // register access for trigger system
-    the_flexi_timeout_controller->emu_step_ns(UNIBUS_ACCESS_NS);
-    if (unibone_cpu->direct_memory.value && addr < qunibus->iopage_start_addr) {
+    if (TRIGGER)
+        unibone_cpu->trigger.probe(addr, QUNIBUS_CYCLE_DATO) ; // register access for trigger system
+    cpu_emu_step_ns(UNIBUS_ACCESS_NS);
+    if (PMI && addr < qunibus->iopage_start_addr) {
         // read-modify-write
-        unsigned word_address = addr & ~1; // lower even address
-        uint16_t w;
-        ddrmem->pmi_exam(word_address, &w);
+        volatile uint16_t *w = &ddrmem->base_virtual->memory.words[addr / 2]; // lower even address
         if (addr & 1) // odd addr: set bits <8:15>
 //			w = (w & 0xff) | (data << 8);
-            w = (w & 0xff) | (data & 0xff00);
+            *w = (*w & 0xff) | (data & 0xff00);
         else
             // even addr: set bits <0:7>
-            w = (w & 0xff00) | (data & 0xff);
-        ddrmem->pmi_deposit(word_address, w);
+            *w = (*w & 0xff00) | (data & 0xff);
         success = true;
     } else {
         // TODO DATOB als 1 byte-DMA !
@@ -165,28 +198,28 @@ int unibone_datob(unsigned addr, unsigned data)
     }
 
     // trace bus access
-    if (unibone_cpu->cycle_trace_buffer.active)
+    if (CYCLETRACE)
         unibone_cpu->cycle_trace_buffer.add(qunibus_cycle_trace_entry_c(unibone_cpu->cycle_trace_entry_id++, addr >= qunibus->iopage_start_addr, addr, QUNIBUS_CYCLE_DATOB, data, !success)) ;
 
     return success;
 }
 
-int unibone_dati(unsigned addr, unsigned *data) 
- {
+template<bool TRIGGER, bool PMI, bool CYCLETRACE>
+static int cpu_dati(unsigned addr, unsigned *data)
+{
     bool success ;
     uint16_t w;
-    unibone_cpu->trigger.probe(addr, QUNIBUS_CYCLE_DATI) ; // register access for trigger system
+    if (TRIGGER)
+        unibone_cpu->trigger.probe(addr, QUNIBUS_CYCLE_DATI) ; // register access for trigger system
 
-    the_flexi_timeout_controller->emu_step_ns(UNIBUS_ACCESS_NS);
-    if (unibone_cpu->direct_memory.value && addr < qunibus->iopage_start_addr) {
+    cpu_emu_step_ns(UNIBUS_ACCESS_NS);
+    if (PMI && addr < qunibus->iopage_start_addr) {
         // boot address redirection by M9312? addrs 24/26 now in M9312 IOpage
         addr |= ddrmem->pmi_address_overlay;
     }
-    if (unibone_cpu->direct_memory.value
-            && (addr < qunibus->iopage_start_addr || qunibusadapter->is_rom(addr))) {
+    if (PMI && (addr < qunibus->iopage_start_addr || qunibusadapter->is_rom(addr))) {
         // Direct access Non-IOPage memory, or to emulated ROM
-        ddrmem->pmi_exam(addr, &w);
-        *data = w;
+        *data = ddrmem->base_virtual->memory.words[addr / 2];
         success = true;
     } else {
         dbg = 1;
@@ -199,12 +232,51 @@ int unibone_dati(unsigned addr, unsigned *data)
     }
 
     // trace bus access
-    if (unibone_cpu->cycle_trace_buffer.active)
+    if (CYCLETRACE)
         unibone_cpu->cycle_trace_buffer.add(qunibus_cycle_trace_entry_c(unibone_cpu->cycle_trace_entry_id++, addr >= qunibus->iopage_start_addr, addr, QUNIBUS_CYCLE_DATI, *data, !success)) ;
 
     return success;
 }
 
+typedef struct {
+    int (*dato)(unsigned addr, unsigned data) ;
+    int (*datob)(unsigned addr, unsigned data) ;
+    int (*dati)(unsigned addr, unsigned *data) ;
+} cpu_memory_access_t ;
+
+#define CPU_MEMORY_ACCESS(trigger, pmi, cycletrace)	\
+    { cpu_dato<trigger, pmi, cycletrace>, cpu_datob<trigger, pmi, cycletrace>, cpu_dati<trigger, pmi, cycletrace> }
+
+// index: trigger*4 + pmi*2 + cycletrace
+static const cpu_memory_access_t cpu_memory_access_variants[8] = {
+    CPU_MEMORY_ACCESS(false, false, false),
+    CPU_MEMORY_ACCESS(false, false, true),
+    CPU_MEMORY_ACCESS(false, true, false),
+    CPU_MEMORY_ACCESS(false, true, true),
+    CPU_MEMORY_ACCESS(true, false, false),
+    CPU_MEMORY_ACCESS(true, false, true),
+    CPU_MEMORY_ACCESS(true, true, false),
+    CPU_MEMORY_ACCESS(true, true, true)
+} ;
+
+// current selection, only changed by CPU thread
+static const cpu_memory_access_t *cpu_memory_access = &cpu_memory_access_variants[0] ;
+
+int unibone_dato(unsigned addr, unsigned data) 
+{
+    return cpu_memory_access->dato(addr, data) ;
+}
+
+int unibone_datob(unsigned addr, unsigned data) 
+{
+    return cpu_memory_access->datob(addr, data) ;
+}
+
+int unibone_dati(unsigned addr, unsigned *data) 
+{
+    return cpu_memory_access->dati(addr, data) ;
+}
+
 // CPU has changed the arbitration level, just forward
 // if this is called as result of INTR fector PC and PSW fetch,
 // mailbox->arbitrator.cpu_priority_level was CPU_PRIORITY_LEVEL_FETCHING
@@ -265,6 +337,8 @@ cpu_c::cpu_c() :
     memset(&bus, 0, sizeof(bus));
     memset(&ka11, 0, sizeof(ka11));
     ka11.bus = &bus;
+    attention = true ;
+    select_memory_access() ;
 
     // link to global instance ptr
     assert(unibone_cpu == NULL);// only one possible
@@ -306,12 +380,33 @@ bool cpu_c::on_param_changed(parameter_c *param)
         // speed feedback, as measured
         // see cpu_c() also
         emulation_speed.value = direct_memory.new_value ? 0.5 : 0.1 ;
+        // memory access path re-selected by worker()
+        direct_memory.value = direct_memory.new_value ;
+        attention = true ;
     } else if (param == &cycle_tracefilepath) {
 	    cycle_trace_buffer.active = ! cycle_tracefilepath.new_value.empty() ;
+        attention = true ;
+    } else if (param == &halt_switch || param == &continue_switch || param == &start_switch) {
+        // publish before worker() looks
+        ((parameter_bool_c *)param)->value = ((parameter_bool_c *)param)->new_value ;
+        attention = true ;
+    } else if (param == &swab_vbit) {
+        swab_vbit.value = swab_vbit.new_value ;
+        attention = true ;
+    } else if (param == &swreg || param == &pc) {
+        ((parameter_unsigned_c *)param)->value = ((parameter_unsigned_c *)param)->new_value ;
+        attention = true ;
     }
     return qunibusdevice_c::on_param_changed(param); // more actions (for enable)
 }
 
+// power events are processed in worker()
+void cpu_c::on_power_changed(signal_edge_enum aclo_edge, signal_edge_enum dclo_edge)
+{
+    unibuscpu_c::on_power_changed(aclo_edge, dclo_edge) ;
+    attention = true ;
+}
+
 // start CPU logic on PRU and switch arbitration mode
 void cpu_c::start() 
 {
@@ -352,10 +447,25 @@ void cpu_c::start()
     the_flexi_timeout_controller->set_mode(flexi_timeout_c::world_time);
 #endif
     cycle_count.value = 0;
+    select_memory_access() ; // after trigger setup
 
     // 	what if CONT while WAITING??
 }
 
+// choose DATI/DATO/DATOB variant for current trigger, PMI and trace settings.
+// Only called by CPU thread, between opcodes.
+void cpu_c::select_memory_access(void)
+{
+    unsigned idx = 0 ;
+    if (trigger.active())
+        idx |= 4 ;
+    if (direct_memory.value)
+        idx |= 2 ;
+    if (cycle_trace_buffer.active)
+        idx |= 1 ;
+    cpu_memory_access = &cpu_memory_access_variants[idx] ;
+}
+
 // stop CPU logic on PRU and switch arbitration mode
 void cpu_c::stop(const char * info, int show_options) 
 {
@@ -393,17 +503,93 @@ void cpu_c::stop(const char * info, int show_options)
 	
 }
 
+// RUN led, CONT and START switches, before opcode execution
+void cpu_c::worker_service_switches(void)
+{
+    // RUN led
+    runmode.value = (ka11.state > 0); // RUNNING, WAITING
+    if (runmode.value)
+        pc.value = ka11.r[7]; // update for display
+
+    // CONT starts
+    // if HALT+CONT: only one single step
+    if (continue_switch.value && !runmode.value) {
+        start(); // HALTED -> RUNNING
+    }
+    continue_switch.value = false; // momentary action
+
+    ka11.sw = swreg.value & 0xffff;
+
+    if (!runmode.value && start_switch.value) {
+        // START, or HALT+START: reset system
+        ka11.r[7] = pc.value & 0xffff;
+//            ka11.sw = swreg.value & 0xffff;
+        qunibus->init();
+        ka11_reset(&ka11);
+        if (!halt_switch.value) {
+            // START without HALT
+            start(); // HALTED -> RUNNING
+        }
+    }
+    start_switch.value = false; // momentary action
+}
+
+// power events and HALT switch, after opcode execution
+void cpu_c::worker_service_events(void)
+{
+    // serialize asynchronous power events
+    // ACLO inactive & no HALT: reboot
+    // ACLO inactive & HALT: boot on CONT
+//if (power_event)	DEBUG_FAST("power_event=%d", power_event) ;
+    // ACLO: power fail trap, if running.
+    if (runmode.value && power_event_ACLO_active) {
+        ka11_pwrfail_trap(&unibone_cpu->ka11);
+    }
+    power_event_ACLO_active = false; // processed
+
+    // DCLO: halt, like "enable = 0"
+    if (runmode.value && power_event_DCLO_active) {
+        stop("CPU HALT by DCLO", show_pc);
+//			ka11_reset(&ka11);
+    }
+    power_event_DCLO_active = false; // processed
+    if (power_event_ACLO_inactive) {
+        // Reboot
+        // if HALT switch active: no action, event remains pending
+//			if (!halt_switch.value) {
+        stop("ACLO", show_pc);
+        // execute this with real-world time, else lock (CPU not step() ing here)
+        qunibus->init();		// reset devices
+        start();		// start CPU logic on PRU, is bus master now
+        INFO("ACLO inactive: fetch vector");
+        ka11_reset(&unibone_cpu->ka11);
+        ka11_pwrup_vector_fetch(&unibone_cpu->ka11);
+        // M9312 logic here: vectror redirection for 300ms
+//			}
+        power_event_ACLO_inactive = false;		// processed
+    }
+
+    // HALT: activating stops
+    // Must be last, to undo power-up and CONT
+    // after HALT+power-up: only vector fecth executed
+    // after CONT+HALT: one step executed
+    if (halt_switch.value && runmode.value) {
+        // HALT position inside instructions !!!
+        stop("CPU HALT by switch", show_pc+show_state+show_cycletrace);
+    }
+
+    ka11.swab_vbit = (swab_vbit.value == true);
+    select_memory_access() ; // direct_memory or cycle trace may have changed
+}
+
 // background worker.
 // Started/stopped on param "enable"
+// A running CPU executes opcodes in batches. Switches, parameters and power
+// events are serviced between batches, only if "attention" was raised.
 void cpu_c::worker(unsigned instance) 
 {
     UNUSED(instance); // only one
     timeout_c timeout;
-// bool nxm;
-// unsigned pc = 0;
-//unsigned dr = 0760102;
-    unsigned opcode = 0;
-    (void) opcode;
 
     power_event_ACLO_active = power_event_ACLO_inactive = power_event_DCLO_active = false;
 
@@ -419,37 +605,24 @@ void cpu_c::worker(unsigned instance)
 //			if (runmode.value != (ka11.state != 0))
 //				ka11.state = runmode.value;
 
-        // RUN led
-        runmode.value = (ka11.state > 0); // RUNNING, WAITING
-        if (runmode.value)
-            pc.value = ka11.r[7]; // update for display
-
-        // CONT starts
-        // if HALT+CONT: only one single step
-        if (continue_switch.value && !runmode.value) {
-            start(); // HALTED -> RUNNING
-        }
-        continue_switch.value = false; // momentary action
-
-        ka11.sw = swreg.value & 0xffff;
-
-        if (!runmode.value && start_switch.value) {
-            // START, or HALT+START: reset system
-            ka11.r[7] = pc.value & 0xffff;
-//            ka11.sw = swreg.value & 0xffff;
-            qunibus->init();
-            ka11_reset(&ka11);
-            if (!halt_switch.value) {
-                // START without HALT
-                start(); // HALTED -> RUNNING
-            }
-        }
-        start_switch.value = false; // momentary action
+        // HALTed and WAITing CPU: check switches on every loop, as before.
+        bool service = attention.exchange(false) || ka11.state != KA11_STATE_RUNNING ;
+        if (service)
+            worker_service_switches() ;
 
         int prev_ka11_state = ka11.state;
-        // ARM_DEBUG_PIN(0,1) ; // measure pmi gain
-        ka11_condstep(&ka11);
-        // ARM_DEBUG_PIN(0,0) ;
+        unsigned steps = 0 ;
+        do {
+            // ARM_DEBUG_PIN(0,1) ; // measure pmi gain
+            ka11_condstep(&ka11);
+            // ARM_DEBUG_PIN(0,0) ;
+            if (ka11.state != KA11_STATE_RUNNING)
+                break ; // HALT, or WAIT
+            steps++ ;
+            if (trigger.has_triggered() || (breakpoint.value && breakpoint.value == ka11.r[7]))
+                break ;
+        } while (steps < CPU_BATCH_STEPS && !attention.load(std::memory_order_relaxed)) ;
+
         if (ka11.state != KA11_STATE_HALTED && trigger.has_triggered()) {
             stop("Halted by trigger conditions:", show_pc+show_trigger+show_state+show_cycletrace);
         } else  if (breakpoint.value && ka11.state != KA11_STATE_HALTED && breakpoint.value == ka11.r[7]) {
@@ -459,57 +632,17 @@ void cpu_c::worker(unsigned instance)
             stop("CPU HALT by opcode", show_pc+show_state+show_cycletrace);
         }
         // running CPU: produce emulated time for all devices
-        if (ka11.state == KA11_STATE_RUNNING) {
-            cycle_count.value++;
-        } else if (ka11.state == KA11_STATE_WAITING)
+        cycle_count.value += steps ;
+        if (ka11.state == KA11_STATE_WAITING)
             // we should us "world" time here, but want to avoid permanent time-source switching
             // so just assume this here is called every 500ns (estimated average worker loop time)
-            the_flexi_timeout_controller->emu_step_ns(500);
+            cpu_emu_step_ns(500);
+        cpu_emu_publish() ; // emulated time of this batch now visible to devices
         // if KA11_STATE_HALTED: world time is used, see start() / stop()
 
-        // serialize asynchronous power events
-        // ACLO inactive & no HALT: reboot
-        // ACLO inactive & HALT: boot on CONT
-//if (power_event)	DEBUG_FAST("power_event=%d", power_event) ;
-        // ACLO: power fail trap, if running.
-        if (runmode.value && power_event_ACLO_active) {
-            ka11_pwrfail_trap(&unibone_cpu->ka11);
-        }
-        power_event_ACLO_active = false; // processed
-
-        // DCLO: halt, like "enable = 0"
-        if (runmode.value && power_event_DCLO_active) {
-            stop("CPU HALT by DCLO", show_pc);
-//			ka11_reset(&ka11);
-        }
-        power_event_DCLO_active = false; // processed
-        if (power_event_ACLO_inactive) {
-            // Reboot
-            // if HALT switch active: no action, event remains pending
-//			if (!halt_switch.value) {
-            stop("ACLO", show_pc);
-            // execute this with real-world time, else lock (CPU not step() ing here)
-            qunibus->init();		// reset devices
-            start();		// start CPU logic on PRU, is bus master now
-            INFO("ACLO inactive: fetch vector");
-            ka11_reset(&unibone_cpu->ka11);
-            ka11_pwrup_vector_fetch(&unibone_cpu->ka11);
-            // M9312 logic here: vectror redirection for 300ms
-//			}
-            power_event_ACLO_inactive = false;		// processed
-        }
-
-        // HALT: activating stops
-        // Must be last, to undo power-up and CONT
-        // after HALT+power-up: only vector fecth executed
-        // after CONT+HALT: one step executed
-        if (halt_switch.value && runmode.value) {
-            // HALT position inside instructions !!!
-            stop("CPU HALT by switch", show_pc+show_state+show_cycletrace);
-        }
-
-        ka11.swab_vbit = (swab_vbit.value == true);
-
+        // a batch may have been started, or halted by opcode: service again
+        if (service || ka11.state != KA11_STATE_RUNNING)
+            worker_service_events() ;
     }
 }
 
@@ -544,3 +677,119 @@ void cpu_c::on_interrupt(uint16_t vector) {
     ka11_setintr(&unibone_cpu->ka11, vector);
 }
 
+
+// Bus device for the benchmark KA11: direct access to the DDR RAM array.
+// Unlike unibone_dati()/dato(), does not step emulated time, so the
+// benchmark does not race with the CPU thread on cpu_emu_pending_ns.
+static int benchmark_dati(Bus *bus, void *dev)
+{
+    UNUSED(dev);
+    if (bus->addr >= qunibus->iopage_start_addr)
+        return 1; // bus timeout
+    bus->data = ddrmem->base_virtual->memory.words[bus->addr / 2];
+    return 0;
+}
+
+static int benchmark_dato(Bus *bus, void *dev)
+{
+    UNUSED(dev);
+    if (bus->addr >= qunibus->iopage_start_addr)
+        return 1;
+    ddrmem->base_virtual->memory.words[bus->addr / 2] = bus->data;
+    return 0;
+}
+
+static int benchmark_datob(Bus *bus, void *dev)
+{
+    UNUSED(dev);
+    if (bus->addr >= qunibus->iopage_start_addr)
+        return 1;
+    volatile uint16_t *w = &ddrmem->base_virtual->memory.words[bus->addr / 2];
+    if (bus->addr & 1)
+        *w = (*w & 0xff) | (bus->data & 0xff00);
+    else
+        *w = (*w & 0xff00) | (bus->data & 0xff);
+    return 0;
+}
+
+static int benchmark_svc(Bus *bus, void *dev)
+{
+    UNUSED(bus);
+    UNUSED(dev);
+    return 0; // never requests interrupts
+}
+
+static void benchmark_reset(void *dev)
+{
+    UNUSED(dev);
+}
+
+// Microbenchmark of opcode execution: runs a small loop with a private KA11,
+// first with the former per-opcode mutex poll of external_intr, then with
+// the atomic external_intr only. Memory accesses go to the DDR RAM array,
+// so CPU must be halted and PMI enabled. Program is placed at 001000,
+// previous memory content is restored afterwards.
+void cpu_c::benchmark(unsigned steps)
+{
+    static const uint16_t program[] = {
+        0012701, 0002000, // 001000: MOV #2000,R1
+        0012702, 0000020, // 001004: MOV #20,R2
+        0062100,          // 001010: ADD (R1)+,R0
+        0005302,          // 001012: DEC R2
+        0001375,          // 001014: BNE 1010
+        0000770           // 001016: BR 1000
+    } ;
+    const unsigned program_addr = 01000 ;
+    const unsigned program_words = sizeof(program) / sizeof(program[0]) ;
+    uint16_t saved[program_words] ;
+    const char *variant_names[2] = { "atomic", "mutex" } ;
+    double instr_per_sec[2] ;
+
+    if (runmode.value) {
+        ERROR("cpu_c::benchmark(): CPU must be halted");
+        return ;
+    }
+    if (!direct_memory.value) {
+        ERROR("cpu_c::benchmark(): needs PMI, set \"pmi\" parameter");
+        return ;
+    }
+    volatile uint16_t *mem = &ddrmem->base_virtual->memory.words[program_addr / 2] ;
+    for (unsigned i = 0; i < program_words; i++) {
+        saved[i] = mem[i] ;
+        mem[i] = program[i] ;
+    }
+
+    // private CPU with private memory device, does not disturb the halted ka11
+    // and does not touch QBUS/UNIBUS or emulated time
+    Busdev benchmark_memory = { nil, nil, benchmark_dati, benchmark_dato, benchmark_datob,
+                                benchmark_svc, nil, benchmark_reset } ;
+    struct Bus benchmark_bus ;
+    KA11 *benchmark_ka11 = (KA11 *) calloc(1, sizeof(KA11)) ;
+    memset(&benchmark_bus, 0, sizeof(benchmark_bus)) ;
+    benchmark_bus.devs = &benchmark_memory ;
+    benchmark_ka11->bus = &benchmark_bus ;
+    benchmark_ka11->swab_vbit = swab_vbit.value ;
+
+    // mutex variant first, so a cold cache does not favor the atomic one
+    for (int mutex = 1; mutex >= 0; mutex--) {
+        memset(benchmark_ka11->r, 0, sizeof(benchmark_ka11->r)) ;
+        benchmark_ka11->r[6] = program_addr ; // stack below program, not used
+        benchmark_ka11->r[7] = program_addr ;
+        benchmark_ka11->psw = 0340 ;
+        benchmark_ka11->state = KA11_STATE_RUNNING ;
+        uint64_t start_ns = timeout_c::abstime_ns();
+        ka11_benchmark(benchmark_ka11, steps, mutex) ;
+        uint64_t end_ns = timeout_c::abstime_ns();
+        if (benchmark_ka11->state != KA11_STATE_RUNNING)
+            ERROR("cpu_c::benchmark(): CPU stopped at PC=%06o", benchmark_ka11->r[7]) ;
+        instr_per_sec[mutex] = (double) steps * 1e9 / (end_ns - start_ns) ;
+        printf("%-6s external_intr poll: %u opcodes in %0.3f ms: %0.2f M instructions per second.\n",
+               variant_names[mutex], steps, (end_ns - start_ns) / 1000000.0,
+               instr_per_sec[mutex] / 1e6) ;
+    }
+    printf("atomic / mutex = %0.2f\n", instr_per_sec[0] / instr_per_sec[1]) ;
+
+    free(benchmark_ka11) ;
+    for (unsigned i = 0; i < program_words; i++)
+        mem[i] = saved[i] ;
+}
@@ -27,6 +27,7 @@
 #define _CPU_HPP_
 
 #include "utils.hpp"
+#include <atomic>
 #include "timeout.hpp"
 //#include "qunibusadapter.hpp"
 //#include "qunibusdevice.hpp"
@@ -121,6 +122,14 @@ private:
 	static const int show_state = 4 ;
 	static const int show_cycletrace = 8 ;
 
+    // set by other threads: panel switch, parameter or power event
+    // must be serviced by worker() before next batch of opcodes
+    std::atomic<bool> attention ;
+
+    void worker_service_switches(void) ;
+    void worker_service_events(void) ;
+    void select_memory_access(void) ;
+
 public:
 
     cpu_c();
@@ -133,6 +142,7 @@ public:
     dma_request_c data_transfer_request = dma_request_c(this);
 
     bool on_param_changed(parameter_c *param) override;  // must implement
+    void on_power_changed(signal_edge_enum aclo_edge, signal_edge_enum dclo_edge) override;
 
     parameter_bool_c runmode = parameter_bool_c(this, "run_led", "r",/*readonly*/
                                true, "RUN LED: 1 = CPU running, 0 = halted.");
@@ -180,6 +190,9 @@ public:
 
     void on_interrupt(uint16_t vector);
 
+    // diagnostic: opcodes per second, atomic vs. mutex interrupt poll
+    void benchmark(unsigned steps);
+
     //diagnostic
     trigger_c	trigger ;
     tracer_c	tracer ;
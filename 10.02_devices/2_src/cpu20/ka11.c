@@ -13,10 +13,19 @@ void unibone_bus_init() ;
 bool unibone_trace_addr(uint16_t a) ;
 
 
+// Bus cycles go to the QBUS/UNIBUS via unibone_*(),
+// unless private devices are attached to the bus (see cpu_c::benchmark()).
 int
 dati_bus(Bus *bus)
 {
+	Busdev *bd;
 	unsigned int data;
+	if(bus->devs){
+		for(bd = bus->devs; bd; bd = bd->next)
+			if(bd->dati(bus, bd->dev) == 0)
+				return 0;
+		return 1;
+	}
 	if(!unibone_dati(bus->addr, &data))
 		return 1;
 	bus->data = data;
@@ -26,12 +35,26 @@ dati_bus(Bus *bus)
 int
 dato_bus(Bus *bus)
 {
+	Busdev *bd;
+	if(bus->devs){
+		for(bd = bus->devs; bd; bd = bd->next)
+			if(bd->dato(bus, bd->dev) == 0)
+				return 0;
+		return 1;
+	}
 	return !unibone_dato(bus->addr, bus->data);
 }
 
 int
 datob_bus(Bus *bus)
 {
+	Busdev *bd;
+	if(bus->devs){
+		for(bd = bus->devs; bd; bd = bd->next)
+			if(bd->datob(bus, bd->dev) == 0)
+				return 0;
+		return 1;
+	}
 	return !unibone_datob(bus->addr, bus->data);
 }
 
@@ -121,8 +144,7 @@ ka11_reset(KA11 *cpu)
 	Busdev *bd;
 
 	cpu->traps = 0;
-	cpu->external_intr = 0;
-	cpu->mutex = PTHREAD_MUTEX_INITIALIZER ;
+	__atomic_store_n(&cpu->external_intr, 0, __ATOMIC_RELAXED) ;
 
 	for(bd = cpu->bus->devs; bd; bd = bd->next)
 		bd->reset(bd->dev);
@@ -377,16 +399,16 @@ step(KA11 *cpu)
 
 	{
 		// external interrupt from parallel threads?
-		pthread_mutex_lock(&cpu->mutex) ;
-		bool external_intr = cpu->external_intr ;
-		word external_intrvec = cpu->external_intrvec ;
-		cpu->external_intr = 0 ;
-		pthread_mutex_unlock(&cpu->mutex) ;
-		if (external_intr){
-			//ARM_DEBUG_PIN1(0);	// INTR processed
-			cpu->state = KA11_STATE_RUNNING ;
-			TRAP(external_intrvec);
-		}	
+		// Fast path is a plain load, exchange only if something is pending.
+		// Acquire pairs with the release store in ka11_setintr().
+		if (__atomic_load_n(&cpu->external_intr, __ATOMIC_RELAXED)) {
+			uint32_t external_intr = __atomic_exchange_n(&cpu->external_intr, 0, __ATOMIC_ACQUIRE) ;
+			if (external_intr & KA11_EXTERNAL_INTR_PENDING){
+				//ARM_DEBUG_PIN1(0);	// INTR processed
+				cpu->state = KA11_STATE_RUNNING ;
+				TRAP((word)(external_intr & 0xffff));
+			}
+		}
 	}
 
 
@@ -657,13 +679,11 @@ service:
 void
 ka11_setintr(KA11 *cpu, unsigned vec)
 {
-	pthread_mutex_lock(&cpu->mutex) ;
-	cpu->external_intr = true;
-	cpu->external_intrvec = vec;
+	// vector and pending flag published in one word, no lock needed
+	__atomic_store_n(&cpu->external_intr, (vec & 0xffff) | KA11_EXTERNAL_INTR_PENDING, __ATOMIC_RELEASE) ;
 	trace("INTR vec=%03o\n", vec) ;
 //	if (cpu->state == KA11_STATE_WAITING) // atomically
 //		cpu->state = KA11_STATE_RUNNING ;
-	pthread_mutex_unlock(&cpu->mutex) ;
 }
 
 // only to be called from ka11_condstep() thread
@@ -698,7 +718,7 @@ ka11_condstep(KA11 *cpu)
 
 	if((cpu->state == KA11_STATE_RUNNING) ||
 	   (cpu->state == KA11_STATE_WAITING && cpu->traps)
-	   || (cpu->state == KA11_STATE_WAITING && cpu->external_intr) ){
+	   || (cpu->state == KA11_STATE_WAITING && __atomic_load_n(&cpu->external_intr, __ATOMIC_RELAXED)) ){
 		cpu->state = KA11_STATE_RUNNING;
 		// external_intr WAIT handled atomically in ka11_setintr() !
 
@@ -707,6 +727,29 @@ ka11_condstep(KA11 *cpu)
 	}
 }
 
+// Microbenchmark of the opcode loop, see cpu_c::benchmark().
+// Like ka11_condstep(), but without interrupt grants to the PRU.
+// mutex: additionally poll external_intr under a mutex before every opcode,
+// as step() did before external_intr became a single atomic word.
+void
+ka11_benchmark(KA11 *cpu, unsigned count, int mutex)
+{
+	static pthread_mutex_t benchmark_mutex = PTHREAD_MUTEX_INITIALIZER ;
+
+	while(count-- && cpu->state == KA11_STATE_RUNNING){
+		if (mutex) {
+			pthread_mutex_lock(&benchmark_mutex) ;
+			uint32_t external_intr = cpu->external_intr ;
+			cpu->external_intr = 0 ;
+			pthread_mutex_unlock(&benchmark_mutex) ;
+			if (external_intr)
+				cpu->state = KA11_STATE_HALTED ; // not expected
+		}
+		svc(cpu, cpu->bus);
+		step(cpu);
+	}
+}
+
 void
 run(KA11 *cpu)
 {
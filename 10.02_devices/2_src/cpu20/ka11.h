@@ -6,6 +6,9 @@ enum {
 	KA11_STATE_WAITING = 2
 };
 
+// flag in KA11.external_intr, lower 16 bits hold the vector
+#define KA11_EXTERNAL_INTR_PENDING	0x10000
+
 
 typedef struct KA11 KA11;
 struct KA11
@@ -26,9 +29,9 @@ struct KA11
 	} br[4];
 
 	// UniBone 	
-	pthread_mutex_t mutex ;
-	volatile bool external_intr ; // INTR by parallel thread pending
-	volatile word external_intrvec;	// associated vector
+	// INTR by parallel thread pending: vector | KA11_EXTERNAL_INTR_PENDING, 0 = none.
+	// Accessed only with __atomic builtins, no lock on the step() path.
+	uint32_t external_intr ;
 
 	word sw;
 	int swab_vbit;
@@ -42,4 +45,5 @@ void ka11_setintr(KA11 *cpu, unsigned vec);
 void ka11_pwrfail_trap(KA11 *cpu);
 void ka11_pwrup_vector_fetch(KA11 *cpu);
 void ka11_condstep(KA11 *cpu);
+void ka11_benchmark(KA11 *cpu, unsigned count, int mutex);
 
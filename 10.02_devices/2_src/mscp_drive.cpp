@@ -221,18 +221,13 @@ void mscp_drive_c::Write(uint32_t blockNumber, size_t lengthInBytes, uint8_t* bu
 
 //
 // Reads the specifed number of bytes starting at the specified logical
-// block.  Returns a pointer to a buffer containing the data read.
-// Caller is responsible for freeing this buffer.
+// block into the provided buffer.
 //
-uint8_t* mscp_drive_c::Read(uint32_t blockNumber, size_t lengthInBytes) 
+void mscp_drive_c::Read(uint32_t blockNumber, size_t lengthInBytes, uint8_t* buffer) 
 {
-    uint8_t* buffer = new uint8_t[lengthInBytes];
-
     assert(nullptr != buffer);
 
     image_read(buffer, blockNumber * GetBlockSize(), lengthInBytes);
-
-    return buffer;
 }
 
 //
@@ -250,21 +245,17 @@ void mscp_drive_c::WriteRCTBlock(uint32_t rctBlockNumber, uint8_t* buffer)
 
 //
 // Reads a single block's worth of data from the RCT area (at the specified
-// block offset).  Returns a pointer to a buffer containing the data read.
-// Caller is responsible for freeing this buffer.
+// block offset) into the provided buffer.  Buffer must be at least as large
+// as the disk's block size.
 //
-uint8_t* mscp_drive_c::ReadRCTBlock(uint32_t rctBlockNumber) 
+void mscp_drive_c::ReadRCTBlock(uint32_t rctBlockNumber, uint8_t* buffer) 
 {
     assert(rctBlockNumber < GetRCTBlockCount());
-
-    uint8_t* buffer = new uint8_t[GetBlockSize()];
     assert(nullptr != buffer);
 
     memcpy(reinterpret_cast<void *>(buffer),
            reinterpret_cast<void *>(_rctData.get() + rctBlockNumber * GetBlockSize()),
            GetBlockSize());
-
-    return buffer;
 }
 
 //
@@ -9,20 +9,20 @@
     the side of implementation simplicity.
 
     In particular:
-         All commands are executed sequentially, as they appear in the
-         command ring.  This includes any commands in the "Immediate"
-         category.  Technically this is incorrect:  Immediate commands
-         should execute as soon as possible, before any other commands.
-         In practice I have yet to find code that cares.
-
-         This simplifies the implementation significantly, and apart
-         from maintaining fealty to the MSCP spec for Immediate commands,
-         there's no good reason to make it more complex:  real MSCP
-         controllers (like the original UDA50) would resequence commands
-         to allow optimal throughput across multiple units, etc.  On the
-         Unibone, the underlying storage and the execution speed of the
-         processor is orders of magnitude faster, so even a brute-force
-         braindead implementation like this can saturate the Unibus.
+         Commands are picked up from the command ring in order.  Commands
+         addressed to a unit (transfers, ONLINE, AVAILABLE etc.) are queued
+         to a thread per unit and executed there in ring order; all other
+         commands, including the "Immediate" category, are executed right
+         away by the polling thread.  Responses are posted as commands
+         complete, so a long transfer on one unit does not hold up the
+         others -- MSCP allows completion out of order.
+
+         Within a unit there is no resequencing: real MSCP controllers
+         (like the original UDA50) would reorder a unit's commands for
+         optimal seek behavior.  Bus DMA of all units is serialized by
+         the port; parallelism comes from overlapping the image file I/O.
+         Long READs and WRITEs are streamed in slices, so the image I/O of
+         one slice overlaps the bus DMA of the previous.
 
     TODO:
     - Some commands aren't checked as thoroughly for errors as they could be.
@@ -41,6 +41,7 @@
  
 #include "logger.hpp"
 #include "utils.hpp"
+#include "ddrmem.h"
 
 #include "mscp_drive.hpp"
 #include "mscp_server.hpp"
@@ -58,6 +59,31 @@ void* polling_worker(
     return nullptr;
 }
 
+// Parameters of the READ, WRITE, ERASE, ACCESS and COMPARE HOST DATA commands
+#pragma pack(push,1)
+struct ReadWriteEraseParameters
+{
+    uint32_t ByteCount;
+    uint32_t BufferPhysicalAddress;  // upper 8 bits are channel address for VAXen
+    uint32_t Unused0;
+    uint32_t Unused1;
+    uint32_t LBN;
+};
+#pragma pack(pop)
+
+//
+// unit_worker():
+//  Runs the command thread of one MSCP unit.
+//
+void* unit_worker(
+    void *context)
+{
+    mscp_server::UnitQueue* unit = 
+        reinterpret_cast<mscp_server::UnitQueue*>(context);
+    unit->server->UnitPoll(unit->unitNumber);
+    return nullptr;
+}
+
 mscp_server::mscp_server(
     uda_c *port) :
         device_c(),
@@ -67,6 +93,11 @@ mscp_server::mscp_server(
         _pollState(PollingState::Wait),
         polling_cond(PTHREAD_COND_INITIALIZER),
         polling_mutex(PTHREAD_MUTEX_INITIALIZER),
+        _abort_units(false),
+        _units_aborting(false),
+        unit_mutex(PTHREAD_MUTEX_INITIALIZER),
+        units_idle_cond(PTHREAD_COND_INITIALIZER),
+        response_mutex(PTHREAD_MUTEX_INITIALIZER),
         _credits(INIT_CREDITS) 
 {
     set_workers_count(0) ; // no std worker()
@@ -79,6 +110,7 @@ mscp_server::mscp_server(
     enabled.set(true) ; 
     enabled.readonly = true ; // always active
 
+    StartUnitThreads();
     StartPollingThread();
 }
 
@@ -86,6 +118,7 @@ mscp_server::mscp_server(
 mscp_server::~mscp_server()
 {
     AbortPollingThread();
+    AbortUnitThreads();
 }
 
 
@@ -158,6 +191,85 @@ mscp_server::AbortPollingThread(void)
     DEBUG_FAST("Polling thread aborted.");  
 }
 
+//
+// StartUnitThreads():
+//  Creates one command queue and thread per unit.
+//  The threads sleep until QueueUnitCommand() hands them work.
+//
+void
+mscp_server::StartUnitThreads(void)
+{
+    _abort_units = false;
+    _units_aborting = false;
+
+    for (uint32_t i = 0; i < DRIVE_COUNT; i++)
+    {
+        UnitQueue* unit = new UnitQueue();
+        unit->server = this;
+        unit->unitNumber = i;
+        pthread_cond_init(&unit->cond, NULL);
+        unit->busy = false;
+        unit->headLBN = 0;
+        unit->stagedLBN = 0;
+        unit->stagedByteCount = 0;
+        unit->sliceBuffers = nullptr;
+        unit->sliceBuffersDDR = false;
+        _units.push_back(std::unique_ptr<UnitQueue>(unit));
+
+        int status = pthread_create(
+            &unit->pthread,
+            NULL,
+            &unit_worker,
+            reinterpret_cast<void*>(unit));
+
+        if (status != 0)
+        {
+            FATAL("Failed to start mscp unit %d thread.  Status 0x%x", i, status);
+        }
+    }
+
+    DEBUG_FAST("%d unit threads created.", DRIVE_COUNT);
+}
+
+//
+// AbortUnitThreads():
+//  Stops all unit threads; queued commands are discarded.
+//
+void
+mscp_server::AbortUnitThreads(void)
+{
+    pthread_mutex_lock(&unit_mutex);
+    _abort_units = true;
+    for (auto& unit : _units)
+    {
+        pthread_cond_signal(&unit->cond);
+    }
+    pthread_mutex_unlock(&unit_mutex);
+
+    for (auto& unit : _units)
+    {
+        uint32_t status = pthread_join(unit->pthread, NULL);
+
+        if (status != 0)
+        {
+            FATAL("Failed to join unit thread, status 0x%x", status);
+        }
+        pthread_cond_destroy(&unit->cond);
+
+        if (unit->sliceBuffersDDR)
+        {
+            ddrmem->dma_buffer_free(reinterpret_cast<uint16_t*>(unit->sliceBuffers));
+        }
+        else
+        {
+            delete[] unit->sliceBuffers;
+        }
+    }
+    _units.clear();
+
+    DEBUG_FAST("Unit threads aborted.");  
+}
+
 //
 // Poll():
 //  The MSCP polling thread.  
@@ -200,19 +312,19 @@ mscp_server::Poll(void)
         //
         // Read all commands from the ring into a queue; then execute them.
         //
-        std::queue<std::shared_ptr<Message>> messages;
+        std::queue<MessageHandle> messages;
 
         int msgCount = 0;
         while (!_abort_polling && _pollState != PollingState::InitRestart)
         {
             bool error = false;
-            std::shared_ptr<Message> message(_port->GetNextCommand(&error));
+            MessageHandle message(_port->GetNextCommand(&error));
             if (error)
             {
                 DEBUG_FAST("Error while reading messages, returning to idle state.");
                 // The lords of STL decreed that queue should have no "clear" method
                 // so we do this garbage instead:
-                messages = std::queue<std::shared_ptr<Message>>(); 
+                messages = std::queue<MessageHandle>(); 
                 break; 
             }
             if (nullptr == message)
@@ -222,157 +334,28 @@ mscp_server::Poll(void)
             }
 
             msgCount++;
-            messages.push(message);
+            messages.push(std::move(message));
         } 
 
         //
         // Pull commands from the queue until it is empty or we're told to quit.
+        // Unit commands are handed to the unit's thread, everything else
+        // (controller and immediate commands) is executed right here.
         //
         while(!messages.empty() && !_abort_polling && _pollState != PollingState::InitRestart)
         {
-            std::shared_ptr<Message> message(messages.front());  
+            MessageHandle message(std::move(messages.front()));  
             messages.pop();
 
-            //
-            // Handle the message.  We dispatch on opcodes to the
-            // appropriate methods.  These methods modify the message
-            // object in place; this message object is then posted back
-            // to the response ring.
-            //
-            ControlMessageHeader* header = 
-                reinterpret_cast<ControlMessageHeader*>(message->Message);
-
-            DEBUG_FAST("Message size 0x%x opcode 0x%x rsvd 0x%x mod 0x%x unit %d, ursvd 0x%x, ref 0x%x", 
-                message->MessageLength,
-                header->Word3.Command.Opcode,
-                header->Word3.Command.Reserved,
-                header->Word3.Command.Modifiers,
-                header->UnitNumber,
-                header->Reserved,
-                header->ReferenceNumber);
-
-            bool protocolError = false;
-            uint32_t cmdStatus = 0;
-            uint16_t modifiers = header->Word3.Command.Modifiers;
-
-            switch (header->Word3.Command.Opcode)
+            if (IsUnitCommand(message.get()))
             {
-                case Opcodes::ABORT:
-                    cmdStatus = Abort();
-                    break;
-
-                case Opcodes::ACCESS:
-                    cmdStatus = Access(message, header->UnitNumber);
-                    break;
-
-                case Opcodes::AVAILABLE:
-                    cmdStatus = Available(header->UnitNumber, modifiers);
-                    break;
-
-                case Opcodes::COMPARE_HOST_DATA:
-                    cmdStatus = CompareHostData(message, header->UnitNumber);
-                    break;
-
-                case Opcodes::DETERMINE_ACCESS_PATHS:
-                    cmdStatus = DetermineAccessPaths(header->UnitNumber);
-                    break;
-
-                case Opcodes::ERASE:
-                    cmdStatus = Erase(message, header->UnitNumber, modifiers);
-                    break;
-
-                case Opcodes::GET_COMMAND_STATUS:
-                    cmdStatus = GetCommandStatus(message);
-                    break;
-
-                case Opcodes::GET_UNIT_STATUS:
-                    cmdStatus = GetUnitStatus(message, header->UnitNumber, modifiers);
-                    break;
-
-                case Opcodes::ONLINE:
-                    cmdStatus = Online(message, header->UnitNumber, modifiers);
-                    break;
-
-                case Opcodes::READ:
-                    cmdStatus = Read(message, header->UnitNumber, modifiers);
-                    break;
-
-                case Opcodes::REPLACE:
-                    cmdStatus = Replace(message, header->UnitNumber);
-                    break;
-
-                case Opcodes::SET_CONTROLLER_CHARACTERISTICS:
-                    cmdStatus = SetControllerCharacteristics(message);     
-                    break;
-
-                case Opcodes::SET_UNIT_CHARACTERISTICS:
-                    cmdStatus = SetUnitCharacteristics(message, header->UnitNumber, modifiers);
-                    break;
-
-                case Opcodes::WRITE:
-                    cmdStatus = Write(message, header->UnitNumber, modifiers);
-                    break;
-
-                default:
-                    DEBUG_FAST("Unimplemented MSCP command 0x%x", header->Word3.Command.Opcode);
-                    protocolError = true;
-                    break;
+                QueueUnitCommand(std::move(message));
+                continue;
             }
 
-            if (protocolError)
-            {
-                uint16_t subCode = offsetof(ControlMessageHeader, Word3) + HEADER_OFFSET;
-                cmdStatus = STATUS(Status::INVALID_COMMAND, subCode, 0);
-            }
-
-            DEBUG_FAST("cmd 0x%x st 0x%x fl 0x%x", cmdStatus, GET_STATUS(cmdStatus), GET_FLAGS(cmdStatus));
-
-            //
-            // Set the endcode and status bits
-            //
-            header->Word3.End.Status = GET_STATUS(cmdStatus);
-            header->Word3.End.Flags = GET_FLAGS(cmdStatus);
-
-            // Set the End code properly -- for a protocol error, 
-            // this is just the End code, for all others it's the End code
-            // or'd with the original opcode.
-            if (protocolError)
-            {
-                 // Just the END code, no opcode
-                 header->Word3.End.Endcode = Endcodes::END;
-            }
-            else
-            {
-                 header->Word3.End.Endcode |= Endcodes::END;
-            }
-
-            if (message->Word1.Info.MessageType == MessageTypes::Sequential &&
-                header->Word3.End.Endcode & Endcodes::END)
-            {
-                //
-                // We steal the credits hack from simh:
-                // The controller gives all of its credits to the host,
-                // thereafter it supplies one credit for every response
-                // packet sent.
-                // 
-                uint8_t grantedCredits = std::min(_credits, static_cast<uint8_t>(MAX_CREDITS));
-                _credits -= grantedCredits;
-                message->Word1.Info.Credits = grantedCredits + 1;
-                DEBUG_FAST("granted credits %d", grantedCredits + 1);
-            }
-            else
-            {
-                message->Word1.Info.Credits = 0;
-            }
-
-            //
-            // Post the response to the port's response ring.
-            // If everything is working properly, there should always be room.
-            //
-            if(!_port->PostResponse(message.get()))
-            {
-                FATAL("Unexpected: no room in response ring.");
-            }
+            bool protocolError = false;
+            uint32_t cmdStatus = ExecuteCommand(message.get(), protocolError);
+            PostCompletion(message.get(), cmdStatus, protocolError);
 
             //
             // Go around and pick up the next one.
@@ -407,6 +390,767 @@ mscp_server::Poll(void)
     DEBUG_FAST("MSCP Polling thread exiting."); 
 }
 
+//
+// ExecuteCommand():
+//  Handles a single command message.  We dispatch on opcodes to the
+//  appropriate methods.  Returns the status for the end message;
+//  protocolError is set if the opcode is not supported.
+//  Called by the polling thread and by the unit threads.
+//
+uint32_t
+mscp_server::ExecuteCommand(
+    Message* message,
+    bool& protocolError)
+{
+    //
+    // The command methods modify the message object in place;
+    // this message object is then posted back to the response ring.
+    //
+    ControlMessageHeader* header = 
+        reinterpret_cast<ControlMessageHeader*>(message->Message);
+
+    DEBUG_FAST("Message size 0x%x opcode 0x%x rsvd 0x%x mod 0x%x unit %d, ursvd 0x%x, ref 0x%x", 
+        message->MessageLength,
+        header->Word3.Command.Opcode,
+        header->Word3.Command.Reserved,
+        header->Word3.Command.Modifiers,
+        header->UnitNumber,
+        header->Reserved,
+        header->ReferenceNumber);
+
+    protocolError = false;
+    uint32_t cmdStatus = 0;
+    uint16_t modifiers = header->Word3.Command.Modifiers;
+
+    switch (header->Word3.Command.Opcode)
+    {
+        case Opcodes::ABORT:
+            cmdStatus = Abort();
+            break;
+
+        case Opcodes::ACCESS:
+            cmdStatus = Access(message, header->UnitNumber);
+            break;
+
+        case Opcodes::AVAILABLE:
+            cmdStatus = Available(header->UnitNumber, modifiers);
+            break;
+
+        case Opcodes::COMPARE_HOST_DATA:
+            cmdStatus = CompareHostData(message, header->UnitNumber);
+            break;
+
+        case Opcodes::DETERMINE_ACCESS_PATHS:
+            cmdStatus = DetermineAccessPaths(header->UnitNumber);
+            break;
+
+        case Opcodes::ERASE:
+            cmdStatus = Erase(message, header->UnitNumber, modifiers);
+            break;
+
+        case Opcodes::GET_COMMAND_STATUS:
+            cmdStatus = GetCommandStatus(message);
+            break;
+
+        case Opcodes::GET_UNIT_STATUS:
+            cmdStatus = GetUnitStatus(message, header->UnitNumber, modifiers);
+            break;
+
+        case Opcodes::ONLINE:
+            cmdStatus = Online(message, header->UnitNumber, modifiers);
+            break;
+
+        case Opcodes::READ:
+            cmdStatus = Read(message, header->UnitNumber, modifiers);
+            break;
+
+        case Opcodes::REPLACE:
+            cmdStatus = Replace(message, header->UnitNumber);
+            break;
+
+        case Opcodes::SET_CONTROLLER_CHARACTERISTICS:
+            cmdStatus = SetControllerCharacteristics(message);     
+            break;
+
+        case Opcodes::SET_UNIT_CHARACTERISTICS:
+            cmdStatus = SetUnitCharacteristics(message, header->UnitNumber, modifiers);
+            break;
+
+        case Opcodes::WRITE:
+            cmdStatus = Write(message, header->UnitNumber, modifiers);
+            break;
+
+        default:
+            DEBUG_FAST("Unimplemented MSCP command 0x%x", header->Word3.Command.Opcode);
+            protocolError = true;
+            break;
+    }
+
+    if (protocolError)
+    {
+        uint16_t subCode = offsetof(ControlMessageHeader, Word3) + HEADER_OFFSET;
+        cmdStatus = STATUS(Status::INVALID_COMMAND, subCode, 0);
+    }
+
+    return cmdStatus;
+}
+
+//
+// PostCompletion():
+//  Turns the executed command message into its end message and posts it
+//  to the port's response ring.  Responses are posted in completion
+//  order, which need not be ring order (see the header comment).
+//
+void
+mscp_server::PostCompletion(
+    Message* message,
+    uint32_t cmdStatus,
+    bool protocolError)
+{
+    ControlMessageHeader* header = 
+        reinterpret_cast<ControlMessageHeader*>(message->Message);
+
+    pthread_mutex_lock(&response_mutex);
+
+    DEBUG_FAST("cmd 0x%x st 0x%x fl 0x%x", cmdStatus, GET_STATUS(cmdStatus), GET_FLAGS(cmdStatus));
+
+    //
+    // Set the endcode and status bits
+    //
+    header->Word3.End.Status = GET_STATUS(cmdStatus);
+    header->Word3.End.Flags = GET_FLAGS(cmdStatus);
+
+    // Set the End code properly -- for a protocol error, 
+    // this is just the End code, for all others it's the End code
+    // or'd with the original opcode.
+    if (protocolError)
+    {
+         // Just the END code, no opcode
+         header->Word3.End.Endcode = Endcodes::END;
+    }
+    else
+    {
+         header->Word3.End.Endcode |= Endcodes::END;
+    }
+
+    if (message->Word1.Info.MessageType == MessageTypes::Sequential &&
+        header->Word3.End.Endcode & Endcodes::END)
+    {
+        //
+        // We steal the credits hack from simh:
+        // The controller gives all of its credits to the host,
+        // thereafter it supplies one credit for every response
+        // packet sent.
+        // 
+        uint8_t grantedCredits = std::min(_credits, static_cast<uint8_t>(MAX_CREDITS));
+        _credits -= grantedCredits;
+        message->Word1.Info.Credits = grantedCredits + 1;
+        DEBUG_FAST("granted credits %d", grantedCredits + 1);
+    }
+    else
+    {
+        message->Word1.Info.Credits = 0;
+    }
+
+    //
+    // Post the response to the port's response ring.
+    // If everything is working properly, there should always be room.
+    //
+    if(!_port->PostResponse(message))
+    {
+        FATAL("Unexpected: no room in response ring.");
+    }
+
+    pthread_mutex_unlock(&response_mutex);
+}
+
+//
+// IsUnitCommand():
+//  Returns true if the message is executed by its unit's thread.
+//  These are the commands that operate on the unit, in particular
+//  all data transfers.  Immediate and controller commands, and
+//  commands for non-existent units, are executed by the polling thread.
+//
+bool
+mscp_server::IsUnitCommand(
+    Message* message)
+{
+    ControlMessageHeader* header = 
+        reinterpret_cast<ControlMessageHeader*>(message->Message);
+
+    if (header->UnitNumber >= _units.size())
+    {
+        return false;
+    }
+
+    switch (header->Word3.Command.Opcode)
+    {
+        case Opcodes::ACCESS:
+        case Opcodes::AVAILABLE:
+        case Opcodes::COMPARE_HOST_DATA:
+        case Opcodes::ERASE:
+        case Opcodes::ONLINE:
+        case Opcodes::READ:
+        case Opcodes::REPLACE:
+        case Opcodes::SET_UNIT_CHARACTERISTICS:
+        case Opcodes::WRITE:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+//
+// QueueUnitCommand():
+//  Appends the message to its unit's queue and wakes the unit thread.
+//
+void
+mscp_server::QueueUnitCommand(
+    MessageHandle message)
+{
+    ControlMessageHeader* header = 
+        reinterpret_cast<ControlMessageHeader*>(message->Message);
+
+    UnitQueue* unit = _units[header->UnitNumber].get();
+
+    pthread_mutex_lock(&unit_mutex);
+    unit->messages.push_back(std::move(message));
+    pthread_cond_signal(&unit->cond);
+    pthread_mutex_unlock(&unit_mutex);
+}
+
+//
+// UnitPoll():
+//  The command thread of one unit.
+//  Executes the unit's commands in the order they appeared in the
+//  command ring (or as reordered by TakeUnitCommands()) and posts each
+//  response as soon as it completes.
+//  Long transfers on one unit thus do not hold up the other units.
+//
+void
+mscp_server::UnitPoll(
+    uint32_t unitNumber)
+{
+    worker_init_realtime_priority(rt_device);
+
+    UnitQueue* unit = _units[unitNumber].get();
+
+    pthread_mutex_lock(&unit_mutex);
+    while (!_abort_units)
+    {
+        if (unit->messages.empty())
+        {
+            pthread_cond_wait(
+                &unit->cond,
+                &unit_mutex);
+            continue;
+        }
+
+        std::vector<MessageHandle> batch;
+        TakeUnitCommands(unit, batch);
+        for (auto& message : batch)
+        {
+            unit->busyReferences.push_back(
+                reinterpret_cast<ControlMessageHeader*>(message->Message)->ReferenceNumber);
+        }
+        unit->busy = true;
+        pthread_mutex_unlock(&unit_mutex);
+
+        if (batch.size() > 1)
+        {
+            StageMergedRead(unit, batch);
+        }
+
+        for (auto& message : batch)
+        {
+            //
+            // If a reset arrives, the response ring is about to be reinitialized:
+            // the rest of the batch is discarded, a response in progress is
+            // dropped.  "busy" is held until the last response is posted,
+            // so AbortUnitCommands() waits for it.
+            //
+            pthread_mutex_lock(&unit_mutex);
+            bool aborting = _units_aborting;
+            pthread_mutex_unlock(&unit_mutex);
+            if (aborting)
+            {
+                break;
+            }
+
+            bool protocolError = false;
+            uint32_t cmdStatus = ExecuteCommand(message.get(), protocolError);
+
+            pthread_mutex_lock(&unit_mutex);
+            aborting = _units_aborting;
+            unit->busyReferences.pop_front();
+            pthread_mutex_unlock(&unit_mutex);
+            if (!aborting)
+            {
+                PostCompletion(message.get(), cmdStatus, protocolError);
+            }
+        }
+        unit->stagedByteCount = 0;
+
+        pthread_mutex_lock(&unit_mutex);
+        unit->busyReferences.clear();   // rest of an aborted batch
+        unit->busy = false;
+        pthread_cond_broadcast(&units_idle_cond);
+    }
+    pthread_mutex_unlock(&unit_mutex);
+
+    DEBUG_FAST("MSCP unit %d thread exiting.", unitNumber); 
+}
+
+//
+// Transfer commands may be reordered among themselves.  Every other unit
+// command acts as a barrier which no transfer passes.
+//
+static bool
+IsTransferCommand(
+    ControlMessageHeader* header)
+{
+    switch (header->Word3.Command.Opcode)
+    {
+        case Opcodes::ACCESS:
+        case Opcodes::COMPARE_HOST_DATA:
+        case Opcodes::ERASE:
+        case Opcodes::READ:
+        case Opcodes::WRITE:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+//
+// Two transfers must stay in ring order if their block ranges overlap
+// and at least one of them modifies the medium.
+//
+static bool
+TransfersConflict(
+    ControlMessageHeader* a,
+    ControlMessageHeader* b,
+    uint32_t blockSize)
+{
+    bool aWrites = a->Word3.Command.Opcode == Opcodes::WRITE || a->Word3.Command.Opcode == Opcodes::ERASE;
+    bool bWrites = b->Word3.Command.Opcode == Opcodes::WRITE || b->Word3.Command.Opcode == Opcodes::ERASE;
+    if (!aWrites && !bWrites)
+    {
+        return false;
+    }
+
+    ReadWriteEraseParameters* pa = reinterpret_cast<ReadWriteEraseParameters*>(a->Parameters);
+    ReadWriteEraseParameters* pb = reinterpret_cast<ReadWriteEraseParameters*>(b->Parameters);
+    uint64_t aEnd = pa->LBN + (pa->ByteCount + blockSize - 1) / blockSize;
+    uint64_t bEnd = pb->LBN + (pb->ByteCount + blockSize - 1) / blockSize;
+
+    return pa->LBN < bEnd && pb->LBN < aEnd;
+}
+
+//
+// IsEligibleUnitCommand():
+//  Returns true if the queued transfer at "index" may be executed before
+//  all commands ahead of it in the unit queue.
+//  Called with unit_mutex held.
+//
+bool
+mscp_server::IsEligibleUnitCommand(
+    UnitQueue* unit,
+    size_t index)
+{
+    ControlMessageHeader* header = 
+        reinterpret_cast<ControlMessageHeader*>(unit->messages[index]->Message);
+
+    if (!IsTransferCommand(header))
+    {
+        return false;
+    }
+
+    uint32_t blockSize = GetDrive(unit->unitNumber)->GetBlockSize();
+    for (size_t i = 0; i < index; i++)
+    {
+        ControlMessageHeader* ahead = 
+            reinterpret_cast<ControlMessageHeader*>(unit->messages[i]->Message);
+
+        if (!IsTransferCommand(ahead) || TransfersConflict(ahead, header, blockSize))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//
+// TakeUnitCommands():
+//  Removes the next command(s) to execute from the unit queue.
+//  Without "seek_optimize" this is simply the oldest command.
+//  Otherwise the queued transfers are served in C-SCAN order: the lowest
+//  LBN at or above the position of the last transfer, else the lowest LBN
+//  overall.  READs which continue the chosen READ block by block are
+//  taken along, so StageMergedRead() can serve them by one image read.
+//  Called with unit_mutex held, the queue is not empty.
+//
+void
+mscp_server::TakeUnitCommands(
+    UnitQueue* unit,
+    std::vector<MessageHandle>& batch)
+{
+    size_t next = 0;
+
+    if (_port->seek_optimize.value && unit->messages.size() > 1)
+    {
+        bool found = false;
+        bool foundAhead = false;
+        uint32_t nextLBN = 0;
+
+        for (size_t i = 0; i < unit->messages.size(); i++)
+        {
+            ControlMessageHeader* header = 
+                reinterpret_cast<ControlMessageHeader*>(unit->messages[i]->Message);
+
+            if (!IsTransferCommand(header))
+            {
+                // barrier: only the commands before it are candidates
+                if (i == 0)
+                {
+                    found = true;
+                }
+                break;
+            }
+
+            if (!IsEligibleUnitCommand(unit, i))
+            {
+                continue;
+            }
+
+            uint32_t lbn = reinterpret_cast<ReadWriteEraseParameters*>(header->Parameters)->LBN;
+            bool ahead = lbn >= unit->headLBN;
+            if (!found ||
+                (ahead && !foundAhead) ||
+                (ahead == foundAhead && lbn < nextLBN))
+            {
+                found = true;
+                foundAhead = ahead;
+                nextLBN = lbn;
+                next = i;
+            }
+        }
+    }
+
+    Message* message = unit->messages[next].get();
+    batch.push_back(std::move(unit->messages[next]));
+    unit->messages.erase(unit->messages.begin() + next);
+
+    ControlMessageHeader* header = 
+        reinterpret_cast<ControlMessageHeader*>(message->Message);
+
+    if (!_port->seek_optimize.value || !IsTransferCommand(header))
+    {
+        return;
+    }
+
+    mscp_drive_c* drive = GetDrive(unit->unitNumber);
+    uint32_t blockSize = drive->GetBlockSize();
+    ReadWriteEraseParameters* params = 
+        reinterpret_cast<ReadWriteEraseParameters*>(header->Parameters);
+    uint32_t endLBN = params->LBN + (params->ByteCount + blockSize - 1) / blockSize;
+    unit->headLBN = endLBN;
+
+    //
+    // Collect READs of whole blocks which continue the chosen one,
+    // as long as they stay in the data area of the unit.
+    //
+    if (header->Word3.Command.Opcode != Opcodes::READ ||
+        params->ByteCount % blockSize)
+    {
+        return;
+    }
+
+    uint32_t mergedBytes = params->ByteCount;
+    for (size_t i = 0; i < unit->messages.size(); )
+    {
+        ControlMessageHeader* candidate = 
+            reinterpret_cast<ControlMessageHeader*>(unit->messages[i]->Message);
+
+        if (!IsTransferCommand(candidate))
+        {
+            break;
+        }
+
+        ReadWriteEraseParameters* candidateParams = 
+            reinterpret_cast<ReadWriteEraseParameters*>(candidate->Parameters);
+
+        if (candidate->Word3.Command.Opcode == Opcodes::READ &&
+            candidateParams->LBN == endLBN &&
+            candidateParams->ByteCount > 0 &&
+            candidateParams->ByteCount % blockSize == 0 &&
+            mergedBytes + candidateParams->ByteCount <= MAX_MERGED_READ_BYTES &&
+            endLBN + candidateParams->ByteCount / blockSize <= drive->GetBlockCount() &&
+            IsEligibleUnitCommand(unit, i))
+        {
+            batch.push_back(std::move(unit->messages[i]));
+            unit->messages.erase(unit->messages.begin() + i);
+            mergedBytes += candidateParams->ByteCount;
+            endLBN += candidateParams->ByteCount / blockSize;
+            unit->headLBN = endLBN;
+
+            // a later READ may continue this one: rescan
+            i = 0;
+            continue;
+        }
+        i++;
+    }
+}
+
+//
+// StageMergedRead():
+//  Reads the block range of a batch of adjacent READs from the image with
+//  a single call.  DoDiskTransfer() then takes each command's data from
+//  the staged buffer via GetStagedRead().
+//
+void
+mscp_server::StageMergedRead(
+    UnitQueue* unit,
+    std::vector<MessageHandle>& batch)
+{
+    mscp_drive_c* drive = GetDrive(unit->unitNumber);
+
+    if (!drive->IsAvailable() || !drive->IsOnline())
+    {
+        // DoDiskTransfer() reports the error for each command
+        return;
+    }
+
+    ReadWriteEraseParameters* first = reinterpret_cast<ReadWriteEraseParameters*>(
+        reinterpret_cast<ControlMessageHeader*>(batch.front()->Message)->Parameters);
+
+    uint32_t byteCount = 0;
+    for (auto& message : batch)
+    {
+        byteCount += reinterpret_cast<ReadWriteEraseParameters*>(
+            reinterpret_cast<ControlMessageHeader*>(message->Message)->Parameters)->ByteCount;
+    }
+
+    DEBUG_FAST("Unit %d: %d READs merged, lbn %d count %d", 
+        unit->unitNumber, (int)batch.size(), first->LBN, byteCount);
+
+    uint8_t* data = unit->stagedBuffer.Get(byteCount);
+    drive->Read(first->LBN, byteCount, data);
+    unit->stagedLBN = first->LBN;
+    unit->stagedByteCount = byteCount;
+}
+
+//
+// GetStagedRead():
+//  Returns the data of a READ from the unit's staged buffer,
+//  or nullptr if the range was not read by StageMergedRead().
+//  Only called by the unit's own thread.
+//
+uint8_t*
+mscp_server::GetStagedRead(
+    uint16_t unitNumber,
+    uint32_t lbn,
+    uint32_t byteCount)
+{
+    if (unitNumber >= _units.size())
+    {
+        return nullptr;
+    }
+
+    UnitQueue* unit = _units[unitNumber].get();
+    if (0 == unit->stagedByteCount)
+    {
+        return nullptr;
+    }
+
+    uint32_t blockSize = GetDrive(unitNumber)->GetBlockSize();
+    if (lbn < unit->stagedLBN ||
+        (uint64_t)(lbn - unit->stagedLBN) * blockSize + byteCount > unit->stagedByteCount)
+    {
+        return nullptr;
+    }
+
+    return unit->stagedBuffer.data.get() + (lbn - unit->stagedLBN) * blockSize;
+}
+
+//
+// GetSliceBuffers():
+//  Returns the unit's two slice buffers, back to back.
+//  They live in shared DDR if possible, so the PRU DMAs them without copy.
+//
+uint8_t*
+mscp_server::GetSliceBuffers(
+    UnitQueue* unit)
+{
+    if (nullptr == unit->sliceBuffers)
+    {
+        uint16_t* ddrBuffers = ddrmem->dma_buffer_alloc(2 * SLICE_BYTES / 2);  // 2 slices, wordcount
+        if (ddrBuffers)
+        {
+            unit->sliceBuffers = reinterpret_cast<uint8_t*>(ddrBuffers);
+            unit->sliceBuffersDDR = true;
+        }
+        else
+        {
+            unit->sliceBuffers = new uint8_t[2 * SLICE_BYTES];
+            unit->sliceBuffersDDR = false;
+        }
+    }
+
+    return unit->sliceBuffers;
+}
+
+//
+// DoSlicedRead():
+//  READ in slices of SLICE_BYTES: while one slice is DMA'd to host memory,
+//  the next one is read from the image into the other slice buffer.
+//  Returns false on NXM.
+//
+bool
+mscp_server::DoSlicedRead(
+    UnitQueue* unit,
+    mscp_drive_c* drive,
+    uint32_t lbn,
+    uint32_t byteCount,
+    uint32_t address)
+{
+    uint8_t* buffers = GetSliceBuffers(unit);
+    uint32_t blocksPerSlice = SLICE_BYTES / drive->GetBlockSize();
+
+    uint32_t offset = 0;
+    uint32_t length = std::min(byteCount, static_cast<uint32_t>(SLICE_BYTES));
+    unsigned current = 0;
+    drive->Read(lbn, length, buffers);
+
+    while (true)
+    {
+        uint8_t* buffer = buffers + current * SLICE_BYTES;
+        dma_request_c* request = _port->GetSliceDMARequest(unit->unitNumber, current);
+        _port->DMAWriteSubmit(request, address + offset, length, buffer);
+
+        uint32_t nextOffset = offset + length;
+        uint32_t nextLength = std::min(byteCount - nextOffset, static_cast<uint32_t>(SLICE_BYTES));
+        if (nextLength > 0)
+        {
+            drive->Read(lbn + (nextOffset / SLICE_BYTES) * blocksPerSlice, nextLength,
+                buffers + (current ^ 1) * SLICE_BYTES);
+        }
+
+        if (!_port->DMAWait(request))
+        {
+            return false;
+        }
+
+        if (0 == nextLength)
+        {
+            return true;
+        }
+
+        offset = nextOffset;
+        length = nextLength;
+        current ^= 1;
+    }
+}
+
+//
+// DoSlicedWrite():
+//  WRITE in slices of SLICE_BYTES: while one slice is written to the image,
+//  the next one is DMA'd from host memory into the other slice buffer.
+//  On NXM the slices before the failing one have been written.
+//  Returns false on NXM.
+//
+bool
+mscp_server::DoSlicedWrite(
+    UnitQueue* unit,
+    mscp_drive_c* drive,
+    uint32_t lbn,
+    uint32_t byteCount,
+    uint32_t address)
+{
+    uint8_t* buffers = GetSliceBuffers(unit);
+    uint32_t blocksPerSlice = SLICE_BYTES / drive->GetBlockSize();
+
+    uint32_t offset = 0;
+    uint32_t length = std::min(byteCount, static_cast<uint32_t>(SLICE_BYTES));
+    unsigned current = 0;
+    dma_request_c* request = _port->GetSliceDMARequest(unit->unitNumber, current);
+    _port->DMAReadSubmit(request, address, length, buffers);
+
+    while (true)
+    {
+        if (!_port->DMAWait(request))
+        {
+            return false;
+        }
+
+        uint32_t nextOffset = offset + length;
+        uint32_t nextLength = std::min(byteCount - nextOffset, static_cast<uint32_t>(SLICE_BYTES));
+        if (nextLength > 0)
+        {
+            request = _port->GetSliceDMARequest(unit->unitNumber, current ^ 1);
+            _port->DMAReadSubmit(request, address + nextOffset, nextLength,
+                buffers + (current ^ 1) * SLICE_BYTES);
+        }
+
+        drive->Write(lbn + (offset / SLICE_BYTES) * blocksPerSlice, length,
+            buffers + current * SLICE_BYTES);
+
+        if (0 == nextLength)
+        {
+            return true;
+        }
+
+        offset = nextOffset;
+        length = nextLength;
+        current ^= 1;
+    }
+}
+
+//
+// UnitBuffer::Get():
+//  Returns the buffer with room for at least length bytes.
+//  Contents are not preserved when it has to grow.
+//
+uint8_t*
+mscp_server::UnitBuffer::Get(
+    size_t length)
+{
+    if (length > size)
+    {
+        data.reset(new uint8_t[length]);
+        size = length;
+    }
+
+    return data.get();
+}
+
+//
+// AbortUnitCommands():
+//  Discards all queued unit commands and waits for the ones in progress
+//  to finish.  Their responses are not posted.
+//
+void
+mscp_server::AbortUnitCommands(void)
+{
+    pthread_mutex_lock(&unit_mutex);
+    _units_aborting = true;
+    for (auto& unit : _units)
+    {
+        unit->messages.clear();
+        while (unit->busy)
+        {
+            pthread_cond_wait(
+                &units_idle_cond,
+                &unit_mutex);
+        }
+    }
+    _units_aborting = false;
+    pthread_mutex_unlock(&unit_mutex);
+}
+
 //
 // The following are all implementations of the MSCP commands we support.
 //
@@ -417,10 +1161,9 @@ mscp_server::Abort()
     INFO("MSCP ABORT");
 
     //
-    // Since we do not reorder messages and in fact pick up and execute
-    // them one at a time, sequentially as they appear in the ring buffer,
-    // by the time we've gotten this command, the command it's referring
-    // to is long gone.
+    // We do not track outstanding commands by reference number: the
+    // command this refers to has either already been executed, or sits
+    // in its unit queue and will be executed shortly.
     // This is semi-legal behavior and it's legal for us to ignore ABORT in this
     // case.
     //
@@ -455,7 +1198,7 @@ mscp_server::Available(
 
 uint32_t
 mscp_server::Access(
-    std::shared_ptr<Message> message,
+    Message* message,
     uint16_t unitNumber)
 {
     INFO("MSCP ACCESS");
@@ -469,7 +1212,7 @@ mscp_server::Access(
 
 uint32_t
 mscp_server::CompareHostData(
-    std::shared_ptr<Message> message,
+    Message* message,
     uint16_t unitNumber)
 {
     INFO("MSCP COMPARE HOST DATA");
@@ -504,7 +1247,7 @@ mscp_server::DetermineAccessPaths(
 
 uint32_t
 mscp_server::Erase(
-    std::shared_ptr<Message> message,
+    Message* message,
     uint16_t unitNumber,
     uint16_t modifiers)
 {
@@ -517,7 +1260,7 @@ mscp_server::Erase(
 
 uint32_t
 mscp_server::GetCommandStatus(
-    std::shared_ptr<Message> message)
+    Message* message)
 {
     INFO("MSCP GET COMMAND STATUS");
 
@@ -537,17 +1280,51 @@ mscp_server::GetCommandStatus(
             GetParameterPointer(message));
 
     //
-    // This will always return zero; as with the ABORT command, at this
-    // point the command being referenced has already been executed.
+    // Only unit commands can be outstanding: immediate and controller
+    // commands complete before the next command is read from the ring.
+    // The status decreases as the command makes progress:
+    // 1 while it executes, higher while it waits in its unit queue.
+    // Zero if the command is unknown or already completed.
     //
+    uint32_t outstanding = params->OutstandingReferenceNumber;
     params->CommandStatus = 0;
 
+    pthread_mutex_lock(&unit_mutex);
+    for (auto& unit : _units)
+    {
+        uint32_t status = 1;
+        for (uint32_t reference : unit->busyReferences)
+        {
+            if (reference == outstanding)
+            {
+                params->CommandStatus = status;
+            }
+            status++;
+        }
+
+        for (auto& queued : unit->messages)
+        {
+            if (reinterpret_cast<ControlMessageHeader*>(queued->Message)->ReferenceNumber
+                == outstanding)
+            {
+                params->CommandStatus = status;
+            }
+            status++;
+        }
+
+        if (params->CommandStatus != 0)
+        {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&unit_mutex);
+
     return STATUS(Status::SUCCESS, 0, 0);
 }
 
 uint32_t
 mscp_server::GetUnitStatus(
-    std::shared_ptr<Message> message,
+    Message* message,
     uint16_t unitNumber,
     uint16_t modifiers)
 {
@@ -652,7 +1429,7 @@ mscp_server::GetUnitStatus(
 
 uint32_t
 mscp_server::Online(
-    std::shared_ptr<Message> message,
+    Message* message,
     uint16_t unitNumber,
     uint16_t modifiers)
 {
@@ -684,7 +1461,7 @@ mscp_server::Online(
 
 uint32_t
 mscp_server::Replace(
-    std::shared_ptr<Message> message,
+    Message* message,
     uint16_t unitNumber)
 {
     INFO("MSCP REPLACE");
@@ -709,7 +1486,7 @@ mscp_server::Replace(
 
 uint32_t
 mscp_server::SetControllerCharacteristics(
-    std::shared_ptr<Message> message)
+    Message* message)
 {
     #pragma pack(push,1)
     struct SetControllerCharacteristicsParameters
@@ -772,7 +1549,7 @@ mscp_server::SetControllerCharacteristics(
 
 uint32_t
 mscp_server::SetUnitCharacteristics(
-    std::shared_ptr<Message> message,
+    Message* message,
     uint16_t unitNumber,
     uint16_t modifiers)
 {
@@ -799,7 +1576,7 @@ mscp_server::SetUnitCharacteristics(
 
 uint32_t
 mscp_server::Read(
-    std::shared_ptr<Message> message,
+    Message* message,
     uint16_t unitNumber,
     uint16_t modifiers)
 {
@@ -812,7 +1589,7 @@ mscp_server::Read(
 
 uint32_t
 mscp_server::Write(
-    std::shared_ptr<Message> message,
+    Message* message,
     uint16_t unitNumber,
     uint16_t modifiers)
 {
@@ -829,7 +1606,7 @@ mscp_server::Write(
 //
 uint32_t
 mscp_server::SetUnitCharacteristicsInternal(
-    std::shared_ptr<Message> message,
+    Message* message,
     uint16_t unitNumber,
     uint16_t modifiers,
     bool bringOnline)
@@ -900,21 +1677,10 @@ mscp_server::SetUnitCharacteristicsInternal(
 uint32_t
 mscp_server::DoDiskTransfer(
     uint16_t operation,
-    std::shared_ptr<Message> message,
+    Message* message,
     uint16_t unitNumber,
     uint16_t modifiers)
 {
-    #pragma pack(push,1)
-    struct ReadWriteEraseParameters
-    {
-        uint32_t ByteCount;
-        uint32_t BufferPhysicalAddress;  // upper 8 bits are channel address for VAXen
-        uint32_t Unused0;
-        uint32_t Unused1;
-        uint32_t LBN;
-    };
-    #pragma pack(pop)
-
     ReadWriteEraseParameters* params =
         reinterpret_cast<ReadWriteEraseParameters*>(GetParameterPointer(message));
 
@@ -970,6 +1736,9 @@ mscp_server::DoDiskTransfer(
         return STATUS(Status::INVALID_COMMAND, subCode, 0);
     }
 
+    // Transfers run on the unit's thread, which owns these buffers.
+    UnitQueue* unit = _units[unitNumber].get();
+
     //
     // OK: do the transfer from the PDP-11 to a buffer
     //
@@ -984,28 +1753,28 @@ mscp_server::DoDiskTransfer(
         case Opcodes::COMPARE_HOST_DATA:
         {
             // Read the data in from disk, read the data in from memory, and compare.
-            std::unique_ptr<uint8_t> diskBuffer;
+            uint8_t* diskBuffer = unit->diskBuffer.Get(params->ByteCount);
 
             if (rctAccess)
             {
-                diskBuffer.reset(drive->ReadRCTBlock(rctBlockNumber));
+                drive->ReadRCTBlock(rctBlockNumber, diskBuffer);
             }
             else
             {
-                diskBuffer.reset(drive->Read(params->LBN, params->ByteCount));
+                drive->Read(params->LBN, params->ByteCount, diskBuffer);
             }
 
-            std::unique_ptr<uint8_t> memBuffer(_port->DMARead(
+            uint8_t* memBuffer = unit->hostBuffer.Get(params->ByteCount);
+ 
+            if (!_port->DMARead(
                 params->BufferPhysicalAddress & 0x00ffffff,
                 params->ByteCount,
-                params->ByteCount));
- 
-            if (!memBuffer)
+                memBuffer))
             {
                 return STATUS(Status::HOST_BUFFER_ACCESS_ERROR, HostBufferAccessSubcodes::NXM, 0);
             }
   
-            if (!memcmp(diskBuffer.get(), memBuffer.get(), params->ByteCount))
+            if (!memcmp(diskBuffer, memBuffer, params->ByteCount))
             {
                 return STATUS(Status::COMPARE_ERROR, 0, 0);
             }
@@ -1013,40 +1782,52 @@ mscp_server::DoDiskTransfer(
  
         case Opcodes::ERASE:
         {
-            std::unique_ptr<uint8_t> memBuffer(new uint8_t[params->ByteCount]);
-            memset(reinterpret_cast<void*>(memBuffer.get()), 0, params->ByteCount);
+            uint8_t* memBuffer = unit->hostBuffer.Get(params->ByteCount);
+            memset(reinterpret_cast<void*>(memBuffer), 0, params->ByteCount);
 
             if (rctAccess)
             {
                 drive->WriteRCTBlock(rctBlockNumber,
-                    memBuffer.get());
+                    memBuffer);
             }
             else
             {
                 drive->Write(params->LBN,
                     params->ByteCount,
-                    memBuffer.get());
+                    memBuffer);
             }
         } 
         break;
 
         case Opcodes::READ:
         {
-            std::unique_ptr<uint8_t> diskBuffer;
+            uint8_t* data = GetStagedRead(unitNumber, params->LBN, params->ByteCount);
+
+            if (!rctAccess && nullptr == data && params->ByteCount > SLICE_BYTES)
+            {
+                if (!DoSlicedRead(unit, drive, params->LBN, params->ByteCount,
+                        params->BufferPhysicalAddress & 0x00ffffff))
+                {
+                    return STATUS(Status::HOST_BUFFER_ACCESS_ERROR, HostBufferAccessSubcodes::NXM, 0);
+                }
+                break;
+            }
         
             if (rctAccess)
             {
-                diskBuffer.reset(drive->ReadRCTBlock(rctBlockNumber));
+                data = unit->diskBuffer.Get(params->ByteCount);
+                drive->ReadRCTBlock(rctBlockNumber, data);
             }
-            else
+            else if (nullptr == data)
             { 
-                diskBuffer.reset(drive->Read(params->LBN, params->ByteCount));
+                data = unit->diskBuffer.Get(params->ByteCount);
+                drive->Read(params->LBN, params->ByteCount, data);
             }
 
             if (!_port->DMAWrite(
                 params->BufferPhysicalAddress & 0x00ffffff,
                 params->ByteCount,
-                diskBuffer.get()))
+                data))
             {
                 return STATUS(Status::HOST_BUFFER_ACCESS_ERROR, HostBufferAccessSubcodes::NXM, 0);
             }
@@ -1056,12 +1837,22 @@ mscp_server::DoDiskTransfer(
 
         case Opcodes::WRITE:
         {
-            std::unique_ptr<uint8_t> memBuffer(_port->DMARead(
+            if (!rctAccess && params->ByteCount > SLICE_BYTES)
+            {
+                if (!DoSlicedWrite(unit, drive, params->LBN, params->ByteCount,
+                        params->BufferPhysicalAddress & 0x00ffffff))
+                {
+                    return STATUS(Status::HOST_BUFFER_ACCESS_ERROR, HostBufferAccessSubcodes::NXM, 0);
+                }
+                break;
+            }
+
+            uint8_t* memBuffer = unit->hostBuffer.Get(params->ByteCount);
+
+            if (!_port->DMARead(
                 params->BufferPhysicalAddress & 0x00ffffff,
                 params->ByteCount,
-                params->ByteCount));
-
-            if (!memBuffer)
+                memBuffer))
             {
                 return STATUS(Status::HOST_BUFFER_ACCESS_ERROR, HostBufferAccessSubcodes::NXM, 0);
             }
@@ -1069,13 +1860,13 @@ mscp_server::DoDiskTransfer(
             if (rctAccess)
             {
                 drive->WriteRCTBlock(rctBlockNumber,
-                    memBuffer.get());
+                    memBuffer);
             }
             else
             {
                 drive->Write(params->LBN,
                     params->ByteCount,
-                    memBuffer.get());
+                    memBuffer);
             }
         }
         break;
@@ -1101,7 +1892,7 @@ mscp_server::DoDiskTransfer(
 //
 uint8_t*
 mscp_server::GetParameterPointer(
-    std::shared_ptr<Message> message)
+    Message* message)
 {
     // We silence a strict aliasing warning here; this is safe (if perhaps not recommended
     // the general case.)
@@ -1154,6 +1945,9 @@ mscp_server::Reset(void)
     }  
     pthread_mutex_unlock(&polling_mutex);
 
+    // The polling thread is idle now, so no new unit commands arrive.
+    AbortUnitCommands();
+
     _credits = INIT_CREDITS;
 
     // Release all drives
@@ -9,10 +9,24 @@
 
 #include <stdint.h>
 #include <memory>
+#include <deque>
+#include <queue>
+#include <vector>
 
 class uda_c;
 class Message;
 class mscp_drive_c;
+class MessagePool;
+
+// Deleter for MessageHandle: returns the Message to its pool (see uda.hpp)
+struct MessageReleaser
+{
+    MessagePool* pool;
+    void operator()(Message* message) const;
+};
+
+// Owns a command message from GetNextCommand() until its response is posted
+typedef std::unique_ptr<Message, MessageReleaser> MessageHandle;
 
 // Builds a uint32_t containing the status, flags, and endcode for a response message,
 // used to simplify returning the appropriate status bits from command functions.
@@ -31,6 +45,13 @@ class mscp_drive_c;
 
 #define HEADER_OFFSET 4
 
+// Upper limit for adjacent READs merged into one image read
+#define MAX_MERGED_READ_BYTES 0x10000
+
+// READ and WRITE longer than this are streamed through two slice buffers,
+// overlapping image I/O with bus DMA.  Multiple of all block sizes.
+#define SLICE_BYTES 0x1000
+
 //
 // ControlMessageHeader encapsulates the standard MSCP control
 // message header: a 12-byte header followed by up to 36 bytes of
@@ -169,6 +190,7 @@ public:
     void Reset(void);
     void InitPolling(void);
     void Poll(void);
+    void UnitPoll(uint32_t unitNumber);
 
 public:
     void on_power_changed(signal_edge_enum aclo_edge, signal_edge_enum dclo_edge) override {
@@ -179,32 +201,40 @@ public:
 
 private:
     uint32_t Abort(void);
-    uint32_t Access(std::shared_ptr<Message> message, uint16_t unitNumber);
+    uint32_t Access(Message* message, uint16_t unitNumber);
     uint32_t Available(uint16_t unitNumber, uint16_t modifiers);
-    uint32_t CompareHostData(std::shared_ptr<Message> message, uint16_t unitNumber);
+    uint32_t CompareHostData(Message* message, uint16_t unitNumber);
     uint32_t DetermineAccessPaths(uint16_t unitNumber);
-    uint32_t Erase(std::shared_ptr<Message> message, uint16_t unitNumber, uint16_t modifiers);
-    uint32_t GetCommandStatus(std::shared_ptr<Message> message);
-    uint32_t GetUnitStatus(std::shared_ptr<Message> message, uint16_t unitNumber, uint16_t modifiers);
-    uint32_t Online(std::shared_ptr<Message> message, uint16_t unitNumber, uint16_t modifiers);
-    uint32_t SetControllerCharacteristics(std::shared_ptr<Message> message);
-    uint32_t SetUnitCharacteristics(std::shared_ptr<Message> message, uint16_t unitNumber, uint16_t modifiers);
-    uint32_t Read(std::shared_ptr<Message> message, uint16_t unitNumber, uint16_t modifiers);
-    uint32_t Replace(std::shared_ptr<Message> message, uint16_t unitNumber);
-    uint32_t Write(std::shared_ptr<Message> message, uint16_t unitNumber, uint16_t modifiers);
+    uint32_t Erase(Message* message, uint16_t unitNumber, uint16_t modifiers);
+    uint32_t GetCommandStatus(Message* message);
+    uint32_t GetUnitStatus(Message* message, uint16_t unitNumber, uint16_t modifiers);
+    uint32_t Online(Message* message, uint16_t unitNumber, uint16_t modifiers);
+    uint32_t SetControllerCharacteristics(Message* message);
+    uint32_t SetUnitCharacteristics(Message* message, uint16_t unitNumber, uint16_t modifiers);
+    uint32_t Read(Message* message, uint16_t unitNumber, uint16_t modifiers);
+    uint32_t Replace(Message* message, uint16_t unitNumber);
+    uint32_t Write(Message* message, uint16_t unitNumber, uint16_t modifiers);
 
     uint32_t SetUnitCharacteristicsInternal(
-        std::shared_ptr<Message> message,
+        Message* message,
         uint16_t unitNumber,
         uint16_t modifiers,
         bool bringOnline);
-    uint32_t DoDiskTransfer(uint16_t operation, std::shared_ptr<Message> message, uint16_t unitNumber, uint16_t modifiers);
-    uint8_t* GetParameterPointer(std::shared_ptr<Message> message);
+    uint32_t ExecuteCommand(Message* message, bool& protocolError);
+    void PostCompletion(Message* message, uint32_t cmdStatus, bool protocolError);
+    bool IsUnitCommand(Message* message);
+    void QueueUnitCommand(MessageHandle message);
+    void AbortUnitCommands(void);
+
+    uint32_t DoDiskTransfer(uint16_t operation, Message* message, uint16_t unitNumber, uint16_t modifiers);
+    uint8_t* GetParameterPointer(Message* message);
     mscp_drive_c* GetDrive(uint32_t unitNumber);
 
 private:
     void StartPollingThread(void);
     void AbortPollingThread(void);
+    void StartUnitThreads(void);
+    void AbortUnitThreads(void);
 
 private:
     uint32_t _hostTimeout;
@@ -228,6 +258,71 @@ private:
     pthread_cond_t polling_cond;
     pthread_mutex_t polling_mutex;
 
+    //
+    // Per-unit command queues.  Commands addressed to a unit are
+    // executed in ring order by that unit's thread, so transfers on
+    // different units proceed in parallel and complete out of order.
+    // With the port's "seek_optimize" the unit's transfers are
+    // reordered by LBN, see TakeUnitCommands().
+    //
+    // Data buffer of a unit thread, grown on demand
+    struct UnitBuffer
+    {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size;
+
+        UnitBuffer() : size(0) {}
+        uint8_t* Get(size_t length);
+    };
+
+    struct UnitQueue
+    {
+        mscp_server* server;
+        uint32_t unitNumber;
+        pthread_t pthread;
+        pthread_cond_t cond;
+        std::deque<MessageHandle> messages;
+        bool busy;      // a command has been dequeued and not yet posted
+        // Reference numbers of the dequeued commands not yet executed,
+        // in execution order.  For GET COMMAND STATUS.
+        std::deque<uint32_t> busyReferences;
+
+        // seek_optimize: LBN following the last transfer, for C-SCAN
+        uint32_t headLBN;
+
+        // Transfer buffers, reused: image side and host memory side
+        UnitBuffer diskBuffer;
+        UnitBuffer hostBuffer;
+
+        // Two SLICE_BYTES buffers for sliced transfers, allocated on first use
+        uint8_t* sliceBuffers;
+        bool sliceBuffersDDR;   // in shared DDR: PRU DMA without copy
+
+        // seek_optimize: one image read serving several merged READs
+        uint32_t stagedLBN;
+        uint32_t stagedByteCount;   // 0: nothing staged
+        UnitBuffer stagedBuffer;
+    };
+
+    void TakeUnitCommands(UnitQueue* unit, std::vector<MessageHandle>& batch);
+    bool IsEligibleUnitCommand(UnitQueue* unit, size_t index);
+    void StageMergedRead(UnitQueue* unit, std::vector<MessageHandle>& batch);
+    uint8_t* GetStagedRead(uint16_t unitNumber, uint32_t lbn, uint32_t byteCount);
+    uint8_t* GetSliceBuffers(UnitQueue* unit);
+    bool DoSlicedRead(UnitQueue* unit, mscp_drive_c* drive, uint32_t lbn, uint32_t byteCount, uint32_t address);
+    bool DoSlicedWrite(UnitQueue* unit, mscp_drive_c* drive, uint32_t lbn, uint32_t byteCount, uint32_t address);
+
+    friend void* unit_worker(void *context);
+
+    std::vector<std::unique_ptr<UnitQueue>> _units;
+    bool _abort_units;
+    bool _units_aborting;   // Reset() in progress: drop completed commands
+    pthread_mutex_t unit_mutex;     // protects all UnitQueues
+    pthread_cond_t units_idle_cond;
+
+    // Serializes credits and PostResponse() between the polling and unit threads
+    pthread_mutex_t response_mutex;
+
     // Credits available
     uint8_t _credits;
 };
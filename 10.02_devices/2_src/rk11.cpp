@@ -12,6 +12,7 @@
 
 #include "logger.hpp"
 #include "qunibus.h"
+#include "ddrmem.h"
 #include "qunibusadapter.hpp"
 #include "qunibusdevice.hpp"
 #include "storagecontroller.hpp"
@@ -289,8 +290,19 @@ void rk11_c::worker(unsigned instance)
                             // and submit DMA requests one at a time, waiting for
                             // their completion. 
                           
-                            uint16_t sectorBuffer[256];
                             uint16_t checkBuffer[256];
+
+                            // Sector and read-ahead buffer live in shared DDR if possible,
+                            // so the PRU DMAs them without copy through the mailbox.
+                            uint16_t localBuffers[2 * 256];
+                            uint16_t* ddrBuffers = ddrmem->dma_buffer_alloc(2 * 256);
+                            uint16_t* sectorBuffer = ddrBuffers ? ddrBuffers : localBuffers;
+
+                            // Normal reads overlap the DMA of one sector with the
+                            // disk read of the next one into aheadBuffer.
+                            uint16_t* aheadBuffer = sectorBuffer + 256;
+                            bool ahead_valid = false;
+                            uint16_t ahead_cyl = 0, ahead_surface = 0, ahead_sector = 0;
  
                             uint32_t current_address = command.address;
                             int16_t current_count = -(int16_t)(get_register_dato_value(RKWC_reg));
@@ -325,17 +337,29 @@ void rk11_c::worker(unsigned instance)
                                 // Clear the buffer.  This is only necessary because short writes
                                 // and reads expect the rest of the sector to be filled with zeroes.
                                 //
-                                memset(sectorBuffer, 0, sizeof(sectorBuffer));
+                                memset(sectorBuffer, 0, 256 * sizeof(uint16_t));
                                 
                                 if (read)
                                 {
                                     // Doing a normal read from disk:  Grab the sector data and then
                                     // DMA it into memory.
-                                    selected_drive()->read_sector(
-                                        _rkda_cyl,
-                                        _rkda_surface,
-                                        _rkda_sector,
-                                        sectorBuffer);
+                                    if (ahead_valid
+                                            && ahead_cyl == _rkda_cyl
+                                            && ahead_surface == _rkda_surface
+                                            && ahead_sector == _rkda_sector)
+                                    {
+                                        // already read while previous sector was DMA'd
+                                        memcpy(sectorBuffer, aheadBuffer, 256 * sizeof(uint16_t));
+                                    }
+                                    else
+                                    {
+                                        selected_drive()->read_sector(
+                                            _rkda_cyl,
+                                            _rkda_surface,
+                                            _rkda_sector,
+                                            sectorBuffer);
+                                    }
+                                    ahead_valid = false;
                                 }
                                 else if (read_format)
                                 {
@@ -375,7 +399,27 @@ void rk11_c::worker(unsigned instance)
                                 request.iba = command.iba;
 
                                 // And actually do the transfer.   
-                                dma_transfer(request);
+                                if (read && !command.iba)
+                                {
+                                    // Start the DMA, read the next sector from the image
+                                    // while the PRU transfers, then wait for the DMA.
+                                    qunibusadapter->DMA_submit(dma_request,
+                                        QUNIBUS_CYCLE_DATO,
+                                        request.address,
+                                        request.buffer,
+                                        request.count);
+                                    if (current_count > request.count && !_new_command_ready)
+                                    {
+                                        ahead_valid = read_ahead_sector(aheadBuffer,
+                                            &ahead_cyl, &ahead_surface, &ahead_sector);
+                                    }
+                                    qunibusadapter->DMA_wait(dma_request);
+                                    request.timeout = !dma_request.success;
+                                }
+                                else
+                                {
+                                    dma_transfer(request);
+                                }
 
                                 // Check completion status -- if there was an error,
                                 // we'll abort and set the appropriate flags.
@@ -465,6 +509,11 @@ void rk11_c::worker(unsigned instance)
                                 // And go around, do it again. 
                             }
 
+                            if (ddrBuffers)
+                            {
+                                ddrmem->dma_buffer_free(ddrBuffers);
+                            }
+
                             // timeout.wait_us(100);
                             DEBUG_FAST("R/W: Complete.");
                             _worker_state = Worker_Finish;
@@ -859,6 +908,33 @@ bool rk11_c::check_drive_ready(void)
    }
 }
 
+bool rk11_c::read_ahead_sector(uint16_t *buffer, uint16_t *cyl, uint16_t *surface, uint16_t *sector)
+{
+    // same sequence as increment_RKDA()
+    *sector = _rkda_sector + 1;
+    *surface = _rkda_surface;
+    *cyl = _rkda_cyl;
+    if (*sector > 11)
+    {
+        *sector = 0;
+        (*surface)++;
+        if (*surface > 1)
+        {
+            *surface = 0;
+            (*cyl)++;
+        }
+    }
+
+    // invalid addresses are flagged by validate_seek() when reached
+    if (*cyl > 202 || !check_drive_present())
+    {
+        return false;
+    }
+
+    selected_drive()->read_sector(*cyl, *surface, *sector, buffer);
+    return true;
+}
+
 bool rk11_c::check_drive_present(void)
 {
     return (selected_drive()->get_drive_ready());  
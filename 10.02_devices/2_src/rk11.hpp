@@ -114,6 +114,10 @@ private:
     // Increments RKDA to point to the next sector
     void increment_RKDA(void);
 
+    // Reads the sector following RKDA into the given buffer, without changing
+    // registers or error state. Returns false if there is no valid next sector.
+    bool read_ahead_sector(uint16_t *buffer, uint16_t *cyl, uint16_t *surface, uint16_t *sector);
+
     // Causes an interrupt if IDE is set
     void invoke_interrupt(void);
 
@@ -0,0 +1,530 @@
+/* storagecache.cpp: LRU write-back block cache for storage drive images
+
+ Copyright (c) 2026, QUniBone contributors
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ Images on SD card are slow, and the emulated drives access them sector by sector.
+ The cache holds the recently used blocks of all drive images in RAM,
+ so boot, directory and swap traffic does not go to the card each time.
+ */
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+#include "logger.hpp"
+#include "utils.hpp"
+#include "timeout.hpp"
+#include "storageimage.hpp"
+#include "storagecache.hpp"
+
+storagecache_c *storagecache; // Singleton
+
+// blocks loaded by read-ahead in one image access
+#define STORAGECACHE_PREFETCH_CHUNK_BLOCKS	8
+// pending read-ahead requests
+#define STORAGECACHE_PREFETCH_QUEUE_SIZE	16
+
+storagecache_c::storagecache_c() :
+    device_c()
+{
+    // static config
+    name.value = "CACHE";
+    type_name.value = "storagecache_c";
+    log_label = "cache";
+
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&prefetch_cond, NULL);
+    pthread_cond_init(&io_cond, NULL);
+
+    block_count.value = 1024 ; // 4 MB
+    flush_interval.value = 1000 ;
+    readahead.value = true ;
+    resize(block_count.value) ;
+}
+
+storagecache_c::~storagecache_c()
+{
+    pthread_mutex_lock(&mutex);
+    resize(0) ; // saves dirty blocks
+    for (auto &image_mutex : image_mutexes)
+        pthread_mutex_destroy(&image_mutex.second);
+    image_mutexes.clear() ;
+    pthread_mutex_unlock(&mutex);
+    pthread_cond_destroy(&io_cond);
+    pthread_cond_destroy(&prefetch_cond);
+    pthread_mutex_destroy(&mutex);
+}
+
+bool storagecache_c::on_param_changed(parameter_c *param)
+{
+    if (param == &block_count) {
+        pthread_mutex_lock(&mutex);
+        resize(block_count.new_value) ;
+        pthread_mutex_unlock(&mutex);
+    } else if (param == &flush_interval) {
+        if (flush_interval.new_value == 0)
+            return false ;
+    } else if (param == &enabled && !enabled.new_value) {
+        // wake worker waiting for read-ahead, so it stops in time
+        pthread_mutex_lock(&mutex);
+        workers_terminate = true ;
+        pthread_cond_signal(&prefetch_cond);
+        pthread_mutex_unlock(&mutex);
+        // bypassed from now on: images must be up to date
+        invalidate(nullptr, /*save_dirty*/true) ;
+    } else if (param == &readahead && !readahead.new_value) {
+        pthread_mutex_lock(&mutex);
+        prefetch_queue.clear() ;
+        pthread_mutex_unlock(&mutex);
+    }
+    return device_c::on_param_changed(param);
+}
+
+// not on the bus, storage controllers forward their power and INIT events.
+// Power fail: cached writes must reach the images.
+void storagecache_c::on_power_changed(signal_edge_enum aclo_edge, signal_edge_enum dclo_edge)
+{
+    if (aclo_edge == SIGNAL_EDGE_RAISING || dclo_edge == SIGNAL_EDGE_RAISING)
+        flush(nullptr) ;
+}
+
+void storagecache_c::on_init_changed(void)
+{
+    if (init_asserted)
+        flush(nullptr) ;
+}
+
+/* Loads read-ahead blocks and saves dirty blocks periodically.
+ * Read-ahead is done in chunks, the mutex is released while the image is read.
+ */
+void storagecache_c::worker(unsigned instance)
+{
+    UNUSED(instance) ; // only one
+    timeout_c flush_timeout;
+
+    flush_timeout.start_ms(flush_interval.value);
+    pthread_mutex_lock(&mutex);
+    while (!workers_terminate) {
+        if (flush_timeout.reached()) {
+            flush_locked(nullptr) ;
+            flush_timeout.start_ms(flush_interval.value);
+        }
+        if (!prefetch_step()) {
+            uint64_t elapsed_ms = flush_timeout.elapsed_ms() ;
+            unsigned wait_ms = elapsed_ms < flush_interval.value ? flush_interval.value - elapsed_ms : 0 ;
+            struct timespec deadline = timespec_future_us(wait_ms * 1000) ;
+            pthread_cond_timedwait(&prefetch_cond, &mutex, &deadline) ;
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+// reallocate all blocks, saving dirty ones before.
+// mutex must be held
+void storagecache_c::resize(unsigned new_block_count)
+{
+    wait_idle(nullptr, /*save_dirty*/true) ;
+    block_map.clear() ;
+    lru.clear() ;
+    blocks.clear() ;
+    block_data.clear() ;
+    block_data.shrink_to_fit() ;
+
+    blocks.resize(new_block_count) ;
+    block_data.resize((size_t)new_block_count * STORAGECACHE_BLOCK_SIZE) ;
+    for (unsigned i = 0; i < new_block_count; i++) {
+        block_c *block = &blocks[i] ;
+        block->image = nullptr ;
+        block->block_number = 0 ;
+        block->dirty_start = block->dirty_end = 0 ;
+        block->io_busy = false ;
+        block->data = &block_data[(size_t)i * STORAGECACHE_BLOCK_SIZE] ;
+        block->lru_pos = lru.insert(lru.end(), block) ;
+    }
+}
+
+storagecache_c::block_c *storagecache_c::lookup(storageimage_base_c *image, uint64_t block_number)
+{
+    auto it = block_map.find(block_key_c { image, block_number }) ;
+    if (it == block_map.end())
+        return nullptr ;
+    return it->second ;
+}
+
+/* get the least recently used block which is not in I/O, for reuse.
+ * A dirty one is saved first, this releases the mutex.
+ * Result is clean and unused, nullptr if all blocks are in I/O.
+ */
+storagecache_c::block_c *storagecache_c::reclaim(void)
+{
+    for (;;) {
+        block_c *block = nullptr ;
+        for (auto it = lru.rbegin(); it != lru.rend(); ++it)
+            if (!(*it)->io_busy) {
+                block = *it ;
+                break ;
+            }
+        if (block == nullptr)
+            return nullptr ;
+        if (block->dirty_end == 0) {
+            if (block->image != nullptr)
+                drop(block) ;
+            return block ;
+        }
+        write_back(block) ; // other threads may have changed the LRU order
+    }
+}
+
+// use unused block for image/block_number, content is undefined
+void storagecache_c::assign(block_c *block, storageimage_base_c *image, uint64_t block_number)
+{
+    block->image = image ;
+    block->block_number = block_number ;
+    block_map[block_key_c { image, block_number }] = block ;
+    lru.splice(lru.begin(), lru, block->lru_pos) ;
+}
+
+/* load missing blocks starting at block_number with one image access,
+ * up to max_count, or the first block already cached.
+ * mutex must be held, it is released while the image is read.
+ * Result: number of blocks loaded, 0 if all blocks are in I/O.
+ */
+unsigned storagecache_c::load(storageimage_base_c *image, uint64_t block_number, unsigned max_count,
+                              std::vector<uint8_t> &buffer)
+{
+    std::vector<block_c *> run ;
+    while (run.size() < max_count && lookup(image, block_number + run.size()) == nullptr) {
+        block_c *block = reclaim() ;
+        if (block == nullptr)
+            break ;
+        // reclaim() may have released the mutex
+        if (lookup(image, block_number + run.size()) != nullptr)
+            break ;
+        assign(block, image, block_number + run.size()) ;
+        block->io_busy = true ;
+        run.push_back(block) ;
+    }
+    if (run.empty())
+        return 0 ;
+
+    buffer.resize(run.size() * STORAGECACHE_BLOCK_SIZE) ;
+    image_io(image, /*write*/false, buffer.data(), block_number * STORAGECACHE_BLOCK_SIZE, buffer.size()) ;
+    for (unsigned i = 0; i < run.size(); i++) {
+        memcpy(run[i]->data, &buffer[(size_t)i * STORAGECACHE_BLOCK_SIZE], STORAGECACHE_BLOCK_SIZE) ;
+        run[i]->io_busy = false ;
+    }
+    pthread_cond_broadcast(&io_cond);
+    return run.size() ;
+}
+
+/* read or write image without holding the mutex.
+ * mutex must be held, the caller has marked the blocks concerned io_busy,
+ * so the image and its lock stay valid.
+ */
+void storagecache_c::image_io(storageimage_base_c *image, bool write, uint8_t *buffer, uint64_t position, unsigned len)
+{
+    auto it = image_mutexes.find(image) ;
+    if (it == image_mutexes.end()) {
+        it = image_mutexes.emplace(image, pthread_mutex_t()).first ;
+        pthread_mutex_init(&it->second, NULL);
+    }
+    pthread_mutex_t *image_mutex = &it->second ;
+
+    pthread_mutex_unlock(&mutex);
+    pthread_mutex_lock(image_mutex);
+    if (write)
+        image->write(buffer, position, len) ;
+    else
+        image->read(buffer, position, len) ;
+    pthread_mutex_unlock(image_mutex);
+    pthread_mutex_lock(&mutex);
+}
+
+// save written bytes of block to its image.
+// mutex must be held, it is released while the image is written.
+void storagecache_c::write_back(block_c *block)
+{
+    if (block->dirty_end == 0)
+        return ;
+    block->io_busy = true ; // data not changed while saved
+    image_io(block->image, /*write*/true, block->data + block->dirty_start,
+             block->block_number * STORAGECACHE_BLOCK_SIZE + block->dirty_start,
+             block->dirty_end - block->dirty_start) ;
+    block->dirty_start = block->dirty_end = 0 ;
+    block->io_busy = false ;
+    pthread_cond_broadcast(&io_cond);
+    writebacks.value++ ;
+}
+
+// forget block, it becomes the next to be reused
+void storagecache_c::drop(block_c *block)
+{
+    block_map.erase(block_key_c { block->image, block->block_number }) ;
+    block->image = nullptr ;
+    block->dirty_start = block->dirty_end = 0 ;
+    lru.splice(lru.end(), lru, block->lru_pos) ;
+}
+
+// save dirty blocks in image order, mutex must be held
+void storagecache_c::flush_locked(storageimage_base_c *image)
+{
+    std::vector<block_c *> dirty_blocks ;
+    for (auto &block : blocks)
+        if (block.dirty_end != 0 && (image == nullptr || block.image == image))
+            dirty_blocks.push_back(&block) ;
+    std::sort(dirty_blocks.begin(), dirty_blocks.end(), [](block_c *a, block_c *b) {
+        if (a->image != b->image)
+            return a->image < b->image ;
+        return a->block_number < b->block_number ;
+    }) ;
+    for (auto block : dirty_blocks) {
+        // mutex was released by previous write_back()
+        while (block->io_busy)
+            pthread_cond_wait(&io_cond, &mutex);
+        if (image == nullptr || block->image == image)
+            write_back(block) ;
+    }
+}
+
+/* wait until no block of image (all images if nullptr) is in I/O,
+ * and if save_dirty, none is dirty.
+ * mutex must be held.
+ */
+void storagecache_c::wait_idle(storageimage_base_c *image, bool save_dirty)
+{
+    for (;;) {
+        bool busy = false ;
+        bool dirty = false ;
+        for (auto &block : blocks)
+            if (block.image != nullptr && (image == nullptr || block.image == image)) {
+                busy |= block.io_busy ;
+                dirty |= block.dirty_end != 0 ;
+            }
+        if (busy)
+            pthread_cond_wait(&io_cond, &mutex);
+        else if (save_dirty && dirty)
+            flush_locked(image) ;
+        else
+            return ;
+    }
+}
+
+void storagecache_c::flush(storageimage_base_c *image)
+{
+    pthread_mutex_lock(&mutex);
+    flush_locked(image) ;
+    pthread_mutex_unlock(&mutex);
+}
+
+// remove blocks of image (all, if nullptr)
+void storagecache_c::invalidate(storageimage_base_c *image, bool save_dirty)
+{
+    pthread_mutex_lock(&mutex);
+    // the image may be deleted after return: cancel its read-ahead
+    prefetch_queue.erase(std::remove_if(prefetch_queue.begin(), prefetch_queue.end(),
+    [image](const prefetch_request_c &request) {
+        return image == nullptr || request.image == image ;
+    }), prefetch_queue.end()) ;
+    wait_idle(image, save_dirty) ;
+    for (auto &block : blocks)
+        if (block.image != nullptr && (image == nullptr || block.image == image))
+            drop(&block) ;
+    // no I/O on image pending now
+    for (auto it = image_mutexes.begin(); it != image_mutexes.end(); )
+        if (image == nullptr || it->first == image) {
+            pthread_mutex_destroy(&it->second);
+            it = image_mutexes.erase(it) ;
+        } else
+            ++it ;
+    pthread_mutex_unlock(&mutex);
+}
+
+/* queue read-ahead of "len" bytes at "position" for the worker.
+ * Requests continuing a pending one of the same image are merged.
+ * Read-ahead is limited to a quarter of the cache, so it does not
+ * displace all other blocks.
+ */
+void storagecache_c::prefetch(storageimage_base_c *image, uint64_t position, uint64_t len)
+{
+    pthread_mutex_lock(&mutex);
+    if (!enabled.value || !readahead.value || blocks.empty() || !image->is_cacheable()) {
+        pthread_mutex_unlock(&mutex);
+        return ;
+    }
+    len = std::min(len, (uint64_t)(blocks.size() / 4) * STORAGECACHE_BLOCK_SIZE) ;
+    uint64_t end = position + len ;
+    bool merged = false ;
+    for (auto &request : prefetch_queue)
+        if (request.image == image && position >= request.position && position <= request.end) {
+            request.end = std::max(request.end, end) ;
+            merged = true ;
+            break ;
+        }
+    if (!merged && len > 0 && prefetch_queue.size() < STORAGECACHE_PREFETCH_QUEUE_SIZE) {
+        prefetch_queue.push_back(prefetch_request_c { image, position, end }) ;
+        pthread_cond_signal(&prefetch_cond);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+/* load next chunk of the oldest read-ahead request.
+ * Blocks already in the cache are skipped.
+ * mutex must be held, it is released while the image is read.
+ * Result: false if nothing to do.
+ */
+bool storagecache_c::prefetch_step(void)
+{
+    if (prefetch_queue.empty())
+        return false ;
+    // copy: queue may change while the image is read
+    prefetch_request_c request = prefetch_queue.front() ;
+    uint64_t block_number = request.position / STORAGECACHE_BLOCK_SIZE ;
+    uint64_t end_block_number = (request.end + STORAGECACHE_BLOCK_SIZE - 1) / STORAGECACHE_BLOCK_SIZE ;
+    while (block_number < end_block_number && lookup(request.image, block_number) != nullptr)
+        block_number++ ;
+    unsigned run = 0 ;
+    if (block_number < end_block_number) {
+        run = load(request.image, block_number,
+                   std::min(end_block_number - block_number, (uint64_t)STORAGECACHE_PREFETCH_CHUNK_BLOCKS),
+                   prefetch_buffer) ;
+        if (run == 0) {
+            // all blocks in I/O, try again later
+            pthread_cond_wait(&io_cond, &mutex);
+            return true ;
+        }
+        prefetched.value += run ;
+    }
+    // request may have been merged, canceled or completed meanwhile
+    if (!prefetch_queue.empty() && prefetch_queue.front().image == request.image
+            && prefetch_queue.front().position == request.position) {
+        prefetch_request_c &front = prefetch_queue.front() ;
+        front.position = (block_number + run) * STORAGECACHE_BLOCK_SIZE ;
+        if (front.position >= front.end)
+            prefetch_queue.pop_front() ;
+    }
+    return true ;
+}
+
+/* read "len" bytes at "position" of image.
+ * Missing blocks in a row are loaded with one image access.
+ */
+void storagecache_c::read(storageimage_base_c *image, uint8_t *buffer, uint64_t position, unsigned len)
+{
+    pthread_mutex_lock(&mutex);
+    if (!enabled.value || blocks.empty() || !image->is_cacheable()) {
+        pthread_mutex_unlock(&mutex);
+        image->read(buffer, position, len) ;
+        return ;
+    }
+
+    uint64_t end = position + len ;
+    uint64_t last_block_number = (end - 1) / STORAGECACHE_BLOCK_SIZE ;
+    uint64_t loaded_end = 0 ; // blocks just loaded are no hits
+    std::vector<uint8_t> run_buffer ;
+    while (position < end) {
+        uint64_t block_number = position / STORAGECACHE_BLOCK_SIZE ;
+        unsigned offset = position % STORAGECACHE_BLOCK_SIZE ;
+        unsigned chunk = std::min((uint64_t)(STORAGECACHE_BLOCK_SIZE - offset), end - position) ;
+        block_c *block = lookup(image, block_number) ;
+        if (block != nullptr && block->io_busy) {
+            pthread_cond_wait(&io_cond, &mutex);
+            continue ;
+        }
+        if (block == nullptr) {
+            // run of missing blocks, at most half of the cache
+            uint64_t max_run = std::min(last_block_number - block_number + 1, (uint64_t)blocks.size() / 2) ;
+            unsigned run = load(image, block_number, std::max(max_run, (uint64_t)1), run_buffer) ;
+            if (run == 0)
+                pthread_cond_wait(&io_cond, &mutex); // all blocks in I/O
+            misses.value += run ;
+            loaded_end = block_number + run ;
+            continue ; // lookup again
+        }
+        if (block_number >= loaded_end)
+            hits.value++ ;
+        lru.splice(lru.begin(), lru, block->lru_pos) ;
+        memcpy(buffer, block->data + offset, chunk) ;
+        buffer += chunk ;
+        position += chunk ;
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+/* write "len" bytes to "position" of image.
+ * Data is saved later. Partially written blocks are loaded first.
+ */
+void storagecache_c::write(storageimage_base_c *image, uint8_t *buffer, uint64_t position, unsigned len)
+{
+    pthread_mutex_lock(&mutex);
+    if (!enabled.value || blocks.empty() || !image->is_cacheable()) {
+        pthread_mutex_unlock(&mutex);
+        image->write(buffer, position, len) ;
+        return ;
+    }
+
+    uint64_t end = position + len ;
+    uint64_t loaded_end = 0 ; // blocks just loaded are no hits
+    std::vector<uint8_t> load_buffer ;
+    while (position < end) {
+        uint64_t block_number = position / STORAGECACHE_BLOCK_SIZE ;
+        unsigned offset = position % STORAGECACHE_BLOCK_SIZE ;
+        unsigned chunk = std::min((uint64_t)(STORAGECACHE_BLOCK_SIZE - offset), end - position) ;
+        block_c *block = lookup(image, block_number) ;
+        if (block != nullptr && block->io_busy) {
+            pthread_cond_wait(&io_cond, &mutex);
+            continue ;
+        }
+        if (block == nullptr && chunk < STORAGECACHE_BLOCK_SIZE) {
+            // partially written: load rest of block
+            unsigned run = load(image, block_number, 1, load_buffer) ;
+            if (run == 0)
+                pthread_cond_wait(&io_cond, &mutex); // all blocks in I/O
+            misses.value += run ;
+            loaded_end = block_number + run ;
+            continue ; // lookup again
+        }
+        if (block == nullptr) {
+            block = reclaim() ;
+            if (block == nullptr) {
+                pthread_cond_wait(&io_cond, &mutex); // all blocks in I/O
+                continue ;
+            }
+            // reclaim() may have released the mutex
+            if (lookup(image, block_number) != nullptr)
+                continue ;
+            assign(block, image, block_number) ;
+            misses.value++ ;
+        } else {
+            if (block_number >= loaded_end)
+                hits.value++ ;
+            lru.splice(lru.begin(), lru, block->lru_pos) ;
+        }
+        memcpy(block->data + offset, buffer, chunk) ;
+        if (block->dirty_end == 0) {
+            block->dirty_start = offset ;
+            block->dirty_end = offset + chunk ;
+        } else {
+            block->dirty_start = std::min(block->dirty_start, offset) ;
+            block->dirty_end = std::max(block->dirty_end, offset + chunk) ;
+        }
+        buffer += chunk ;
+        position += chunk ;
+    }
+    pthread_mutex_unlock(&mutex);
+}
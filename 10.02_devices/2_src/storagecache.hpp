@@ -0,0 +1,156 @@
+/* storagecache.hpp: LRU write-back block cache for storage drive images
+
+ Copyright (c) 2026, QUniBone contributors
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _STORAGECACHE_HPP_
+#define _STORAGECACHE_HPP_
+
+#include <stdint.h>
+#include <inttypes.h> // PRI* formats
+#include <pthread.h>
+#include <list>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+
+#include "device.hpp"
+#include "parameter.hpp"
+
+class storageimage_base_c ;
+
+// bytes per cache block. Multiple of all sector sizes
+#define STORAGECACHE_BLOCK_SIZE	4096
+
+/* One cache for the images of all storage drives.
+ * Blocks are looked up by image and block number, replaced in LRU order.
+ * Writes are kept in the cache ("dirty") until the block is replaced,
+ * the periodic flush of worker() runs, or on INIT or power down
+ * (forwarded by the storage controllers).
+ * Only images which declare themselves as cacheable are buffered,
+ * all others are accessed directly.
+ * Drives reading sequentially request read-ahead with prefetch(),
+ * the worker loads these blocks while the drive is still busy with the current ones.
+ */
+class storagecache_c: public device_c {
+private:
+    struct block_c {
+        storageimage_base_c *image ; // nullptr: unused
+        uint64_t	block_number ;
+        // range of bytes written, but not yet saved. dirty_end == 0: clean
+        unsigned	dirty_start, dirty_end ;
+        // loaded from or saved to image, mutex released. Others wait on io_cond.
+        bool	io_busy ;
+        std::list<block_c *>::iterator lru_pos ;
+        uint8_t	*data ;
+    } ;
+
+    struct block_key_c {
+        storageimage_base_c *image ;
+        uint64_t	block_number ;
+        bool operator==(const block_key_c &other) const {
+            return image == other.image && block_number == other.block_number ;
+        }
+    } ;
+    struct block_key_hash_c {
+        size_t operator()(const block_key_c &key) const {
+            return std::hash<uint64_t>()(key.block_number) ^ std::hash<void *>()(key.image) ;
+        }
+    } ;
+
+    // image range to be loaded by worker
+    struct prefetch_request_c {
+        storageimage_base_c *image ;
+        uint64_t	position ;
+        uint64_t	end ;
+    } ;
+
+    // protects blocks, lookup tables and the prefetch queue.
+    // Released during image I/O, the blocks concerned are marked io_busy.
+    pthread_mutex_t	mutex ;
+    pthread_cond_t	prefetch_cond ; // signaled on new requests and termination
+    pthread_cond_t	io_cond ; // signaled when blocks are no longer io_busy
+    // serializes the image stream between drive threads and the worker,
+    // one per image
+    std::unordered_map<storageimage_base_c *, pthread_mutex_t> image_mutexes ;
+
+    // pending read-ahead, oldest first. The front is the one in work.
+    std::deque<prefetch_request_c> prefetch_queue ;
+    std::vector<uint8_t> prefetch_buffer ;
+
+    std::vector<block_c> blocks ;
+    std::vector<uint8_t> block_data ;
+    std::list<block_c *> lru ; // most recently used first
+    std::unordered_map<block_key_c, block_c *, block_key_hash_c> block_map ;
+
+    void resize(unsigned new_block_count) ;
+    block_c *lookup(storageimage_base_c *image, uint64_t block_number) ;
+    block_c *reclaim(void) ;
+    void assign(block_c *block, storageimage_base_c *image, uint64_t block_number) ;
+    unsigned load(storageimage_base_c *image, uint64_t block_number, unsigned max_count,
+                  std::vector<uint8_t> &buffer) ;
+    void image_io(storageimage_base_c *image, bool write, uint8_t *buffer, uint64_t position, unsigned len) ;
+    void write_back(block_c *block) ;
+    void drop(block_c *block) ;
+    void flush_locked(storageimage_base_c *image) ;
+    void wait_idle(storageimage_base_c *image, bool save_dirty) ;
+    bool prefetch_step(void) ;
+
+public:
+    parameter_unsigned_c block_count = parameter_unsigned_c(this, "blocks", "bc", /*readonly*/
+                                       false, "", "%u", "Cache size in blocks of 4 KB", 16, 10);
+    parameter_unsigned_c flush_interval = parameter_unsigned_c(this, "flush_interval", "fi", /*readonly*/
+                                          false, "ms", "%u", "Dirty blocks are saved after this time", 16, 10);
+    parameter_bool_c readahead = parameter_bool_c(this, "readahead", "ra", /*readonly*/
+                                 false, "Load blocks ahead of sequential reads in background");
+    parameter_unsigned64_c hits = parameter_unsigned64_c(this, "hits", "hits", /*readonly*/
+                                  true, "", "%" PRIu64, "Block accesses served from cache", 63, 10);
+    parameter_unsigned64_c misses = parameter_unsigned64_c(this, "misses", "miss", /*readonly*/
+                                    true, "", "%" PRIu64, "Block accesses loaded from image", 63, 10);
+    parameter_unsigned64_c prefetched = parameter_unsigned64_c(this, "prefetched", "pf", /*readonly*/
+                                        true, "", "%" PRIu64, "Blocks loaded by read-ahead", 63, 10);
+    parameter_unsigned64_c writebacks = parameter_unsigned64_c(this, "writebacks", "wb", /*readonly*/
+                                        true, "", "%" PRIu64, "Dirty blocks saved to image", 63, 10);
+
+    storagecache_c() ;
+    ~storagecache_c() ;
+
+    bool on_param_changed(parameter_c *param) override;
+
+    // background worker function
+    void worker(unsigned instance) override;
+
+    void on_power_changed(signal_edge_enum aclo_edge, signal_edge_enum dclo_edge) override;
+    void on_init_changed(void) override;
+
+    void read(storageimage_base_c *image, uint8_t *buffer, uint64_t position, unsigned len) ;
+    void write(storageimage_base_c *image, uint8_t *buffer, uint64_t position, unsigned len) ;
+
+    // load range of image in background, if not already cached
+    void prefetch(storageimage_base_c *image, uint64_t position, uint64_t len) ;
+
+    // save dirty blocks of one image, or all images if nullptr
+    void flush(storageimage_base_c *image) ;
+    // remove all blocks of one image, before close or truncate
+    void invalidate(storageimage_base_c *image, bool save_dirty) ;
+} ;
+
+extern storagecache_c *storagecache; // Singleton
+
+#endif
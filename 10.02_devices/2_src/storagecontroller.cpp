@@ -20,7 +20,6 @@
  IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
-
  12-nov-2018  JH      entered beta phase
 
  A qunibus device with several "storagedrives"
@@ -29,6 +28,7 @@
 #include "utils.hpp"
 
 #include "storagecontroller.hpp"
+#include "storagecache.hpp"
 
 storagecontroller_c::storagecontroller_c():  	  qunibusdevice_c() 
 {
@@ -70,7 +70,12 @@ bool storagecontroller_c::on_param_changed(parameter_c *param)
 void storagecontroller_c::on_power_changed(signal_edge_enum aclo_edge, signal_edge_enum dclo_edge) 
 {
 	std::vector<storagedrive_c*>::iterator it;
+	// image cache is not on the bus
+	storagecache->on_power_changed(aclo_edge, dclo_edge) ;
 	for (it = storagedrives.begin(); it != storagedrives.end(); it++) {
+		// power fail: written data must reach the medium
+		if (aclo_edge == SIGNAL_EDGE_RAISING || dclo_edge == SIGNAL_EDGE_RAISING)
+			(*it)->image_flush();
 		// drives should evaluate only DCLO for power to simulate wall power.
 		(*it)->on_power_changed(aclo_edge, dclo_edge);
 	}
@@ -80,7 +85,11 @@ void storagecontroller_c::on_power_changed(signal_edge_enum aclo_edge, signal_ed
 void storagecontroller_c::on_init_changed() 
 {
 	std::vector<storagedrive_c*>::iterator it;
+	storagecache->init_asserted = init_asserted ;
+	storagecache->on_init_changed() ;
 	for (it = storagedrives.begin(); it != storagedrives.end(); it++) {
+		if (init_asserted)
+			(*it)->image_flush();
 		(*it)->init_asserted = init_asserted;
 		(*it)->on_init_changed();
 	}
@@ -20,7 +20,6 @@
  IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
-
  may-2019		JD		file_size()
  12-nov-2018  JH      entered beta phase
 
@@ -31,6 +30,7 @@
  The image maybe an plain binary file, or a shared host directory holding an unpacked DEC filesystem.
  */
 #include <assert.h>
+#include <algorithm>
 
 #include <fstream>
 #include <ios>
@@ -41,6 +41,7 @@
 #include "sharedfilesystem/filesystem_base.hpp"
 #include "sharedfilesystem/storageimage_shared.hpp"
 
+#include "storagecache.hpp"
 #include "storagedrive.hpp"
 
 storagedrive_c::storagedrive_c(storagecontroller_c *_controller) :
@@ -75,6 +76,7 @@ void storagedrive_c::image_params_readonly(bool readonly)
     image_filepath.readonly = readonly ;
     image_filesystem.readonly = readonly ;
     image_shareddir.readonly = readonly ;
+    image_mmap.readonly = readonly ;
 }
 
 bool storagedrive_c::image_is_param(parameter_c *param) 
@@ -98,6 +100,7 @@ void storagedrive_c::image_delete()
         return ;
     storageimage_base_c *tmpimage = image ;
     image = nullptr ; // semi-atomic
+    storagecache->invalidate(tmpimage, /*save_dirty*/true) ;
     delete tmpimage ;
 }
 
@@ -119,7 +122,9 @@ bool storagedrive_c::image_recreate_on_param_change(parameter_c *param)
         // todo: well-formed path? else later open() fails
         image_delete() ;
 		accepted = image_recreate_shared_on_param_change(image_filepath.new_value, image_filesystem.value, image_shareddir.value) ;
-	    if (image == nullptr)  // not enough params for shared dir: try regular image
+	    if (image == nullptr && image_mmap.value)  // not enough params for shared dir: try regular image
+	        image = new storageimage_mmap_c(image_filepath.new_value) ; // dyn size
+	    else if (image == nullptr)
 	        image = new storageimage_binfile_c(image_filepath.new_value) ; // dyn size
         accepted = (image != nullptr) ;
     } else if (param == &image_filesystem) {
@@ -169,6 +174,10 @@ bool storagedrive_c::image_open(bool create)
     if (image == nullptr)
         return false ;
 
+    // may re-open an open image
+    storagecache->invalidate(image, /*save_dirty*/true) ;
+    sequential_read_count = 0 ;
+    readahead_end = 0 ;
     // virtual method of implementation
     return image->open(this, create) ;
 }
@@ -177,6 +186,7 @@ void storagedrive_c::image_close(void)
 {
     if (image == nullptr)
         return ;
+    storagecache->invalidate(image, /*save_dirty*/true) ;
     image->close() ;
 }
 
@@ -197,6 +207,7 @@ bool storagedrive_c::image_is_readonly()
 bool storagedrive_c::image_truncate(void) {
     if (image == nullptr)
         return false ; // is_open
+    storagecache->invalidate(image, /*save_dirty*/false) ;
     return image->truncate() ;
 }
 
@@ -204,6 +215,7 @@ uint64_t storagedrive_c::image_size(void)
 {
     if (image == nullptr)
         return 0 ;
+    storagecache->flush(image) ; // cached writes may extend the image
     return image->size() ;
 }
 
@@ -212,18 +224,64 @@ void storagedrive_c::image_read(uint8_t *buffer, uint64_t position, unsigned len
     if (image == nullptr)
         return ;
     set_activity_led(true) ; // indicate only read/write access
-    image->read(buffer, position, len) ;
+    storagecache->read(image, buffer, position, len) ;
+    image_readahead(position, len) ;
     set_activity_led(false) ;
 }
 
+/* After some sequential reads, let the cache or the image load the next cylinder in background.
+ * Requested again when half of the read-ahead is consumed,
+ * so a long transfer keeps ahead of the controller.
+ */
+void storagedrive_c::image_readahead(uint64_t position, unsigned len)
+{
+    if (position == sequential_read_position)
+        sequential_read_count++ ;
+    else {
+        sequential_read_count = 0 ;
+        readahead_end = 0 ;
+    }
+    uint64_t end = position + len ;
+    sequential_read_position = end ;
+    if (sequential_read_count < 2)
+        return ;
+
+    // MSCP drives have no cylinders
+    uint64_t readahead_len = geometry.get_cylinder_capacity() ;
+    if (readahead_len == 0)
+        readahead_len = 0x10000 ;
+    if (end + readahead_len / 2 <= readahead_end)
+        return ; // enough ahead
+    uint64_t readahead_start = std::max(end, readahead_end) ;
+    readahead_end = end + readahead_len ;
+    if (capacity.value > 0)
+        readahead_end = std::min(readahead_end, capacity.value) ;
+    if (readahead_end <= readahead_start)
+        return ;
+    if (image->is_cacheable())
+        storagecache->prefetch(image, readahead_start, readahead_end - readahead_start) ;
+    else
+        image->prefetch(readahead_start, readahead_end - readahead_start) ;
+}
+
 void storagedrive_c::image_write(uint8_t *buffer, uint64_t position, unsigned len) 
 {
     if (image == nullptr)
         return ;
     set_activity_led(true) ;
-    image->write(buffer, position, len) ;
+    storagecache->write(image, buffer, position, len) ;
     set_activity_led(false) ;
 }
+
+// save written data to the medium.
+// storagecache_c is flushed by the controller for all images.
+void storagedrive_c::image_flush(void)
+{
+    if (image == nullptr)
+        return ;
+    image->flush() ;
+}
+
 // Service function for disk drive who need to clear unwritten bytes in last block of transaction
 // Sometimes when writing incomplete disk blocks, the remaining bytes must be filled with 00s
 // Some disk are guaranteed to write only whole blocks, then always unused_byte_count=0
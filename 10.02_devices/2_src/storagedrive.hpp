@@ -83,6 +83,12 @@ private:
     // hide from devices
     storageimage_base_c	*image = nullptr ;
 
+    // detect sequential reads, to request read-ahead from storagecache
+    uint64_t	sequential_read_position = 0 ; // where the next read is expected
+    unsigned	sequential_read_count = 0 ;
+    uint64_t	readahead_end = 0 ; // read-ahead requested up to here
+    void image_readahead(uint64_t position, unsigned len) ;
+
 public:
     storagecontroller_c *controller; // link to parent
 
@@ -109,6 +115,10 @@ public:
     parameter_string_c image_filesystem = parameter_string_c(this, "shared_filesystem", "shfs", /*readonly*/
                                           false, "Encode shared dir in this file system (empty, RT11, XXDP).");
 
+    // evaluated when "image" is set
+    parameter_bool_c image_mmap = parameter_bool_c(this, "mmap", "mm", /*readonly*/
+                                  false, "Map binary image file into memory instead of file access. Set before \"image\".");
+
     parameter_unsigned_c activity_led = parameter_unsigned_c(this, "activityled", "al", /*readonly*/
                                         false, "", "%d", "Number of LED to used for activity display.", 8, 10);
 
@@ -139,6 +149,7 @@ public:
     uint64_t image_size(void) ;
     void image_read(uint8_t *buffer, uint64_t position, unsigned len) ;
     void image_write(uint8_t *buffer, uint64_t position, unsigned len) ;
+    void image_flush(void) ;
     void image_clear_remaining_block_bytes(unsigned block_size_bytes, uint64_t position, unsigned len) ;
 
     void set_activity_led(bool onoff) ;
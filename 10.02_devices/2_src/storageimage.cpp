@@ -28,14 +28,18 @@
  supports the "attach" command
  */
 #include <assert.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <string.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <fstream>
 #include <ios>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
+#include <linux/falloc.h>
 
 #ifndef O_BINARY
 #define O_BINARY 0		// for linux compatibility
@@ -68,6 +72,62 @@ bool storageimage_base_c::is_zero(uint64_t position, unsigned len)
 }
 
 
+/* Sparse image files:
+ * Ranges of 00s are not stored as data, but left as "holes" of the host filesystem.
+ * Image files stay SimH compatible, but mostly empty MSCP images
+ * do not fill the SD card and are created instantly.
+ */
+
+// true, if all bytes are 00
+static bool is_zero_buffer(uint8_t *buffer, unsigned len)
+{
+    for (unsigned i = 0; i < len; i++)
+        if (buffer[i] != 0)
+            return false ;
+    return true ;
+}
+
+// true, if file has no data in the range, so reading it needs no I/O.
+// On filesystems without hole support all of the file is data.
+static bool is_file_hole(int fd, uint64_t position, unsigned len)
+{
+    off_t data_pos = lseek(fd, position, SEEK_DATA) ;
+    if (data_pos < 0)
+        return errno == ENXIO ; // no data after position
+    return (uint64_t)data_pos >= position + len ;
+}
+
+// Set range to 00s by deallocating it. File is extended if needed.
+// result: false, if filesystem can not punch holes
+static bool punch_file_hole(int fd, uint64_t file_size, uint64_t position, unsigned len)
+{
+    if (position + len > file_size && ftruncate(fd, position + len) != 0)
+        return false ;
+    if (position >= file_size)
+        return true ; // extended range is a hole already
+    return fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, position, len) == 0 ;
+}
+
+// if only <image_fname>.gz exists: unzip it to image_fname
+// result: false if no compressed file, or unzip failed
+static bool expand_compressed_image(std::string image_fname)
+{
+    std::string compressed_image_fname = image_fname + ".gz" ;
+    if (FILE *fz = fopen(compressed_image_fname.c_str(), "r")) {
+        fclose(fz);
+        std::string uncompress_cmd = "zcat " + compressed_image_fname + " >" + image_fname ;
+        printf("Only compressed image file %s found, expanding \"%s\" ...\n", image_fname.c_str(), uncompress_cmd.c_str()) ;
+        int ret = system(uncompress_cmd.c_str()) ;
+        if (ret != 0) {
+            printf(" FAILED!\n") ;
+            return false ;
+        }
+        printf("... complete.\n") ;
+        return true ;
+    }
+    return false ;
+}
+
 // http://www.cplusplus.com/doc/tutorial/files/
 
 // open a file, if possible.
@@ -87,7 +147,7 @@ bool storageimage_binfile_c::open(storagedrive_c *_drive, bool create)
             return true ; // ! is_open
         f.open(image_fname, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
         if (f.is_open())
-            return true;
+            return open_sparse_fd();
 
         // is readonly? try open for read only
 
@@ -95,28 +155,14 @@ bool storageimage_binfile_c::open(storagedrive_c *_drive, bool create)
         f.open(image_fname, std::ios::in | std::ios::binary | std::ios::ate);
         if (f.is_open()) {
             readonly = true;
-            return true;
+            return open_sparse_fd();
         }
 
         retries-- ;
-        if (retries > 0) {
-            // file could not be opened, neither rw nor read only
-            // try to unzip, then retry opening
-            std::string compressed_image_fname = image_fname + ".gz" ;
-            if (FILE *fz = fopen(compressed_image_fname.c_str(), "r")) {
-                fclose(fz);
-                std::string uncompress_cmd = "zcat " + compressed_image_fname + " >" + image_fname ;
-                printf("Only compressed image file %s found, expanding \"%s\" ...\n", image_fname.c_str(), uncompress_cmd.c_str()) ;
-                int ret = system(uncompress_cmd.c_str()) ;
-                if (ret != 0) {
-                    printf(" FAILED!\n") ;
-                    retries = 0 ; // not again
-                } else
-                    printf("... complete.\n") ;
-
-            } else
-                retries = 0 ; // not again
-        }
+        // file could not be opened, neither rw nor read only
+        // try to unzip, then retry opening
+        if (retries > 0 && !expand_compressed_image(image_fname))
+            retries = 0 ; // not again
     }
 
     // definitely no image file neither plain nor zipped
@@ -131,13 +177,21 @@ bool storageimage_binfile_c::open(storagedrive_c *_drive, bool create)
     f.open(image_fname, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
     if (f.is_open()) {
         INFO("Created empty image file %s.", image_fname.c_str()) ;
-        return true ;
+        return open_sparse_fd() ;
     } else {
         INFO("Creating empty image file %s FAILED.", image_fname.c_str()) ;
         return false;
     }
 }
 
+// second descriptor to the image file, for hole operations not possible on fstream
+bool storageimage_binfile_c::open_sparse_fd()
+{
+    sparse_fd = ::open(image_fname.c_str(), O_BINARY | (readonly ? O_RDONLY : O_RDWR)) ;
+    sparse = (sparse_fd >= 0) ;
+    return true ;
+}
+
 bool storageimage_binfile_c::is_open() 
 {
     return f.is_open();
@@ -167,8 +221,12 @@ void storageimage_binfile_c::read(uint8_t *buffer, uint64_t position, unsigned l
     assert(len) ;
     // 1. fill the buffer with 00s
     memset(buffer, 0, len);
+    if (sparse && is_file_hole(sparse_fd, position, len))
+        return ; // no data stored
 
-    // 2. move read pointer
+    // 2. move read pointer. Clear fail bit of a previous read past EOF,
+    // cached block reads may cover the end of the image.
+    f.clear();
     f.seekg(position);
     // may be at eof now, doesn't matter
 
@@ -177,41 +235,36 @@ void storageimage_binfile_c::read(uint8_t *buffer, uint64_t position, unsigned l
 }
 
 /* write "len" bytes from buffer into file at position "offset"
- * if file too short, it is extended
+ * if file too short, it is extended with a hole.
+ * Blocks of 00s are not written, but punched as hole.
  */
 void storageimage_binfile_c::write(uint8_t *buffer, uint64_t position, unsigned len) 
 {
     int64_t write_pos = (int64_t) position;  // unsigned-> int
-    const int max_chunk_size = 0x40000; //256KB: trade-off between performance and mem usage
-    uint8_t *fillbuff = NULL;
     int64_t file_size, p;
 
     assert(buffer);
     assert(is_open());
     assert(!readonly); // caller must take care
 
-    // enlarge file in chunks until filled up to "position"
+    if (sparse && is_zero_buffer(buffer, len)) {
+        set_zero(position, len) ;
+        return ;
+    }
+
     f.clear(); // clear fail bit
     f.seekp(0, std::ios::end); // move to current EOF
     file_size = f.tellp(); // current file len
     if (file_size < 0)
         file_size = 0; // -1 on emtpy files
-    while (file_size < write_pos) {
-        // fill in '00' 'chunks up to desired end, but limit to max_chunk_size
-        int chunk_size = std::min(max_chunk_size, (int) (write_pos - file_size));
-        if (!fillbuff) {
-            // allocate 00-buffer only once
-            fillbuff = (uint8_t *) malloc(max_chunk_size);
-            assert(fillbuff);
-            memset(fillbuff, 0, max_chunk_size);
-        }
-        f.clear(); // clear fail bit
-        f.seekp(file_size, std::ios::beg); // move to end
-        f.write((const char *) fillbuff, chunk_size);
-        file_size += chunk_size;
+    if (file_size < write_pos) {
+        // enlarge file up to "position"
+        if (sparse)
+            sparse = (ftruncate(sparse_fd, write_pos) == 0) ;
+        if (!sparse)
+            write_zeros(file_size, write_pos - file_size) ;
+        file_size = write_pos ;
     }
-    if (fillbuff)
-        free(fillbuff); // has been used, discard
 
     if (file_size == 0)
         // p = -1 error after seekp(0) on empty files?
@@ -231,6 +284,52 @@ void storageimage_binfile_c::write(uint8_t *buffer, uint64_t position, unsigned
     f.flush();
 }
 
+// fill in '00' chunks, if file system can not do holes
+void storageimage_binfile_c::write_zeros(uint64_t position, uint64_t len)
+{
+    const int max_chunk_size = 0x40000; //256KB: trade-off between performance and mem usage
+    uint8_t *fillbuff = (uint8_t *) malloc(max_chunk_size);
+    assert(fillbuff);
+    memset(fillbuff, 0, max_chunk_size);
+    f.clear(); // clear fail bit
+    f.seekp(position, std::ios::beg);
+    while (len > 0) {
+        // limit to max_chunk_size
+        int chunk_size = std::min((uint64_t)max_chunk_size, len);
+        f.write((const char *) fillbuff, chunk_size);
+        len -= chunk_size;
+    }
+    free(fillbuff);
+    f.flush();
+}
+
+// deallocate range, instead of writing 00s
+void storageimage_binfile_c::set_zero(uint64_t position, unsigned len)
+{
+    assert(is_open());
+    assert(!readonly); // caller must take care
+    f.clear(); // clear fail bit
+    f.seekp(0, std::ios::end);
+    int64_t file_size = f.tellp();
+    if (file_size < 0)
+        file_size = 0;
+    if (sparse && !punch_file_hole(sparse_fd, file_size, position, len))
+        sparse = false ; // filesystem without holes
+    if (!sparse) {
+        if ((int64_t)position > file_size)
+            write_zeros(file_size, position - file_size) ;
+        write_zeros(position, len) ;
+    }
+}
+
+// holes are 00s without reading
+bool storageimage_binfile_c::is_zero(uint64_t position, unsigned len)
+{
+    if (sparse && is_file_hole(sparse_fd, position, len))
+        return true ;
+    return storageimage_base_c::is_zero(position, len) ;
+}
+
 uint64_t storageimage_binfile_c::size(void) 
 {
     f.seekp(0, std::ios::end);
@@ -242,6 +341,10 @@ void storageimage_binfile_c::close(void)
     if (!is_open())
         return ;
     f.close();
+    if (sparse_fd >= 0)
+        ::close(sparse_fd) ;
+    sparse_fd = -1 ;
+    sparse = false ;
     readonly = false;
 }
 
@@ -286,6 +389,220 @@ void storageimage_binfile_c::save_to_file(std::string _host_filename)
 
 
 
+// (re)map the whole file after it was resized to new_size
+bool storageimage_mmap_c::map(uint64_t new_size)
+{
+    unmap() ;
+    data_size = new_size ;
+    if (data_size == 0)
+        return true ; // empty files can not be mapped
+    int prot = readonly ? PROT_READ : (PROT_READ | PROT_WRITE) ;
+    void *p = mmap(NULL, data_size, prot, MAP_SHARED, fd, 0) ;
+    if (p == MAP_FAILED) {
+        ERROR("storageimage_mmap_c: mmap() of %" PRIu64 " bytes of %s failed: %s", data_size, image_fname.c_str(), strerror(errno)) ;
+        data_size = 0 ;
+        return false ;
+    }
+    data = (uint8_t *)p ;
+    // emulated disks are accessed sector by sector at random
+    madvise(data, data_size, MADV_RANDOM) ;
+    return true ;
+}
+
+void storageimage_mmap_c::unmap(void)
+{
+    if (data != nullptr)
+        munmap(data, data_size) ;
+    data = nullptr ;
+    data_size = 0 ;
+}
+
+// open like storageimage_binfile_c, then map the file
+bool storageimage_mmap_c::open(storagedrive_c *_drive, bool create)
+{
+    drive = _drive ;
+    if (is_open())
+        close(); // after RL11 INIT
+    if (image_fname.empty())
+        return true ; // ! is_open
+
+    readonly = false ;
+    fd = ::open(image_fname.c_str(), O_BINARY | O_RDWR) ;
+    if (fd < 0 && expand_compressed_image(image_fname))
+        fd = ::open(image_fname.c_str(), O_BINARY | O_RDWR) ;
+    if (fd < 0) {
+        fd = ::open(image_fname.c_str(), O_BINARY | O_RDONLY) ;
+        readonly = (fd >= 0) ;
+    }
+    if (fd < 0 && create) {
+        fd = ::open(image_fname.c_str(), O_BINARY | O_RDWR | O_CREAT, 0666) ;
+        if (fd >= 0)
+            INFO("Created empty image file %s.", image_fname.c_str()) ;
+        else
+            INFO("Creating empty image file %s FAILED.", image_fname.c_str()) ;
+    }
+    if (fd < 0)
+        return false ;
+
+    sparse = true ; // until filesystem refuses holes
+    struct stat file_status ;
+    fstat(fd, &file_status) ;
+    if (!map(file_status.st_size)) {
+        close() ;
+        return false ;
+    }
+    return true ;
+}
+
+bool storageimage_mmap_c::is_open(void)
+{
+    return fd >= 0 ;
+}
+
+// set file size to 0
+bool storageimage_mmap_c::truncate(void)
+{
+    assert(is_open());
+    assert(!readonly); // caller must take care
+    unmap() ;
+    return ftruncate(fd, 0) == 0 ;
+}
+
+/* read "len" bytes from file into buffer
+ * if file is too short, 00s are read
+ */
+void storageimage_mmap_c::read(uint8_t *buffer, uint64_t position, unsigned len)
+{
+    assert(is_open());
+    assert(buffer != nullptr) ;
+    assert(len) ;
+    unsigned bytes_copied = 0 ;
+    if (position < data_size) {
+        bytes_copied = std::min((uint64_t)len, data_size - position) ;
+        memcpy(buffer, data + position, bytes_copied) ;
+    }
+    if (bytes_copied != len)
+        memset(buffer + bytes_copied, 0, len - bytes_copied) ;
+}
+
+/* write "len" bytes from buffer into file at position "offset"
+ * if file too short, it is extended with 00s and mapped again
+ */
+void storageimage_mmap_c::write(uint8_t *buffer, uint64_t position, unsigned len)
+{
+    assert(buffer);
+    assert(is_open());
+    assert(!readonly); // caller must take care
+
+    uint64_t end = position + len ;
+    if (sparse && is_zero_buffer(buffer, len)) {
+        set_zero(position, len) ;
+        return ;
+    }
+    if (end > data_size) {
+        if (ftruncate(fd, end) != 0 || !map(end)) {
+            ERROR("storageimage_mmap_c.write() failure on %s", image_fname.c_str());
+            return ;
+        }
+    }
+    memcpy(data + position, buffer, len) ;
+}
+
+// deallocate range, the mapping then reads 00s
+void storageimage_mmap_c::set_zero(uint64_t position, unsigned len)
+{
+    assert(is_open());
+    assert(!readonly); // caller must take care
+    uint64_t end = position + len ;
+    if (sparse && !punch_file_hole(fd, data_size, position, len))
+        sparse = false ; // filesystem without holes
+    if (end > data_size) {
+        // extended by punch_file_hole() already, if sparse
+        if ((!sparse && ftruncate(fd, end) != 0) || !map(end)) {
+            ERROR("storageimage_mmap_c.set_zero() failure on %s", image_fname.c_str());
+            return ;
+        }
+    }
+    if (!sparse)
+        memset(data + position, 0, len) ;
+}
+
+// holes are 00s without touching pages
+bool storageimage_mmap_c::is_zero(uint64_t position, unsigned len)
+{
+    if (sparse && is_file_hole(fd, position, len))
+        return true ;
+    return storageimage_base_c::is_zero(position, len) ;
+}
+
+uint64_t storageimage_mmap_c::size(void)
+{
+    return data_size ;
+}
+
+// let the kernel load the pages before the drive touches them
+void storageimage_mmap_c::prefetch(uint64_t position, uint64_t len)
+{
+    if (position >= data_size)
+        return ;
+    len = std::min(len, data_size - position) ;
+    // madvise() needs page aligned start
+    uint64_t page_offset = position % sysconf(_SC_PAGESIZE) ;
+    madvise(data + position - page_offset, len + page_offset, MADV_WILLNEED) ;
+}
+
+void storageimage_mmap_c::flush(void)
+{
+    if (data != nullptr && !readonly)
+        msync(data, data_size, MS_SYNC) ;
+}
+
+void storageimage_mmap_c::close(void)
+{
+    if (!is_open())
+        return ;
+    flush() ;
+    unmap() ;
+    ::close(fd) ;
+    fd = -1 ;
+    readonly = false;
+}
+
+// read data from image into memory buffer (cache)
+void storageimage_mmap_c::get_bytes(byte_buffer_c* byte_buffer, uint64_t byte_offset, uint32_t len)
+{
+    byte_buffer->set_size(len) ;
+    read(byte_buffer->data_ptr(), byte_offset, len) ;
+}
+
+// write cache buffer to image
+void storageimage_mmap_c::set_bytes(byte_buffer_c *byte_buffer, uint64_t byte_offset)
+{
+    write(byte_buffer->data_ptr(), byte_offset, byte_buffer->size()) ;
+}
+
+// make a snapshot
+void storageimage_mmap_c::save_to_file(std::string _host_filename)
+{
+    std::string host_filename = absolute_path(&_host_filename) ;
+    assert(is_open()) ;
+
+    try {
+        int32_t file_descriptor;
+        file_descriptor = ::open(host_filename.c_str(), O_BINARY | O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (file_descriptor < 0)
+            throw printf_exception("storageimage_mmap_c::save_to_file() cannot open \"%s\"",
+                                   host_filename.c_str());
+        if (data_size > 0 && ::write(file_descriptor, data, data_size) != (ssize_t)data_size)
+            ERROR("storageimage_mmap_c::save_to_file() cannot write \"%s\"", host_filename.c_str());
+        ::close(file_descriptor);
+    }
+    catch(std::exception& e) {
+        ERROR(e.what()) ;
+    }
+}
+
+
 // result: OK= true, else false
 bool storageimage_memory_c::open(storagedrive_c *_drive, bool create)
 {
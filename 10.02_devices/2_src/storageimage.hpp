@@ -36,6 +36,7 @@
 #include <stdint.h>
 #include <string>
 #include <fstream>
+#include "utils.hpp"
 #include "logsource.hpp"
 #include "bytebuffer.hpp"
 
@@ -56,6 +57,17 @@ public:
     virtual void write(uint8_t *buffer, uint64_t position, unsigned len)= 0;
     virtual void set_zero(uint64_t position, unsigned len) ;
     virtual bool is_zero(uint64_t position, unsigned len) ;
+    // may blocks be buffered by storagecache_c?
+    virtual bool is_cacheable(void) {
+        return false ;
+    }
+    // drive reads sequentially, range will be needed soon
+    virtual void prefetch(uint64_t position, uint64_t len) {
+        UNUSED(position) ;
+        UNUSED(len) ;
+    }
+    // save written data to the medium, on INIT and power down
+    virtual void flush(void) {}
 
     virtual uint64_t size(void)= 0;
     virtual void close(void)= 0;
@@ -75,10 +87,17 @@ private:
     bool readonly ;
     std::fstream f; // image file
     std::string image_fname ;
+    int sparse_fd ; // same file, to find and punch holes
+    bool sparse ; // filesystem supports holes
+
+    bool open_sparse_fd(void) ;
+    void write_zeros(uint64_t position, uint64_t len) ;
 
 public:
     storageimage_binfile_c(std::string _image_fname) {
         image_fname = _image_fname ;
+        sparse_fd = -1 ;
+        sparse = false ;
     }
 
     // nothing to free
@@ -90,11 +109,17 @@ public:
     virtual bool is_readonly() override {
         return readonly ;
     }
+    // slow SD card access
+    virtual bool is_cacheable(void) override {
+        return true ;
+    }
     virtual bool open(storagedrive_c *drive, bool create) override;
     virtual bool is_open(	void) override;
     virtual bool truncate(void) override;
     virtual void read(uint8_t *buffer, uint64_t position, unsigned len) override;
     virtual void write(uint8_t *buffer, uint64_t position, unsigned len) override;
+    virtual void set_zero(uint64_t position, unsigned len) override ;
+    virtual bool is_zero(uint64_t position, unsigned len) override ;
     virtual uint64_t size(void) override;
     virtual void close(void) override;
     virtual void get_bytes(byte_buffer_c *byte_buffer, uint64_t byte_offset, uint32_t data_size) override;
@@ -104,6 +129,54 @@ public:
 
 } ;
 
+// binary disk file like storageimage_binfile_c, but mapped into memory.
+// Accessed with memcpy(), the kernel loads and saves only touched pages,
+// so even big MSCP images do not need to fit into RAM.
+class storageimage_mmap_c: public storageimage_base_c {
+private:
+    bool readonly ;
+    int fd ; // image file, -1 if closed
+    std::string image_fname ;
+    uint8_t 	*data ; // mapped file content, nullptr if file empty
+    uint64_t	data_size ; // file size = mapped size
+    bool sparse ; // filesystem supports holes
+
+    bool map(uint64_t new_size) ;
+    void unmap(void) ;
+
+public:
+    storageimage_mmap_c(std::string _image_fname) {
+        image_fname = _image_fname ;
+        readonly = false ;
+        fd = -1 ;
+        data = nullptr ;
+        data_size = 0 ;
+        sparse = false ;
+    }
+
+    virtual ~storageimage_mmap_c() override {
+        close() ;
+    }
+
+    virtual bool is_readonly() override {
+        return readonly ;
+    }
+    virtual void prefetch(uint64_t position, uint64_t len) override ;
+    virtual void flush(void) override ;
+    virtual bool open(storagedrive_c *drive, bool create) override;
+    virtual bool is_open(	void) override;
+    virtual bool truncate(void) override;
+    virtual void read(uint8_t *buffer, uint64_t position, unsigned len) override;
+    virtual void write(uint8_t *buffer, uint64_t position, unsigned len) override;
+    virtual void set_zero(uint64_t position, unsigned len) override ;
+    virtual bool is_zero(uint64_t position, unsigned len) override ;
+    virtual uint64_t size(void) override;
+    virtual void close(void) override;
+    virtual void get_bytes(byte_buffer_c *byte_buffer, uint64_t byte_offset, uint32_t data_size) override;
+    virtual void set_bytes(byte_buffer_c *byte_buffer, uint64_t byte_offset) override ;
+    virtual void save_to_file(std::string host_filename) override ;
+} ;
+
 // in-memory version of disk image file
 class storageimage_memory_c: public storageimage_base_c {
 private:
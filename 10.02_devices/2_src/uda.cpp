@@ -20,6 +20,8 @@
 #include <string.h>
 #include <strings.h>
 #include <assert.h>
+#include <errno.h>
+#include <time.h>
 
 #include "logger.hpp"
 #include "gpios.hpp"	// debug pin
@@ -34,6 +36,7 @@ uda_c::uda_c() :
         storagecontroller_c(),
         _controllerType(UDA50),
         _22bitDMA(false),
+        dma_mutex(PTHREAD_MUTEX_INITIALIZER),
         _server(nullptr),
         _ringBase(0),
         _commandRingLength(0),
@@ -45,7 +48,14 @@ uda_c::uda_c() :
         _purgeInterruptEnable(false),
         _step1Value(0),
         _initStep(InitializationStep::Uninitialized),
-        _next_step(false)
+        _next_step(false),
+        intr_coalesce_mutex(PTHREAD_MUTEX_INITIALIZER),
+        _coalescedResponses(0),
+        _commandCacheFirst(0),
+        _commandCacheCount(0),
+        _commandReleaseFirst(0),
+        _commandReleaseCount(0),
+        _commandReleaseInterrupt(false)
 {
     name.value = "uda";  
     type_name.value = "UDA50";
@@ -57,6 +67,13 @@ uda_c::uda_c() :
     // base addr, intr-vector, intr level
     set_default_bus_params(0772150, 20, 0154, 5) ;
 
+    // instance 0: initialization state machine, 1: interrupt coalescing timer
+    set_workers_count(2);
+
+    pthread_cond_init(&intr_coalesce_cond, NULL);
+    intr_coalesce_count.value = 1;
+    intr_coalesce_delay.value = 500;
+
     // The UDA50 controller has two registers.
     register_count = 2;
 
@@ -74,6 +91,13 @@ uda_c::uda_c() :
     SA_reg->reset_value = 0;
     SA_reg->writable_bits = 0xffff;
 
+    for (uint32_t i=0; i<DRIVE_COUNT * 2; i++)
+    {
+        dma_request_c* request = new dma_request_c(this);
+        request->set_priority_slot(priority_slot.value);
+        _sliceDMARequests.push_back(std::unique_ptr<dma_request_c>(request));
+    }
+
     _server.reset(new mscp_server(this));
 
     //
@@ -100,6 +124,8 @@ uda_c::~uda_c()
     }
 
     storagedrives.clear();
+
+    pthread_cond_destroy(&intr_coalesce_cond);
 }
 
 bool uda_c::on_param_changed(parameter_c *param) 
@@ -109,6 +135,10 @@ bool uda_c::on_param_changed(parameter_c *param)
     {
         dma_request.set_priority_slot(priority_slot.new_value);
         intr_request.set_priority_slot(priority_slot.new_value);
+        for (auto& request : _sliceDMARequests)
+        {
+            request->set_priority_slot(priority_slot.new_value);
+        }
     }
     else if (param == &intr_level) 
     {
@@ -118,6 +148,13 @@ bool uda_c::on_param_changed(parameter_c *param)
     {
         return false;  // Not configurable for the UDA50.
     } 
+    else if (param == &intr_coalesce_count) 
+    {
+        if (intr_coalesce_count.new_value < 1)
+        {
+            return false;
+        }
+    } 
     else if (param == &type_name) 
     {
         if (strcasecmp("uda50", type_name.new_value.c_str()) == 0) 
@@ -159,6 +196,13 @@ void uda_c::Reset(void)
     _responseRingLength = 0;
     _commandRingPointer = 0;
     _responseRingPointer = 0;
+    ResetRingCache();
+
+    // A held back response interrupt is dropped with the rings.
+    pthread_mutex_lock(&intr_coalesce_mutex);
+    _coalescedResponses = 0;
+    pthread_mutex_unlock(&intr_coalesce_mutex);
+
     _interruptVector = 0;
     intr_vector.value = 0;
     _interruptEnable = false;
@@ -204,12 +248,27 @@ void uda_c::StateTransition(
 
 //
 // worker():
-//  Implements the initialization state machine.
+//  Runs the initialization state machine and the interrupt coalescing timer.
 //
 void uda_c::worker(unsigned instance)
 {
-    UNUSED(instance) ; // only one
+    // 2 parallel worker() instances: 0 and 1 
+    if (instance == 0)
+    {
+        worker_initialization();
+    }
+    else
+    {
+        worker_intr_coalescing();
+    }
+}
 
+//
+// worker_initialization():
+//  Implements the initialization state machine.
+//
+void uda_c::worker_initialization(void)
+{
     worker_init_realtime_priority(rt_device); 
 
     timeout_c timeout;
@@ -283,32 +342,34 @@ void uda_c::worker(unsigned instance)
                  DEBUG_FAST("Clearing comm area at 0x%x. Purge header: %d", _ringBase, _purgeInterruptEnable);
                  DEBUG_FAST("resp 0x%x comm 0x%x", _responseRingLength, _commandRingLength);
 
-                 {
-                     int headerSize = _purgeInterruptEnable ? 8 : 4;
-                     for(uint32_t i = 0; 
-                         i < (_responseRingLength + _commandRingLength) * sizeof(Descriptor) + headerSize;
-                         i += 2)
-                     {
-                         DMAWriteWord(_ringBase + i - headerSize, 0x0);
-                     }
-                 }
+                 ResetRingCache();
 
                  //
-                 // Set the ownership bit on all descriptors in the response ring
-                 // to indicate that the port owns them.
+                 // Clear the header and both rings, with the ownership bit set on
+                 // all descriptors in the response ring to indicate that the port
+                 // owns them.  The whole area goes out in one DMA.
                  //
-                 Descriptor blankDescriptor;
-                 blankDescriptor.Word0.Word0 = 0;
-                 blankDescriptor.Word1.Word1 = 0;
-                 blankDescriptor.Word1.Fields.Ownership = 1;
-
-                 for(uint32_t i = 0; i < _responseRingLength; i++)
                  {
+                     size_t headerSize = _purgeInterruptEnable ? 8 : 4;
+                     std::vector<uint8_t> commArea(
+                         headerSize + (_responseRingLength + _commandRingLength) * sizeof(Descriptor));
+
+                     Descriptor blankDescriptor;
+                     blankDescriptor.Word0.Word0 = 0;
+                     blankDescriptor.Word1.Word1 = 0;
+                     blankDescriptor.Word1.Fields.Ownership = 1;
+
+                     for(uint32_t i = 0; i < _responseRingLength; i++)
+                     {
+                         memcpy(commArea.data() + headerSize + i * sizeof(Descriptor),
+                             &blankDescriptor, sizeof(Descriptor));
+                     }
+
                      DMAWrite(
-                         GetResponseDescriptorAddress(i),
-                         sizeof(Descriptor),
-                         reinterpret_cast<uint8_t*>(&blankDescriptor));
-                 }  
+                         _ringBase - headerSize,
+                         commArea.size(),
+                         commArea.data());
+                 }
  
                  DEBUG_FAST("Transition to Init state S4, comm area initialized.");
                  // Update the SA read value for step 4:
@@ -520,6 +581,123 @@ uda_c::update_SA(uint16_t value)
         "update_SA"); 
 } 
 
+//
+// ResetRingCache():
+//  Forgets cached command descriptors and pending releases, used when
+//  the rings are (re)initialized.
+//
+void
+uda_c::ResetRingCache(void)
+{
+    _commandCacheFirst = 0;
+    _commandCacheCount = 0;
+    _commandReleaseFirst = 0;
+    _commandReleaseCount = 0;
+    _commandReleaseInterrupt = false;
+}
+
+//
+// GetCommandDescriptor():
+//  Returns the command descriptor at the given ring index.
+//  A port-owned descriptor is taken from the cache; anything else
+//  is read again, together with its neighbours.
+//  On NXM, error is set to true and nullptr is returned.
+//
+uda_c::Descriptor*
+uda_c::GetCommandDescriptor(uint32_t index, bool* error)
+{
+    if (index < _commandCacheFirst ||
+        index >= _commandCacheFirst + _commandCacheCount ||
+        !_commandCache[index - _commandCacheFirst].Word1.Fields.Ownership)
+    {
+        uint32_t first = index > 0 ? index - 1 : 0;
+        uint32_t count = std::min(static_cast<uint32_t>(RING_CACHE_SIZE),
+            static_cast<uint32_t>(_commandRingLength - first));
+
+        _commandCacheCount = 0;
+        if (!DMARead(
+                GetCommandDescriptorAddress(first),
+                count * sizeof(Descriptor),
+                reinterpret_cast<uint8_t*>(_commandCache)))
+        {
+            *error = true;
+            return nullptr;
+        }
+
+        _commandCacheFirst = first;
+        _commandCacheCount = count;
+    }
+
+    return &_commandCache[index - _commandCacheFirst];
+}
+
+//
+// ReleaseCommands():
+//  Hands the descriptors of all commands taken since the last call back
+//  to the host: the Owner bits are reset and the Flag bits set in one
+//  bus tenure, followed by the transition word if any of the commands
+//  asked for an interrupt.  At most one interrupt is posted per batch.
+//  Returns false (and resets the port) on a bus error.
+//
+bool
+uda_c::ReleaseCommands(void)
+{
+    if (0 == _commandReleaseCount)
+    {
+        return true;
+    }
+
+    // The batch may wrap around the end of the ring.
+    uint32_t firstCount = std::min(_commandReleaseCount,
+        static_cast<uint32_t>(_commandRingLength - _commandReleaseFirst));
+    uint16_t transition = 0x1;
+    DMAWriteSegment writes[3];
+    unsigned segmentCount = 0;
+
+    writes[segmentCount++] = {
+        GetCommandDescriptorAddress(_commandReleaseFirst),
+        firstCount * sizeof(Descriptor),
+        reinterpret_cast<uint8_t*>(_commandReleases) };
+    if (firstCount < _commandReleaseCount)
+    {
+        writes[segmentCount++] = {
+            GetCommandDescriptorAddress(0),
+            (_commandReleaseCount - firstCount) * sizeof(Descriptor),
+            reinterpret_cast<uint8_t*>(_commandReleases + firstCount) };
+    }
+
+    // If an interrupt is necessary, set ring base - 4 to non-zero
+    // to indicate a transition.
+    bool doInterrupt = _commandReleaseInterrupt;
+    if (doInterrupt)
+    {
+        writes[segmentCount++] = {
+            _ringBase - 4, sizeof(uint16_t), reinterpret_cast<uint8_t*>(&transition) };
+    }
+
+    DEBUG_FAST("Releasing %d command descriptors at ring ptr 0x%x",
+        _commandReleaseCount, _commandReleaseFirst);
+
+    // Cached copies of the released slots are stale from now on.
+    _commandReleaseCount = 0;
+    _commandReleaseInterrupt = false;
+    _commandCacheCount = 0;
+
+    if (!DMAWriteSegments(writes, segmentCount))
+    {
+        PortError(PORT_ERROR_RING_WRITE);
+        return false;
+    }
+
+    // Post an interrupt as necessary.
+    if (doInterrupt)
+    {
+        Interrupt();
+    }
+
+    return true;
+}
+
 //
 // GetNextCommand():
 //  Attempts to pull the next command from the command ring, if any
@@ -531,80 +709,107 @@ uda_c::update_SA(uint16_t value)
 //  The error pointer is set to true if an error occurred during the 
 //  operation -- due to non-existent memory or invalid data.  
 //  (In this case nullptr will also be returned.)
+//  The descriptor of a returned command is not written back right away,
+//  see ReleaseCommands().
 //
-Message*
+MessageHandle
 uda_c::GetNextCommand(bool* error) 
 {
-    timeout_c timer;
     *error = false;
+
+    // A full batch is handed back before its slots can come around again.
+    if (_commandReleaseCount >= std::min(static_cast<size_t>(RING_CACHE_SIZE), _commandRingLength)
+        && !ReleaseCommands())
+    {
+        *error = true;
+        return nullptr;
+    }
  
     // Grab the next descriptor being pointed to    
-    uint32_t descriptorAddress = 
-        GetCommandDescriptorAddress(_commandRingPointer);
-
     DEBUG_FAST("Next descriptor (ring ptr 0x%x) address is o%o", 
         _commandRingPointer, 
-        descriptorAddress);
-
-    std::unique_ptr<Descriptor> cmdDescriptor(
-        reinterpret_cast<Descriptor*>(
-            DMARead(
-                descriptorAddress,
-                sizeof(Descriptor),
-                sizeof(Descriptor))));
+        GetCommandDescriptorAddress(_commandRingPointer));
 
-    // A null command descriptor indicates an NXM condition; we set SA to the appropriate
+    // A failed read indicates an NXM condition; we set SA to the appropriate
     // error code and reset the port.
-    if (!cmdDescriptor)
+    Descriptor* cachedDescriptor = GetCommandDescriptor(_commandRingPointer, error);
+    if (*error)
     {
         PortError(PORT_ERROR_PACKET_READ);
-        *error = true;
         return nullptr;
     }
+    Descriptor cmdDescriptor = *cachedDescriptor;
  
     // Check owner bit: if set, ownership has been passed to us, in which case
     // we can attempt to pull the actual message from memory.
-    if (cmdDescriptor->Word1.Fields.Ownership)
+    if (cmdDescriptor.Word1.Fields.Ownership)
     {
         bool doInterrupt = false;
 
         uint32_t messageAddress =
-            cmdDescriptor->Word0.EnvelopeLow |
-            (cmdDescriptor->Word1.Fields.EnvelopeHigh << 16);
+            cmdDescriptor.Word0.EnvelopeLow |
+            (cmdDescriptor.Word1.Fields.EnvelopeHigh << 16);
 
         DEBUG_FAST("Next message address is o%o, flag %d", 
-            messageAddress, cmdDescriptor->Word1.Fields.Flag);
+            messageAddress, cmdDescriptor.Word1.Fields.Flag);
+
+        MessageHandle cmdMessage(_messagePool.Allocate());
+        uint8_t* messageBytes = reinterpret_cast<uint8_t*>(cmdMessage.get());
 
         //
-        // Grab the message length; this is at messageAddress - 4
+        // Grab the message length; this is at messageAddress - 4.
+        // A regular sized message is read along with it.  That may run into
+        // non-existent memory if the envelope is at the very end, in which
+        // case the length word is read alone.
         //
-        bool success = false;
-        uint16_t messageLength = 
-            DMAReadWord(
-                messageAddress - 4,
-                success);
+        size_t prefetchBytes = std::min(sizeof(Message), static_cast<size_t>(MESSAGE_PREFETCH_BYTES));
+        size_t prefetched = 0;
+        if (messageAddress - 4 + prefetchBytes <= 2 * qunibus->addr_space_word_count
+            && DMARead(messageAddress - 4, prefetchBytes, messageBytes))
+        {
+            prefetched = prefetchBytes;
+        }
+        else if (DMARead(messageAddress - 4, sizeof(uint16_t), messageBytes))
+        {
+            prefetched = sizeof(uint16_t);
+        }
+        else
+        {
+            PortError(PORT_ERROR_RING_READ);
+            *error = true;
+            return nullptr;
+        }
+
+        uint16_t messageLength = cmdMessage->MessageLength;
        
-        if (!success || messageLength <= 0 || messageLength >= MAX_MESSAGE_LENGTH)
+        if (messageLength <= 0 || messageLength >= MAX_MESSAGE_LENGTH)
         {
             PortError(PORT_ERROR_RING_READ);
             *error = true;
             return nullptr;
         }     
    
-        std::unique_ptr<Message> cmdMessage(
-            reinterpret_cast<Message*>(
-                DMARead(
-                    messageAddress - 4,
-                    messageLength + 4, 
-                    sizeof(Message)))); 
-
-        if (!cmdMessage)
+        if (messageLength + 4u > prefetched
+            && !DMARead(
+                messageAddress - 4 + prefetched,
+                messageLength + 4 - prefetched, 
+                messageBytes + prefetched))
         {
             PortError(PORT_ERROR_RING_READ);
             *error = true;
             return nullptr;
         }
 
+        // The message is recycled: clear what the previous one (or the
+        // prefetch) may have left in the parameter area of a regular sized message.
+        size_t clearEnd = std::min(sizeof(Message),
+            static_cast<size_t>(HEADER_OFFSET + HEADER_SIZE + MESSAGE_CLEAR_PARAMETER_BYTES));
+        if (messageLength + 4u < clearEnd)
+        {
+            memset(messageBytes + messageLength + 4, 0,
+                clearEnd - (messageLength + 4));
+        }
+
         //
         // Handle Ring Transitions (from full to not-full) and associated
         // interrupts.
@@ -612,7 +817,7 @@ uda_c::GetNextCommand(bool* error)
         // that the ring was previously full (i.e. the descriptor we're now returning
         // is the first free entry.)
         //
-        if (cmdDescriptor->Word1.Fields.Flag)
+        if (cmdDescriptor.Word1.Fields.Flag)
         {
             //
             // Flag is set, host is requesting a transition interrupt.
@@ -625,29 +830,39 @@ uda_c::GetNextCommand(bool* error)
             }
             else
             {
-                uint32_t previousDescriptorAddress =
-                    GetCommandDescriptorAddress(
-                        (_commandRingPointer - 1) % _commandRingLength);
-
-                std::unique_ptr<Descriptor> previousDescriptor(
-                    reinterpret_cast<Descriptor*>(
-                        DMARead(
-                            previousDescriptorAddress,
-                            sizeof(Descriptor),
-                            sizeof(Descriptor))));
+                uint32_t previousIndex = (_commandRingPointer - 1) % _commandRingLength;
 
-                if (!previousDescriptor)
+                if ((previousIndex - _commandReleaseFirst) % _commandRingLength < _commandReleaseCount)
                 {
-                    PortError(PORT_ERROR_RING_READ);
-                    *error = true;
-                    return nullptr;
+                    // Taken in this batch: not yet handed back, so the host
+                    // can not have filled it again.
                 }
-
-                if (previousDescriptor->Word1.Fields.Ownership)
+                else if (previousIndex >= _commandCacheFirst
+                    && previousIndex < _commandCacheFirst + _commandCacheCount)
                 {
-                    // We own the previous descriptor, so the ring was previously
-                    // full.
-                    doInterrupt = true;
+                    // Not touched since it was cached.
+                    doInterrupt = _commandCache[previousIndex - _commandCacheFirst].Word1.Fields.Ownership;
+                }
+                else
+                {
+                    Descriptor previousDescriptor;
+
+                    if (!DMARead(
+                            GetCommandDescriptorAddress(previousIndex),
+                            sizeof(Descriptor),
+                            reinterpret_cast<uint8_t*>(&previousDescriptor)))
+                    {
+                        PortError(PORT_ERROR_RING_READ);
+                        *error = true;
+                        return nullptr;
+                    }
+
+                    if (previousDescriptor.Word1.Fields.Ownership)
+                    {
+                        // We own the previous descriptor, so the ring was previously
+                        // full.
+                        doInterrupt = true;
+                    }
                 }
             }            
         }
@@ -656,39 +871,31 @@ uda_c::GetNextCommand(bool* error)
         // Message retrieved; reset the Owner bit of the command descriptor,
         // set the Flag bit (to indicate that we've processed it)
         // and return a pointer to the message.
+        // The descriptor joins the batch written back by ReleaseCommands().
         //
-        cmdDescriptor->Word1.Fields.Ownership = 0;
-        cmdDescriptor->Word1.Fields.Flag = 1;
-        if (!DMAWrite(
-            descriptorAddress,
-            sizeof(Descriptor),
-            reinterpret_cast<uint8_t*>(cmdDescriptor.get())))
+        cmdDescriptor.Word1.Fields.Ownership = 0;
+        cmdDescriptor.Word1.Fields.Flag = 1;
+        if (0 == _commandReleaseCount)
         {
-            PortError(PORT_ERROR_RING_WRITE);
-            *error = true;
-            return nullptr;
+            _commandReleaseFirst = _commandRingPointer;
         }
+        _commandReleases[_commandReleaseCount++] = cmdDescriptor;
+        _commandReleaseInterrupt |= doInterrupt;
 
         //
         // Move to the next descriptor in the ring for next time.
         _commandRingPointer = (_commandRingPointer + 1) % _commandRingLength;
 
-        // Post an interrupt as necessary.
-        if (doInterrupt)
-        {
-            //
-            // Set ring base - 4 to non-zero to indicate a transition.
-            //
-            DMAWriteWord(_ringBase - 4, 0x1);
-            Interrupt();
-        }
-
-        return cmdMessage.release();
+        return cmdMessage;
     }
    
-    DEBUG_FAST("No descriptor found.  0x%x 0x%x", cmdDescriptor->Word0.Word0, cmdDescriptor->Word1.Word1);  
+    DEBUG_FAST("No descriptor found.  0x%x 0x%x", cmdDescriptor.Word0.Word0, cmdDescriptor.Word1.Word1);  
  
-    // No descriptor available.
+    // No descriptor available: hand back what was taken so far.
+    if (!ReleaseCommands())
+    {
+        *error = true;
+    }
     return nullptr;
 }
 
@@ -705,32 +912,36 @@ uda_c::PostResponse(
 {
     bool res = false;
 
-    // Grab the next descriptor.
+    // Grab the next descriptor, and the one before it for the transition
+    // check below in the same read, unless it is at the other end of the ring.
     uint32_t descriptorAddress = GetResponseDescriptorAddress(_responseRingPointer);
-    std::unique_ptr<Descriptor> cmdDescriptor(
-        reinterpret_cast<Descriptor*>(
-            DMARead(
-                descriptorAddress,
-                sizeof(Descriptor),
-                sizeof(Descriptor))));
+    Descriptor descriptors[2];
+    Descriptor& previousDescriptor = descriptors[0];
+    Descriptor& cmdDescriptor = descriptors[1];
+    bool havePrevious = _responseRingPointer > 0;
 
-    // TODO: if NULL is returned assume a bus error and handle it appropriately.
+    // TODO: if this fails assume a bus error and handle it appropriately.
+    DMARead(
+        havePrevious ? descriptorAddress - sizeof(Descriptor) : descriptorAddress,
+        havePrevious ? 2 * sizeof(Descriptor) : sizeof(Descriptor),
+        reinterpret_cast<uint8_t*>(havePrevious ? &previousDescriptor : &cmdDescriptor));
 
     //
     // Check owner bit: if set, ownership has been passed to us, in which case
     // we can use this descriptor and fill in the response buffer it points to.
     // If not, we return false to indicate to the caller the need to try again later.
     //
-    if (cmdDescriptor->Word1.Fields.Ownership)
+    if (cmdDescriptor.Word1.Fields.Ownership)
     {
         bool doInterrupt = false;
 
         uint32_t messageAddress =
-            cmdDescriptor->Word0.EnvelopeLow |
-            (cmdDescriptor->Word1.Fields.EnvelopeHigh << 16);
+            cmdDescriptor.Word0.EnvelopeLow |
+            (cmdDescriptor.Word1.Fields.EnvelopeHigh << 16);
 
         //
-        // Read the buffer length the host has allocated for this response.
+        // The buffer length the host has allocated for this response is not
+        // checked, which saves a bus cycle per response.
         //
         // TODO:
         // If it is shorter than the buffer we're writing then we will need to
@@ -746,44 +957,14 @@ uda_c::PostResponse(
         // The doc is also not exactly clear what a fragmented set of responses looks like...
         // 
         // Message length is at messageAddress - 4 -- this is the size of the command
-        // not including the two header words.
+        // not including the two header words.  A lot of bootstraps set up response
+        // buffers of length 0, and the VMS bootstrap sets up shorter ones, so the
+        // check would only ever have been logged.
         //
-        bool success = false;
-        uint16_t messageLength =
-            DMAReadWord(
-                messageAddress - 4,
-                success);
-
         DEBUG_FAST("response address o%o length o%o", messageAddress, response->MessageLength);
 
         assert(reinterpret_cast<uint16_t*>(response)[0] > 0);
 
-        if (messageLength == 0)
-        { 
-            // A lot of bootstraps appear to set up response buffers of length 0.
-            // We just log the behavior.
-            DEBUG_FAST("Host response buffer size is zero.");
-        }
-        else if (messageLength < response->MessageLength)
-        {
-            //
-            // If this happens it's likely fatal since we're not fragmenting responses (see the big comment
-            // block above).  So eat flaming death.     
-            // Note: the VMS bootstrap does this, so we'll just log the issue.
-            //
-            DEBUG_FAST("Response buffer 0x%x > host buffer length 0x%x", response->MessageLength, messageLength);
-        }
-
-        //
-        // This will fit; simply copy the response message over the top
-        // of the buffer allocated on the host -- this updates the header fields
-        // as necessary and provides the actual response data to the host.
-        //
-        DMAWrite(
-            messageAddress - 4,
-            response->MessageLength + 4,
-            reinterpret_cast<uint8_t*>(response));
-
         //
         // Check if a transition from empty to non-empty occurred, interrupt if requested.
         //
@@ -791,7 +972,7 @@ uda_c::PostResponse(
         // that the ring was previously empty (i.e. the descriptor we're now returning
         // is the first entry returned to the ring by the Port.)
         //
-        if (cmdDescriptor->Word1.Fields.Flag)
+        if (cmdDescriptor.Word1.Fields.Flag)
         {
             //
             // Flag is set, host is requesting a transition interrupt.
@@ -804,18 +985,15 @@ uda_c::PostResponse(
             }
             else
             {
-                uint32_t previousDescriptorAddress =
-                    GetResponseDescriptorAddress(
-                    (_responseRingPointer - 1) % _responseRingLength);
-
-                std::unique_ptr<Descriptor> previousDescriptor(
-                    reinterpret_cast<Descriptor*>(
-                        DMARead(
-                            previousDescriptorAddress,
-                            sizeof(Descriptor),
-                            sizeof(Descriptor))));
+                if (!havePrevious)
+                {
+                    DMARead(
+                        GetResponseDescriptorAddress(_responseRingLength - 1),
+                        sizeof(Descriptor),
+                        reinterpret_cast<uint8_t*>(&previousDescriptor));
+                }
 
-                if (previousDescriptor->Word1.Fields.Ownership)
+                if (previousDescriptor.Word1.Fields.Ownership)
                 {
                     // We own the previous descriptor, so the ring was previously
                     // full.
@@ -825,26 +1003,61 @@ uda_c::PostResponse(
         }
 
         //
-        // Message posted; reset the Owner bit of the response descriptor,
+        // This will fit; simply copy the response message over the top
+        // of the buffer allocated on the host -- this updates the header fields
+        // as necessary and provides the actual response data to the host.
+        // Then reset the Owner bit of the response descriptor,
         // and set the Flag bit (to indicate that we've processed it).
+        // If an interrupt is necessary, set ring base - 2 to non-zero
+        // to indicate a transition.
+        // All of this goes out in order in a single bus tenure.
+        //
+        cmdDescriptor.Word1.Fields.Ownership = 0;
+        cmdDescriptor.Word1.Fields.Flag = 1;
+        uint16_t transition = 0x1;
+        DMAWriteSegment writes[] = {
+            { messageAddress - 4, response->MessageLength + 4u, reinterpret_cast<uint8_t*>(response) },
+            { descriptorAddress, sizeof(Descriptor), reinterpret_cast<uint8_t*>(&cmdDescriptor) },
+            { _ringBase - 2, sizeof(uint16_t), reinterpret_cast<uint8_t*>(&transition) },
+        };
+        DMAWriteSegments(writes, doInterrupt ? 3 : 2);
+
+        //
+        // Post an interrupt as necessary.  With coalescing enabled the
+        // interrupt is held back, and the responses that follow in the
+        // meantime are reported with it.
         //
-        cmdDescriptor->Word1.Fields.Ownership = 0;
-        cmdDescriptor->Word1.Fields.Flag = 1;
-        DMAWrite(
-            descriptorAddress,
-            sizeof(Descriptor),
-            reinterpret_cast<uint8_t*>(cmdDescriptor.get()));
-
-        // Post an interrupt as necessary.
-        if (doInterrupt)
+        pthread_mutex_lock(&intr_coalesce_mutex);
+        if (_coalescedResponses > 0)
         {
-            DEBUG_FAST("Response ring no longer empty, interrupting.");
-            //
-            // Set ring base - 2 to non-zero to indicate a transition.
-            //
-            DMAWriteWord(_ringBase - 2, 0x1);
-            Interrupt();
+            _coalescedResponses++;
+            interrupts_saved.value++;
+            if (_coalescedResponses >= intr_coalesce_count.value)
+            {
+                DEBUG_FAST("%u responses coalesced, interrupting.", _coalescedResponses);
+                PostResponseInterrupt();
+            }
         }
+        else if (doInterrupt)
+        {
+            if (intr_coalesce_count.value > 1 && intr_coalesce_delay.value > 0)
+            {
+                DEBUG_FAST("Response ring no longer empty, holding back interrupt.");
+                _coalescedResponses = 1;
+
+                clock_gettime(CLOCK_REALTIME, &_coalesceDeadline);
+                _coalesceDeadline.tv_nsec += (long) (intr_coalesce_delay.value % 1000000) * 1000;
+                _coalesceDeadline.tv_sec += intr_coalesce_delay.value / 1000000 + _coalesceDeadline.tv_nsec / 1000000000;
+                _coalesceDeadline.tv_nsec %= 1000000000;
+                pthread_cond_signal(&intr_coalesce_cond);
+            }
+            else
+            {
+                DEBUG_FAST("Response ring no longer empty, interrupting.");
+                PostResponseInterrupt();
+            }
+        }
+        pthread_mutex_unlock(&intr_coalesce_mutex);
 
         res = true;
         
@@ -855,6 +1068,46 @@ uda_c::PostResponse(
     return res;
 }
 
+//
+// PostResponseInterrupt():
+//  Interrupts the host for the response ring and ends coalescing.
+//  Called with intr_coalesce_mutex held.
+//
+void
+uda_c::PostResponseInterrupt(void)
+{
+    _coalescedResponses = 0;
+    response_interrupts.value++;
+    Interrupt();
+}
+
+//
+// worker_intr_coalescing():
+//  Posts a held back response interrupt when its deadline has passed.
+//  A new interrupt being held back wakes the worker up to take its deadline.
+//
+void
+uda_c::worker_intr_coalescing(void)
+{
+    worker_init_realtime_priority(rt_device); 
+
+    pthread_mutex_lock(&intr_coalesce_mutex);
+    while (!workers_terminate)
+    {
+        if (0 == _coalescedResponses)
+        {
+            pthread_cond_wait(&intr_coalesce_cond, &intr_coalesce_mutex);
+        }
+        else if (pthread_cond_timedwait(&intr_coalesce_cond, &intr_coalesce_mutex, &_coalesceDeadline) == ETIMEDOUT
+            && _coalescedResponses > 0)
+        {
+            DEBUG_FAST("Coalescing delay over, interrupting for %u responses.", _coalescedResponses);
+            PostResponseInterrupt();
+        }
+    }
+    pthread_mutex_unlock(&intr_coalesce_mutex);
+}
+
 //
 // GetControllerIdentifier():
 //  Returns the ID used by SET CONTROLLER CHARACTERISTICS.
@@ -1016,23 +1269,13 @@ uda_c::DMAReadWord(
     uint32_t address,
     bool& success)
 {
-    uint8_t* buffer = DMARead(
+    uint16_t word = 0;
+    success = DMARead(
         address,
         sizeof(uint16_t),
-        sizeof(uint16_t));
+        reinterpret_cast<uint8_t*>(&word));
 
-    if (buffer)
-    {
-        success = true;
-        uint16_t retval = *reinterpret_cast<uint16_t *>(buffer);
-        delete[] buffer;
-        return retval;
-    }
-    else
-    {
-        success = false;
-        return 0;
-    }
+    return word;
 }
 
 
@@ -1052,53 +1295,235 @@ uda_c::DMAWrite(
     assert ((lengthInBytes % 2) == 0);
     assert (address < 2* qunibus->addr_space_word_count); // exceeds address space? test for IOpage too?
 
+    pthread_mutex_lock(&dma_mutex);
     qunibusadapter->DMA(dma_request, true,
             QUNIBUS_CYCLE_DATO,
             address,
             reinterpret_cast<uint16_t*>(buffer),
             lengthInBytes >> 1);
-	return dma_request.success ;
+    bool success = dma_request.success;
+    pthread_mutex_unlock(&dma_mutex);
+    return success;
+}
+
+//
+// DMAWriteSegments():
+//  Write several discontiguous buffers to Qbus/Unibus memory, in order,
+//  with a single bus arbitration.  Returns true on success; if false
+//  is returned this is due to an NXM condition.
+//  Addresses must be word-aligned and lengths must be even.
+//
+bool
+uda_c::DMAWriteSegments(
+    const DMAWriteSegment* segments,
+    unsigned segmentCount)
+{
+    assert (segmentCount <= PRU_MAX_DMA_SEGMENTCOUNT);
+
+    dma_segment_t dmaSegments[PRU_MAX_DMA_SEGMENTCOUNT];
+    size_t totalLength = 0;
+    for (unsigned i = 0; i < segmentCount; i++)
+    {
+        assert ((segments[i].lengthInBytes % 2) == 0);
+        totalLength += segments[i].lengthInBytes;
+    }
+
+    // Gather all data into one buffer, segment by segment
+    std::unique_ptr<uint16_t[]> buffer(new uint16_t[totalLength >> 1]);
+    uint8_t* dst = reinterpret_cast<uint8_t*>(buffer.get());
+    for (unsigned i = 0; i < segmentCount; i++)
+    {
+        dmaSegments[i].addr = segments[i].address;
+        dmaSegments[i].wordcount = segments[i].lengthInBytes >> 1;
+        memcpy(dst, segments[i].buffer, segments[i].lengthInBytes);
+        dst += segments[i].lengthInBytes;
+    }
+
+    pthread_mutex_lock(&dma_mutex);
+    qunibusadapter->DMA_segments(dma_request, true,
+            QUNIBUS_CYCLE_DATO,
+            segmentCount,
+            dmaSegments,
+            buffer.get());
+    bool success = dma_request.success;
+    pthread_mutex_unlock(&dma_mutex);
+    return success;
 }
 
 //
 // DMARead():
-// Read data from Qbus/Unibus memory into the returned buffer.
-// Buffer returned is nullptr if memory could not be read.
-// Caller is responsible for freeing the buffer when done.
+// Read data from Qbus/Unibus memory into the provided buffer.
+// Returns true on success; if false is returned this is due to
+// an NXM condition.
 // The address specified in 'address' must be word-aligned
 // and the length must be even.
 //
-uint8_t*
+bool
 uda_c::DMARead(
     uint32_t address,
     size_t lengthInBytes,
-    size_t bufferSize)
+    uint8_t* buffer)
 {
-    assert (bufferSize >= lengthInBytes);
     assert((lengthInBytes % 2) == 0);
     assert (address < 2* qunibus->addr_space_word_count); // exceeds address space? test for IOpage too?
 
-    uint16_t* buffer = new uint16_t[bufferSize >> 1];
-
-    assert(buffer);
-
-    memset(reinterpret_cast<uint8_t*>(buffer), 0xc3, bufferSize);
-
+    pthread_mutex_lock(&dma_mutex);
     qunibusadapter->DMA(dma_request, true,
                 QUNIBUS_CYCLE_DATI,
                 address,
-                buffer,
+                reinterpret_cast<uint16_t*>(buffer),
                 lengthInBytes >> 1);
+    bool success = dma_request.success;
+    pthread_mutex_unlock(&dma_mutex);
 
-    if (dma_request.success)
-    { 
-	return reinterpret_cast<uint8_t*>(buffer);
-    }
-    else
-    {
+//    if (!success) {
 //    ARM_DEBUG_PIN0(1) ;
 //printf("UDA.DMARead NXM: address=%07o,len=%d words, failing addr=%07o",
 //		address, lengthInBytes >> 1, dma_request.qunibus_end_addr ) ;
-        return nullptr;     
+//    }
+    return success;
+}
+
+//
+// GetSliceDMARequest():
+//  Returns one of the two DMA requests of a unit for sliced transfers.
+//
+dma_request_c*
+uda_c::GetSliceDMARequest(
+    uint32_t unitNumber,
+    unsigned index)
+{
+    assert(unitNumber < DRIVE_COUNT);
+    assert(index < 2);
+
+    return _sliceDMARequests[unitNumber * 2 + index].get();
+}
+
+//
+// DMAWriteSubmit():
+//  Starts writing the provided buffer to Qbus/Unibus memory and returns
+//  immediately.  The buffer must not be touched until DMAWait().
+//  Same alignment rules as DMAWrite().
+//
+void
+uda_c::DMAWriteSubmit(
+    dma_request_c* request,
+    uint32_t address,
+    size_t lengthInBytes,
+    uint8_t* buffer)
+{
+    assert ((lengthInBytes % 2) == 0);
+    assert (address < 2* qunibus->addr_space_word_count);
+
+    qunibusadapter->DMA_submit(*request,
+            QUNIBUS_CYCLE_DATO,
+            address,
+            reinterpret_cast<uint16_t*>(buffer),
+            lengthInBytes >> 1);
+}
+
+//
+// DMAReadSubmit():
+//  Starts reading Qbus/Unibus memory into the provided buffer and returns
+//  immediately.  The buffer is valid after DMAWait().
+//  Same alignment rules as DMARead().
+//
+void
+uda_c::DMAReadSubmit(
+    dma_request_c* request,
+    uint32_t address,
+    size_t lengthInBytes,
+    uint8_t* buffer)
+{
+    assert ((lengthInBytes % 2) == 0);
+    assert (address < 2* qunibus->addr_space_word_count);
+
+    qunibusadapter->DMA_submit(*request,
+            QUNIBUS_CYCLE_DATI,
+            address,
+            reinterpret_cast<uint16_t*>(buffer),
+            lengthInBytes >> 1);
+}
+
+//
+// DMAWait():
+//  Waits for a submitted transfer.  Returns true on success; if false
+//  is returned this is due to an NXM condition.
+//
+bool
+uda_c::DMAWait(
+    dma_request_c* request)
+{
+    qunibusadapter->DMA_wait(*request);
+    return request->success;
+}
+
+MessagePool::MessagePool() :
+    _messages(new Message[MESSAGE_POOL_SIZE]),
+    _mutex(PTHREAD_MUTEX_INITIALIZER),
+    _heapAllocations(0)
+{
+    _free.reserve(MESSAGE_POOL_SIZE);
+    for (unsigned i = 0; i < MESSAGE_POOL_SIZE; i++)
+    {
+        _free.push_back(&_messages[i]);
     }
-} 
+}
+
+MessagePool::~MessagePool()
+{
+}
+
+//
+// Allocate():
+//  Returns a Message from the pool, or from the heap if all are in use.
+//  The content of the Message is undefined.
+//
+MessageHandle
+MessagePool::Allocate(void)
+{
+    Message* message = nullptr;
+
+    pthread_mutex_lock(&_mutex);
+    if (!_free.empty())
+    {
+        message = _free.back();
+        _free.pop_back();
+    }
+    else
+    {
+        _heapAllocations++;
+    }
+    pthread_mutex_unlock(&_mutex);
+
+    if (nullptr == message)
+    {
+        message = new Message;
+    }
+
+    return MessageHandle(message, MessageReleaser { this });
+}
+
+//
+// Release():
+//  Returns a Message to the pool, or to the heap if it came from there.
+//
+void
+MessagePool::Release(Message* message)
+{
+    if (message < &_messages[0] || message >= &_messages[MESSAGE_POOL_SIZE])
+    {
+        delete message;
+        return;
+    }
+
+    pthread_mutex_lock(&_mutex);
+    _free.push_back(message);
+    pthread_mutex_unlock(&_mutex);
+}
+
+void
+MessageReleaser::operator()(Message* message) const
+{
+    pool->Release(message);
+}
@@ -7,7 +7,10 @@
 
 #pragma once
 
+#include <inttypes.h> // PRI* formats
 #include <memory>
+#include <vector>
+#include <pthread.h>
 #include "utils.hpp"
 #include "qunibusadapter.hpp"
 #include "qunibusdevice.hpp"
@@ -62,6 +65,45 @@ struct Message
 };
 #pragma pack(pop)
 
+// Number of preallocated Messages.  The host can not have more commands
+// outstanding than the credits it was granted; two more cover the command
+// just being read and an immediate command.
+#define MESSAGE_POOL_SIZE (MAX_CREDITS + 2)
+
+// Parameter bytes cleared behind a received command, covers all regular messages
+#define MESSAGE_CLEAR_PARAMETER_BYTES 64
+
+// Command descriptors fetched per DMA, and taken before their ownership
+// is handed back to the host in one write (see uda_c::ReleaseCommands())
+#define RING_CACHE_SIZE 8
+
+// Bytes read with the length word of a command, covers all regular messages
+#define MESSAGE_PREFETCH_BYTES (HEADER_OFFSET + HEADER_SIZE + 48)
+
+//
+// Fixed set of Messages, allocated once.  Messages are big
+// (see ControlMessageHeader::Parameters), so they are recycled instead of
+// being allocated per command.  If the pool runs dry, Allocate() falls
+// back to the heap; Release() tells both kinds apart.
+//
+class MessagePool
+{
+public:
+    MessagePool();
+    ~MessagePool();
+
+    MessageHandle Allocate(void);
+    void Release(Message* message);
+
+    uint32_t GetHeapAllocations(void) { return _heapAllocations; }
+
+private:
+    std::unique_ptr<Message[]> _messages;
+    std::vector<Message*> _free;
+    pthread_mutex_t _mutex;
+    uint32_t _heapAllocations;
+};
+
 /*
   This implements the Transport layer for a Qbus/Unibus MSCP controller.
 
@@ -95,15 +137,33 @@ public:
     // Configuration parameter for 22-bit DMA
     parameter_bool_c twenty_two_bit_DMA = parameter_bool_c(this, "22_bit_dma", "dma22",
         false, "Enable 22-bit DMA"); 
+
+    // Let the MSCP server reorder queued transfers of a unit by LBN
+    parameter_bool_c seek_optimize = parameter_bool_c(this, "seek_optimize", "so",
+        false, "Reorder queued transfers per unit by LBN (C-SCAN), merge adjacent reads");
+
+    // Response interrupt coalescing: the interrupt for a response ring transition
+    // is held back until intr_coalesce_count responses are posted or
+    // intr_coalesce_delay has passed.  A count of 1 interrupts immediately.
+    parameter_unsigned_c intr_coalesce_count = parameter_unsigned_c(this, "intr_coalesce_count", "icc", /*readonly*/
+        false, "", "%u", "Responses per interrupt, 1 = interrupt on every response ring transition", 8, 10);
+    parameter_unsigned_c intr_coalesce_delay = parameter_unsigned_c(this, "intr_coalesce_delay", "icd", /*readonly*/
+        false, "us", "%u", "Max time a response interrupt is held back for coalescing", 20, 10);
+    parameter_unsigned64_c response_interrupts = parameter_unsigned64_c(this, "response_interrupts", "ri", /*readonly*/
+        true, "", "%" PRIu64, "Interrupts posted for the response ring", 63, 10);
+    parameter_unsigned64_c interrupts_saved = parameter_unsigned64_c(this, "interrupts_saved", "is", /*readonly*/
+        true, "", "%" PRIu64, "Responses posted while an interrupt was held back", 63, 10);
    	
 public:
 
     //
     // Returns the next command message from the command ring, if any.
-    // Returns NULL if the ring is empty.  error is set to true if
+    // Returns an empty handle if the ring is empty.  error is set to true if
     // an error occurred while reading the message.
+    // The descriptors of returned commands are handed back to the host in
+    // batches, at the latest when the ring is found empty.
     //
-    Message* GetNextCommand(bool* error);
+    MessageHandle GetNextCommand(bool* error);
 
     //
     // Posts a response message to the response ring and memory
@@ -119,6 +179,9 @@ public:
 
 private:
     // TODO: consolidate these private/public groups here 
+    void worker_initialization(void);
+    void worker_intr_coalescing(void);
+
     void Reset(void);
     void PortError(uint16_t error); 
     void Interrupt(uint16_t sa_value); 
@@ -127,6 +190,9 @@ private:
     uint32_t GetCommandDescriptorAddress(size_t index);
     uint32_t GetResponseDescriptorAddress(size_t index);
 
+    void ResetRingCache(void);
+    bool ReleaseCommands(void);
+
     enum ControllerType {
         UDA50 = 0,
         RQDX3 = 1,
@@ -139,15 +205,46 @@ public:
     uint16_t DMAReadWord(uint32_t address, bool& success);
 
     bool DMAWrite(uint32_t address, size_t lengthInBytes, uint8_t* buffer);
-    uint8_t* DMARead(uint32_t address, size_t lengthInBytes, size_t bufferSize);
+
+    // One buffer of a DMAWriteSegments() gather list
+    struct DMAWriteSegment
+    {
+        uint32_t address;
+        size_t lengthInBytes;
+        uint8_t* buffer;
+    };
+    bool DMAWriteSegments(const DMAWriteSegment* segments, unsigned segmentCount);
+    bool DMARead(uint32_t address, size_t lengthInBytes, uint8_t* buffer);
+
+    //
+    // Sliced transfers: each unit has two requests of its own, so the MSCP
+    // server can keep one slice on the bus while it does image I/O for the
+    // next.  They are not serialized by dma_mutex but queue behind the
+    // controller's priority slot.
+    //
+    dma_request_c* GetSliceDMARequest(uint32_t unitNumber, unsigned index);
+    void DMAWriteSubmit(dma_request_c* request, uint32_t address, size_t lengthInBytes, uint8_t* buffer);
+    void DMAReadSubmit(dma_request_c* request, uint32_t address, size_t lengthInBytes, uint8_t* buffer);
+    bool DMAWait(dma_request_c* request);
 
 private:
+    // The MSCP server calls the DMA functions from its polling and unit
+    // threads; they share the single dma_request.
+    pthread_mutex_t dma_mutex;
+
     void update_SA(uint16_t value);
 
     // UDA50 registers:
     qunibusdevice_register_t *IP_reg;
     qunibusdevice_register_t *SA_reg;
 
+    // DRIVE_COUNT * 2 requests, see GetSliceDMARequest()
+    std::vector<std::unique_ptr<dma_request_c>> _sliceDMARequests;
+
+    // Command messages, owned by the MSCP server until the response is posted.
+    // Declared before _server: the server returns its messages on destruction.
+    MessagePool _messagePool;
+
     std::shared_ptr<mscp_server> _server;
 
     uint32_t _ringBase;
@@ -188,6 +285,16 @@ private:
     volatile InitializationStep _initStep;
     volatile bool _next_step;
 
+    // Response interrupt held back by PostResponse(), posted either when
+    // enough responses have joined it or by worker_intr_coalescing()
+    // at the deadline.
+    pthread_mutex_t intr_coalesce_mutex;
+    pthread_cond_t intr_coalesce_cond;
+    unsigned _coalescedResponses; // 0: no interrupt held back
+    struct timespec _coalesceDeadline;
+
+    void PostResponseInterrupt(void);
+
     void StateTransition(InitializationStep nextStep);
 
     // TODO: this currently assumes a little-endian machine!
@@ -213,5 +320,28 @@ private:
         } Word1;
     };   
     #pragma pack(pop) 
+
+    //
+    // Command ring cache: descriptors are read RING_CACHE_SIZE at a time,
+    // starting one slot before the one asked for, so the transition check
+    // finds the previous slot in the same read.  Only entries owned by the
+    // port are used from the cache; the host may pass the others to us
+    // at any time.
+    //
+    Descriptor _commandCache[RING_CACHE_SIZE];
+    uint32_t _commandCacheFirst;
+    uint32_t _commandCacheCount;
+
+    //
+    // Commands taken from the ring whose descriptors still have to be
+    // handed back to the host.  They are consecutive slots starting at
+    // _commandReleaseFirst, written back by ReleaseCommands().
+    //
+    Descriptor _commandReleases[RING_CACHE_SIZE];
+    uint32_t _commandReleaseFirst;
+    uint32_t _commandReleaseCount;
+    bool _commandReleaseInterrupt;
+
+    Descriptor* GetCommandDescriptor(uint32_t index, bool* error);
 };
 
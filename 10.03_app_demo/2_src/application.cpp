@@ -66,6 +66,7 @@
 #include "memoryimage.hpp"
 #include "iopageregister.h"
 #include "panel.hpp"
+#include "storagecache.hpp"
 #include "qunibus.h"
 #include "qunibusadapter.hpp"
 
@@ -184,6 +185,11 @@ void application_c::parse_commandline(int argc, char **argv)
                          "\"debug\": LEDs not used, free for internal debugging.", "",
                          "", "", "");
 
+    getopt_parser.define("sim", "simulate", "", "", "",
+                         "Run on a simulated PRU, without BeagleBone and bus hardware.\n"
+                         "Device registers and memory are accessed by the simulator only.", "",
+                         "", "", "");
+
 	// test options
 
     getopt_parser.define("t", "test", "iarg1,iarg2", "soptarg", "8 15",
@@ -230,6 +236,8 @@ void application_c::parse_commandline(int argc, char **argv)
                     commandline_option_error((char *)"4 LEDs can only display values 0..15");
                 gpios->cmdline_leds = n ;
             }
+        } else if (getopt_parser.isoption("simulate")) {
+            pru->backend = pru_c::BACKEND_SIMULATOR ;
         } else if (getopt_parser.isoption("test")) {
             int i1, i2;
             std::string s;
@@ -311,7 +319,7 @@ int application_c::run(int argc, char *argv[])
     DEBUG("Printing DEBUG output. Log file = \"%s\"", logger->default_filepath.c_str());
 
     /* prussdrv_init() will segfault if called with EUID != 0 */
-    if (geteuid()) {
+    if (geteuid() && !pru->is_simulated()) {
         FATAL("%s must be run as root to use prussdrv\n", argv[0]);
     }
 
@@ -362,6 +370,10 @@ static void factory()
     // paneldriver before all devices who use lamps or buttons
     paneldriver = new paneldriver_c();
 
+    // before all storage drives. Disabled: writes go to the image at once,
+    // write-back caching must be enabled by the user.
+    storagecache = new storagecache_c();
+
     membuffer = new memoryimage_c();
 
     qunibus = new qunibus_c();
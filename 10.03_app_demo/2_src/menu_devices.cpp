@@ -301,6 +301,15 @@ void application_c::menu_devices(const char *menu_code, bool with_emulated_CPU)
 			}
 			printf("dbg c|s|f            Debug log: Clear, Show on console, dump to File.\n");
 			printf("                       (file = %s)\n", logger->default_filepath.c_str());
+			printf("lat                  Show register event latency (SSYN/RPLY hold time)\n");
+			printf("lat c                Clear latency histograms\n");
+			printf("lat f <file>         Save latency histograms as CSV\n");
+			printf("rqb [<count>]        Benchmark INTR/DMA request scheduler (count * 6 requests)\n");
+			printf("rql [c]              Show request table lock contention per level (c = clear)\n");
+#if defined(UNIBUS)
+			if (cpu)
+				printf("cpb [<count>]        Benchmark CPU opcodes/sec, atomic vs. mutex INTR poll (halted, pmi=1)\n");
+#endif
 			printf("init                 Pulse " QUNIBUS_NAME " INIT\n");
 #if defined(UNIBUS)
 			printf("pwr                  Simulate UNIBUS power cycle (ACLO/DCLO)\n");
@@ -339,6 +348,36 @@ void application_c::menu_devices(const char *menu_code, bool with_emulated_CPU)
 				} else if (!strcasecmp(s_param[0], "f")) {
 					logger->dump(logger->default_filepath);
 				}
+			} else if (!strcasecmp(s_opcode, "rqb") && n_fields <= 2) {
+				unsigned loops = 100000;
+				if (n_fields == 2)
+					loops = strtol(s_param[0], NULL, 10);
+				if (loops > 0)
+					qunibusadapter->request_scheduler_benchmark(loops);
+#if defined(UNIBUS)
+			} else if (cpu && !strcasecmp(s_opcode, "cpb") && n_fields <= 2) {
+				unsigned steps = 10000000;
+				if (n_fields == 2)
+					steps = strtol(s_param[0], NULL, 10);
+				if (steps > 0)
+					cpu->benchmark(steps);
+#endif
+			} else if (!strcasecmp(s_opcode, "rql") && n_fields == 1) {
+				qunibusadapter->requests_lock_statistics(false);
+			} else if (!strcasecmp(s_opcode, "rql") && n_fields == 2
+					&& !strcasecmp(s_param[0], "c")) {
+				qunibusadapter->requests_lock_statistics(true);
+				printf("Lock statistics cleared.\n");
+			} else if (!strcasecmp(s_opcode, "lat") && n_fields == 1) {
+				qunibusadapter->latency_print();
+			} else if (!strcasecmp(s_opcode, "lat") && n_fields == 2
+					&& !strcasecmp(s_param[0], "c")) {
+				qunibusadapter->latency_clear();
+				printf("Latency histograms cleared.\n");
+			} else if (!strcasecmp(s_opcode, "lat") && n_fields == 3
+					&& !strcasecmp(s_param[0], "f")) {
+				if (qunibusadapter->latency_save_csv(s_param[1]))
+					printf("Latency histograms saved to \"%s\".\n", s_param[1]);
 			} else if (!strcasecmp(s_opcode, "m") && n_fields >= 2
 					&& !strcasecmp(s_param[0], "i")) {
 				// install (emulate) max QBUS/UNIBUS memory or limited by <endaddr>